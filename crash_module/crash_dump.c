@@ -0,0 +1,408 @@
+#include "crash_dump.h"
+#include "app_state.h"
+#include "hsv_to_rgb.h"
+#include "nvmc_module.h"
+#include "nrfx_nvmc.h"
+#include "app_error.h"
+#include "app_timer.h"
+#include "app_util_platform.h"
+#include "crc16.h"
+#include "nrf_log.h"
+#include <inttypes.h>
+#include <string.h>
+
+/**
+ * Fault handlers build dump in RAM and write it to the first free slot of crash page
+ * with one bounded sequence of word writes, nothing is erased there. Slots are used in order,
+ * so the last valid one is the newest dump. Crashes are dropped when page is full until
+ * dumps are cleared by CLI, the page is erased by steps from main loop then.
+ */
+#define CRASH_DUMP_MAGIC                0xDEADC0DEU
+#define CRASH_DUMP_SLOT_SIZE            256
+#define CRASH_DUMP_SLOTS_COUNT          (CODE_PAGE_SIZE / CRASH_DUMP_SLOT_SIZE)
+#define CRASH_DUMP_NO_SLOT              CRASH_DUMP_SLOTS_COUNT
+#define CRASH_DUMP_FILE_SIZE            16      /* end of source file name with terminating zero */
+#define CRASH_DUMP_FRAME_WORDS          8       /* r0-r3, r12, lr, pc, psr stacked on exception */
+#define CRASH_DUMP_FRAME_PC             6
+#define CRASH_DUMP_STACK_WORDS          16
+#define CRASH_DUMP_WORDS_PER_LINE       8
+#define CRASH_DUMP_TRACE_PER_LINE       4
+#define CRASH_DUMP_HARD_FAULT           0       /* fault id of hard fault, there is no SoftDevice using it */
+#define CRASH_DUMP_ERASED_WORD          0xFFFFFFFFU
+#define CRASH_DUMP_RAM_START            0x20000000U
+#define CRASH_DUMP_RAM_END              0x20040000U
+
+typedef enum crash_dump_part_e
+{
+  CRASH_DUMP_PART_SUMMARY,
+  CRASH_DUMP_PART_FRAME,
+  CRASH_DUMP_PART_FAULT_STATUS,
+  CRASH_DUMP_PART_STACK,
+  CRASH_DUMP_PART_STACK_END = CRASH_DUMP_PART_STACK + CRASH_DUMP_STACK_WORDS / CRASH_DUMP_WORDS_PER_LINE - 1,
+  CRASH_DUMP_PART_TRACE,
+  CRASH_DUMP_PART_TRACE_END = CRASH_DUMP_PART_TRACE + CRASH_DUMP_TRACE_SIZE / CRASH_DUMP_TRACE_PER_LINE - 1,
+  CRASH_DUMP_PART_STATE,
+} crash_dump_part_t;
+
+typedef struct crash_trace_s
+{
+  uint32_t ticks;                       /* app timer counter */
+  uint16_t value;
+  uint8_t event;                        /* @ref crash_trace_event_t */
+  uint8_t reserved;
+} crash_trace_t;
+
+typedef struct crash_dump_s
+{
+  uint32_t magic;
+  uint32_t fault_id;                    /* NRF_FAULT_ID_* of app error or CRASH_DUMP_HARD_FAULT */
+  uint32_t pc;
+  uint32_t err_code;
+  uint32_t line;
+  char file[CRASH_DUMP_FILE_SIZE];
+  uint32_t frame[CRASH_DUMP_FRAME_WORDS];
+  uint32_t cfsr;
+  uint32_t hfsr;
+  uint32_t mmfar;
+  uint32_t bfar;
+  uint32_t sp;
+  uint32_t stack[CRASH_DUMP_STACK_WORDS];
+  crash_trace_t trace[CRASH_DUMP_TRACE_SIZE];   /* the oldest event first */
+  hsv_params_t hsv;
+  uint32_t flags;                       /* @ref app_flag_t bitmask */
+  uint8_t led_mode;
+  uint8_t directions;                   /* @ref color_anim_directions_get */
+  uint16_t check;                       /* crc16 of the other fields */
+} crash_dump_t;
+
+STATIC_ASSERT(sizeof(crash_dump_t) <= CRASH_DUMP_SLOT_SIZE);
+STATIC_ASSERT(sizeof(crash_dump_t) % sizeof(uint32_t) == 0);
+STATIC_ASSERT(CRASH_DUMP_PART_STATE + 1 == CRASH_DUMP_PARTS_COUNT);
+
+typedef struct crash_s
+{
+  crash_trace_t trace[CRASH_DUMP_TRACE_SIZE];
+  uint8_t trace_next;                   /* the oldest event is overwritten by the next one */
+  uint8_t last_slot;                    /* the newest valid dump or CRASH_DUMP_NO_SLOT */
+  uint8_t dumps_count;
+  volatile bool is_clearing;            /* page is being erased, it mustn't be written */
+} crash_t;
+
+static crash_t crash;
+
+/* Dump is built here, stack may be broken at fault */
+static crash_dump_t dump;
+
+void crash_dump_hard_fault_handler(const uint32_t *frame);
+
+static inline uint32_t slot_addr_get(uint8_t slot)
+{
+  return NVMC_CRASH_PAGE_ADDR + slot * CRASH_DUMP_SLOT_SIZE;
+}
+
+static bool slot_is_erased(uint8_t slot)
+{
+  const uint32_t *words = (const uint32_t*)slot_addr_get(slot);
+
+  for (uint16_t idx = 0; idx < CRASH_DUMP_SLOT_SIZE / sizeof(uint32_t); idx++)
+  {
+    if (words[idx] != CRASH_DUMP_ERASED_WORD)
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static inline uint16_t dump_check(const crash_dump_t *const saved)
+{
+  return crc16_compute((const uint8_t*)saved, offsetof(crash_dump_t, check), NULL);
+}
+
+static bool dump_is_valid(uint8_t slot)
+{
+  const crash_dump_t *const saved = (const crash_dump_t*)slot_addr_get(slot);
+
+  return saved->magic == CRASH_DUMP_MAGIC && saved->check == dump_check(saved);
+}
+
+static inline bool ram_contains(uint32_t addr, uint32_t size)
+{
+  return addr >= CRASH_DUMP_RAM_START && addr <= CRASH_DUMP_RAM_END - size;
+}
+
+/**
+ * @brief Keeps the end of file name, the start of path is the same for all files
+ */
+static void file_name_copy(const uint8_t *file_name)
+{
+  size_t len;
+
+  if (file_name != NULL)
+  {
+    len = strlen((const char*)file_name);
+    file_name += len >= CRASH_DUMP_FILE_SIZE ? len - (CRASH_DUMP_FILE_SIZE - 1) : 0;
+    strncpy(dump.file, (const char*)file_name, CRASH_DUMP_FILE_SIZE - 1);
+  }
+}
+
+/**
+ * @brief Completes dump filled by fault handler and writes it to the first free slot.
+ *  Must be called with interrupts disabled, its time is bounded by word writes of one dump.
+ *
+ * @param sp stack pointer of the faulted code
+ */
+static void dump_save(uint32_t sp)
+{
+  uint8_t slot = CRASH_DUMP_SLOTS_COUNT;
+
+  if (crash.is_clearing)
+  {
+    return;
+  }
+
+  /* Slot after the last written one, broken slot isn't written again */
+  while (slot > 0 && slot_is_erased(slot - 1))
+  {
+    slot--;
+  }
+
+  if (slot == CRASH_DUMP_SLOTS_COUNT)
+  {
+    return;
+  }
+
+  dump.magic = CRASH_DUMP_MAGIC;
+  dump.sp = sp;
+
+  for (uint8_t idx = 0; idx < CRASH_DUMP_STACK_WORDS && ram_contains(sp, sizeof(uint32_t)); idx++)
+  {
+    dump.stack[idx] = *(const uint32_t*)sp;
+    sp += sizeof(uint32_t);
+  }
+
+  for (uint8_t idx = 0; idx < CRASH_DUMP_TRACE_SIZE; idx++)
+  {
+    dump.trace[idx] = crash.trace[(crash.trace_next + idx) % CRASH_DUMP_TRACE_SIZE];
+  }
+
+  dump.hsv = app_state_hsv_get();
+  dump.flags = app_state_flags_get();
+  dump.led_mode = app_state_led_mode_get();
+  dump.directions = color_anim_directions_get();
+  dump.check = dump_check(&dump);
+
+  nrfx_nvmc_words_write(slot_addr_get(slot), &dump, sizeof(dump) / sizeof(uint32_t));
+}
+
+/**
+ * @brief Replaces SDK handler of APP_ERROR_CHECK and ASSERT: saves dump and resets.
+ *  Debug build stops in SDK handler after saving as before.
+ */
+void app_error_fault_handler(uint32_t id, uint32_t pc, uint32_t info)
+{
+  const error_info_t *const error_info = (const error_info_t*)info;
+  const assert_info_t *const assert_info = (const assert_info_t*)info;
+
+  __disable_irq();
+
+  memset(&dump, 0, sizeof(dump));
+  dump.fault_id = id;
+  dump.pc = pc;
+
+  if (id == NRF_FAULT_ID_SDK_ERROR)
+  {
+    dump.err_code = error_info->err_code;
+    dump.line = error_info->line_num;
+    file_name_copy(error_info->p_file_name);
+  }
+  else if (id == NRF_FAULT_ID_SDK_ASSERT)
+  {
+    dump.line = assert_info->line_num;
+    file_name_copy(assert_info->p_file_name);
+  }
+
+  dump_save(__get_MSP());
+
+#ifdef DEBUG
+  app_error_save_and_stop(id, pc, info);
+#else
+  NVIC_SystemReset();
+#endif /* DEBUG */
+}
+
+/**
+ * @brief Saves registers stacked on exception and fault status, then resets.
+ *
+ * @param frame stack of the faulted code, see HardFault_Handler
+ */
+void crash_dump_hard_fault_handler(const uint32_t *frame)
+{
+  memset(&dump, 0, sizeof(dump));
+  dump.fault_id = CRASH_DUMP_HARD_FAULT;
+  dump.cfsr = SCB->CFSR;
+  dump.hfsr = SCB->HFSR;
+  dump.mmfar = SCB->MMFAR;
+  dump.bfar = SCB->BFAR;
+
+  /* Stack pointer is out of RAM on stack overflow, registers aren't stacked then */
+  if (ram_contains((uint32_t)frame, sizeof(dump.frame)))
+  {
+    memcpy(dump.frame, frame, sizeof(dump.frame));
+    dump.pc = frame[CRASH_DUMP_FRAME_PC];
+  }
+
+  dump_save((uint32_t)(frame + CRASH_DUMP_FRAME_WORDS));
+
+  NVIC_SystemReset();
+}
+
+/**
+ * @brief Passes stack of the faulted code to @ref crash_dump_hard_fault_handler,
+ *  replaces the default handler of startup file.
+ */
+__attribute__((naked)) void HardFault_Handler(void)
+{
+  __asm volatile(
+    "tst lr, #4                           \n"
+    "ite eq                               \n"
+    "mrseq r0, msp                        \n"
+    "mrsne r0, psp                        \n"
+    "b crash_dump_hard_fault_handler      \n"
+  );
+}
+
+/**
+ * @brief Finds dumps saved before reset, call it at start
+ */
+void crash_dump_init(void)
+{
+  crash.last_slot = CRASH_DUMP_NO_SLOT;
+  crash.dumps_count = 0;
+
+  for (uint8_t slot = 0; slot < CRASH_DUMP_SLOTS_COUNT; slot++)
+  {
+    if (dump_is_valid(slot))
+    {
+      crash.last_slot = slot;
+      crash.dumps_count++;
+    }
+  }
+
+  if (crash.dumps_count > 0)
+  {
+    NRF_LOG_WARNING("%d crash dumps are saved, see crashdump command", crash.dumps_count);
+  }
+}
+
+/**
+ * @brief Erases dumps cleared by CLI, call it from main loop
+ */
+void crash_dump_process(void)
+{
+  if (crash.is_clearing && nvmc_page_erase_process(NVMC_CRASH_PAGE_ADDR))
+  {
+    crash.is_clearing = false;
+  }
+}
+
+/**
+ * @brief Adds event to trace kept in RAM, it's saved in dump on fault.
+ *  Safe to call from any ISR.
+ */
+void crash_dump_trace(crash_trace_event_t event, uint16_t value)
+{
+  const crash_trace_t entry = {.ticks = app_timer_cnt_get(), .value = value, .event = event};
+
+  CRITICAL_REGION_ENTER();
+  crash.trace[crash.trace_next] = entry;
+  crash.trace_next = (crash.trace_next + 1) % CRASH_DUMP_TRACE_SIZE;
+  CRITICAL_REGION_EXIT();
+}
+
+static void words_print(char *line, size_t size, const char *title, const uint32_t *words, uint8_t count)
+{
+  size_t len = snprintf(line, size, "%s", title);
+
+  for (uint8_t idx = 0; idx < count && len < size; idx++)
+  {
+    len += snprintf(&line[len], size - len, " %08" PRIX32, words[idx]);
+  }
+}
+
+static void trace_print(char *line, size_t size, const crash_trace_t *trace, uint8_t count)
+{
+  size_t len = snprintf(line, size, "Trace:");
+
+  for (uint8_t idx = 0; idx < count && len < size; idx++)
+  {
+    len += snprintf(&line[len], size - len, " %06" PRIX32 ":%u:%u", trace[idx].ticks, trace[idx].event, trace[idx].value);
+  }
+}
+
+/**
+ * @brief Prints one line of the newest dump, PC and LR are resolved by addr2line with firmware image.
+ *  Trace is printed as ticks:event:value, see @ref crash_trace_event_t.
+ *
+ * @param part line of dump, less than CRASH_DUMP_PARTS_COUNT
+ * @return false if there is no dump or part is incorrect
+ */
+bool crash_dump_part_print(uint8_t part, char *line, size_t size)
+{
+  const crash_dump_t *saved;
+  char title[CRASH_DUMP_FILE_SIZE];
+  uint8_t idx;
+
+  if (crash.last_slot == CRASH_DUMP_NO_SLOT || part >= CRASH_DUMP_PARTS_COUNT)
+  {
+    return false;
+  }
+
+  saved = (const crash_dump_t*)slot_addr_get(crash.last_slot);
+
+  if (part == CRASH_DUMP_PART_SUMMARY)
+  {
+    snprintf(line, size, "Crashes %u, last: id %" PRIX32 " pc %08" PRIX32 " err %" PRIX32 " %s:%" PRIu32,
+             crash.dumps_count, saved->fault_id, saved->pc, saved->err_code,
+             saved->fault_id == CRASH_DUMP_HARD_FAULT ? "hard fault" : saved->file, saved->line);
+  }
+  else if (part == CRASH_DUMP_PART_FRAME)
+  {
+    words_print(line, size, "Frame:", saved->frame, CRASH_DUMP_FRAME_WORDS);
+  }
+  else if (part == CRASH_DUMP_PART_FAULT_STATUS)
+  {
+    snprintf(line, size, "CFSR %08" PRIX32 " HFSR %08" PRIX32 " MMFAR %08" PRIX32 " BFAR %08" PRIX32 " SP %08" PRIX32,
+             saved->cfsr, saved->hfsr, saved->mmfar, saved->bfar, saved->sp);
+  }
+  else if (part <= CRASH_DUMP_PART_STACK_END)
+  {
+    idx = (part - CRASH_DUMP_PART_STACK) * CRASH_DUMP_WORDS_PER_LINE;
+    snprintf(title, sizeof(title), "SP+%02u:", (unsigned int)(idx * sizeof(uint32_t)));
+    words_print(line, size, title, &saved->stack[idx], CRASH_DUMP_WORDS_PER_LINE);
+  }
+  else if (part <= CRASH_DUMP_PART_TRACE_END)
+  {
+    idx = (part - CRASH_DUMP_PART_TRACE) * CRASH_DUMP_TRACE_PER_LINE;
+    trace_print(line, size, &saved->trace[idx], CRASH_DUMP_TRACE_PER_LINE);
+  }
+  else
+  {
+    snprintf(line, size, "State: hsv %u,%u,%u mode %u dirs %02X flags %08" PRIX32,
+             saved->hsv.hue, saved->hsv.saturation, saved->hsv.brightness,
+             saved->led_mode, saved->directions, saved->flags);
+  }
+
+  return true;
+}
+
+/**
+ * @brief Drops all dumps, crash page is erased by @ref crash_dump_process
+ */
+void crash_dump_clear(void)
+{
+  crash.last_slot = CRASH_DUMP_NO_SLOT;
+  crash.dumps_count = 0;
+  crash.is_clearing = true;
+}
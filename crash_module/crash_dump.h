@@ -0,0 +1,23 @@
+#ifndef _CRASH_DUMP_H
+#define _CRASH_DUMP_H
+
+#include "nrfx.h"
+
+#define CRASH_DUMP_PARTS_COUNT          8       /* dump is printed by parts of one line */
+#define CRASH_DUMP_TRACE_SIZE           8       /* last events kept in dump */
+
+typedef enum crash_trace_event_e
+{
+  CRASH_TRACE_NONE,                             /* free entry of trace */
+  CRASH_TRACE_CLI_CMD,                          /* value is @ref cmd_t */
+  CRASH_TRACE_BTN,                              /* value is 1 if pressed, 0 if released */
+  CRASH_TRACE_LED_MODE,                         /* value is the new LED mode */
+} crash_trace_event_t;
+
+void crash_dump_init(void);
+void crash_dump_process(void);
+void crash_dump_trace(crash_trace_event_t event, uint16_t value);
+bool crash_dump_part_print(uint8_t part, char *line, size_t size);
+void crash_dump_clear(void);
+
+#endif /* _CRASH_DUMP_H */
@@ -0,0 +1,401 @@
+#include "effect.h"
+#include "nrf_assert.h"
+#include "nrf_atomic.h"
+#include "app_util_platform.h"
+#include "nrf_log.h"
+#include <string.h>
+
+#define EFFECT_COLOR_Q                  16
+#define EFFECT_LFSR_SEED                0xACE1U
+#define EFFECT_LFSR_TAPS                0xB400U
+
+STATIC_ASSERT(sizeof(effect_t) <= NVMC_KV_VALUE_MAX_SIZE);
+STATIC_ASSERT(NVMC_KV_KEY_EFFECT_3 - NVMC_KV_KEY_EFFECT_0 + 1 == EFFECT_SLOTS_COUNT);
+
+/* operands count of every instruction */
+static const uint8_t op_operands_size[EFFECT_OPS_COUNT] =
+{
+  [EFFECT_OP_END]     = 0,
+  [EFFECT_OP_LOOP]    = 0,
+  [EFFECT_OP_SET]     = 3,
+  [EFFECT_OP_FADE]    = 4,
+  [EFFECT_OP_HOLD]    = 1,
+  [EFFECT_OP_FLICKER] = 2,
+};
+
+/* Saved records in flash or edited copies, NULL if slot is empty, players read them in place */
+static const effect_t *effects[EFFECT_SLOTS_COUNT];
+/* CLI uploads that aren't saved yet, they are dropped when flash has the same effects */
+static effect_t effects_edited[EFFECT_SLOTS_COUNT];
+static uint8_t effects_edited_mask;
+static uint32_t effects_kv_version;
+static nrf_atomic_u32_t effects_ver;
+static const effect_t effect_empty;
+
+static bool effect_exec_op(effect_player_t *const player);
+static void effect_color_set(effect_player_t *const player, const uint8_t *rgb);
+static uint8_t effect_color_channel(const effect_player_t *const player, uint8_t channel);
+static uint16_t effect_color16_channel(const effect_player_t *const player, uint8_t channel);
+
+/**
+ * @brief Checks that every instruction is known, fits into code
+ *  and that effect can't loop forever without producing frames.
+ */
+bool effect_validate(const uint8_t *code, uint8_t size)
+{
+  uint8_t pc = 0;
+  uint8_t op;
+  bool has_frames = false;
+  bool has_loop = false;
+
+  if (size == 0 || size > EFFECT_CODE_MAX_SIZE)
+  {
+    return false;
+  }
+
+  while (pc < size)
+  {
+    op = code[pc];
+
+    if (op >= EFFECT_OPS_COUNT || pc + 1 + op_operands_size[op] > size)
+    {
+      return false;
+    }
+
+    if (op == EFFECT_OP_FADE || op == EFFECT_OP_HOLD || op == EFFECT_OP_FLICKER)
+    {
+      /* frames count is always the last operand */
+      if (code[pc + op_operands_size[op]] == 0)
+      {
+        return false;
+      }
+
+      has_frames = true;
+    }
+
+    has_loop |= (op == EFFECT_OP_LOOP);
+    pc += 1 + op_operands_size[op];
+  }
+
+  return has_frames || !has_loop;
+}
+
+static void effect_color_set(effect_player_t *const player, const uint8_t *rgb)
+{
+  for (uint8_t i = 0; i < 3; i++)
+  {
+    player->color[i] = (uint32_t)rgb[i] << EFFECT_COLOR_Q;
+    player->step[i] = 0;
+  }
+}
+
+static uint8_t effect_color_channel(const effect_player_t *const player, uint8_t channel)
+{
+  uint32_t value = (player->color[channel] + (1UL << (EFFECT_COLOR_Q - 1))) >> EFFECT_COLOR_Q;
+  return MIN(value, RGB_MAX_VALUE);
+}
+
+static uint16_t effect_color16_channel(const effect_player_t *const player, uint8_t channel)
+{
+  const uint8_t shift = EFFECT_COLOR_Q - RGB16_FRACTION_BITS;
+  uint32_t value = (player->color[channel] + (1UL << (shift - 1))) >> shift;
+  return MIN(value, RGB_MAX_VALUE << RGB16_FRACTION_BITS);
+}
+
+/**
+ * @brief Executes one instruction.
+ *
+ * @return false if effect is stopped, else true
+ */
+static bool effect_exec_op(effect_player_t *const player)
+{
+  const effect_t *effect = player->effect;
+  const uint8_t *args;
+  uint8_t op;
+
+  /* Effect may be replaced while playing, never read outside of code */
+  if (player->pc >= effect->size ||
+      effect->code[player->pc] >= EFFECT_OPS_COUNT ||
+      player->pc + 1 + op_operands_size[effect->code[player->pc]] > effect->size)
+  {
+    return false;
+  }
+
+  op = effect->code[player->pc];
+  args = &effect->code[player->pc + 1];
+
+  switch (op)
+  {
+    case EFFECT_OP_LOOP:
+      player->pc = 0;
+      return true;
+
+    case EFFECT_OP_SET:
+      effect_color_set(player, args);
+      break;
+
+    case EFFECT_OP_FADE:
+      for (uint8_t i = 0; i < 3; i++)
+      {
+        player->step[i] = (int32_t)(((uint32_t)args[i] << EFFECT_COLOR_Q) - player->color[i]) / args[3];
+      }
+      player->frames_left = args[3];
+      break;
+
+    case EFFECT_OP_HOLD:
+      memset(player->step, 0, sizeof(player->step));
+      player->frames_left = args[0];
+      break;
+
+    case EFFECT_OP_FLICKER:
+      memset(player->step, 0, sizeof(player->step));
+      player->base.red = effect_color_channel(player, 0);
+      player->base.green = effect_color_channel(player, 1);
+      player->base.blue = effect_color_channel(player, 2);
+      player->depth = args[0];
+      player->frames_left = args[1];
+      break;
+
+    default: /* EFFECT_OP_END */
+      return false;
+  }
+
+  player->op = op;
+  player->pc += 1 + op_operands_size[op];
+  return true;
+}
+
+void effect_player_start(effect_player_t *const player, const effect_t *const effect, rgb_params_t start_color)
+{
+  const uint8_t rgb[3] = {start_color.red, start_color.green, start_color.blue};
+
+  ASSERT(effect != NULL);
+
+  player->effect = effect;
+  player->pc = 0;
+  player->op = EFFECT_OP_END;
+  player->frames_left = 0;
+  player->lfsr = EFFECT_LFSR_SEED;
+  effect_color_set(player, rgb);
+}
+
+/**
+ * @brief Renders the next frame of effect. Doesn't allocate anything,
+ *  cost is a few instructions per frame.
+ *  Color keeps fractional part, so slow fades can be dithered.
+ */
+rgb16_params_t effect_player_next_frame(effect_player_t *const player)
+{
+  rgb16_params_t rgb;
+  uint8_t scale;
+
+  /* Bounded: effect can't contain more instructions than bytes */
+  for (uint8_t ops_cnt = 0; player->frames_left == 0 && ops_cnt < EFFECT_CODE_MAX_SIZE; ops_cnt++)
+  {
+    if (!effect_exec_op(player))
+    {
+      break;
+    }
+  }
+
+  if (player->frames_left > 0)
+  {
+    player->frames_left--;
+
+    if (player->op == EFFECT_OP_FLICKER)
+    {
+      /* Galois LFSR, x^16 + x^14 + x^13 + x^11 + 1 */
+      player->lfsr = (player->lfsr >> 1) ^ (-(player->lfsr & 1U) & EFFECT_LFSR_TAPS);
+      scale = RGB_MAX_VALUE - (((player->lfsr & 0xFFU) * player->depth) >> 8);
+
+      player->color[0] = ((uint32_t)player->base.red * scale) << (EFFECT_COLOR_Q - 8);
+      player->color[1] = ((uint32_t)player->base.green * scale) << (EFFECT_COLOR_Q - 8);
+      player->color[2] = ((uint32_t)player->base.blue * scale) << (EFFECT_COLOR_Q - 8);
+    }
+    else
+    {
+      for (uint8_t i = 0; i < 3; i++)
+      {
+        player->color[i] += player->step[i];
+      }
+    }
+  }
+
+  rgb.red = effect_color16_channel(player, 0);
+  rgb.green = effect_color16_channel(player, 1);
+  rgb.blue = effect_color16_channel(player, 2);
+
+  return rgb;
+}
+
+/**
+ * @return valid not empty effect saved in slot or NULL
+ */
+static const effect_t* effect_saved_get(uint8_t slot)
+{
+  const effect_t *saved = nvmc_kv_get_ptr(NVMC_KV_KEY_EFFECT_0 + slot, sizeof(effect_t));
+
+  /* Save command writes every slot, empty ones too */
+  return saved != NULL && saved->size != 0 && effect_validate(saved->code, saved->size) ? saved : NULL;
+}
+
+/**
+ * @brief Takes pointers to saved effects again if store was changed: records are moved
+ *  by compaction and old page is erased after it. Called from PWM and button interrupts and CLI.
+ */
+static void effects_refresh(void)
+{
+  const effect_t *saved;
+  bool is_changed = false;
+
+  CRITICAL_REGION_ENTER();
+
+  if (effects_kv_version != nvmc_kv_version())
+  {
+    effects_kv_version = nvmc_kv_version();
+
+    for (uint8_t slot = 0; slot < EFFECT_SLOTS_COUNT; slot++)
+    {
+      saved = effect_saved_get(slot);
+
+      /* Upload isn't saved yet */
+      if ((effects_edited_mask & (1U << slot)) != 0 &&
+          (saved == NULL ? effects_edited[slot].size != 0 :
+                           memcmp(saved, &effects_edited[slot], sizeof(*saved)) != 0))
+      {
+        continue;
+      }
+
+      effects_edited_mask &= ~(1U << slot);
+      is_changed |= (effects[slot] != saved);
+      effects[slot] = saved;
+    }
+
+    /* Players restart from records at new place */
+    if (is_changed)
+    {
+      nrf_atomic_u32_add(&effects_ver, 1);
+    }
+  }
+
+  CRITICAL_REGION_EXIT();
+}
+
+/**
+ * @brief Takes effects saved in flash
+ */
+void effects_init(void)
+{
+  effects_edited_mask = 0;
+
+  for (uint8_t slot = 0; slot < EFFECT_SLOTS_COUNT; slot++)
+  {
+    const effect_t *saved = nvmc_kv_get_ptr(NVMC_KV_KEY_EFFECT_0 + slot, sizeof(effect_t));
+
+    effects[slot] = effect_saved_get(slot);
+
+    if (effects[slot] == NULL && saved != NULL && saved->size != 0)
+    {
+      NRF_LOG_WARNING("Saved effect %d is broken, slot is cleared", slot);
+    }
+  }
+
+  effects_kv_version = nvmc_kv_version();
+  nrf_atomic_u32_add(&effects_ver, 1);
+}
+
+/**
+ * @brief Returns count of not empty slots
+ */
+uint8_t effects_count(void)
+{
+  uint8_t count = 0;
+
+  effects_refresh();
+
+  for (uint8_t slot = 0; slot < EFFECT_SLOTS_COUNT; slot++)
+  {
+    count += (effects[slot] != NULL);
+  }
+
+  return count;
+}
+
+/**
+ * @brief Returns idx-th not empty effect or NULL
+ */
+const effect_t* effects_get(uint8_t idx)
+{
+  effects_refresh();
+
+  for (uint8_t slot = 0; slot < EFFECT_SLOTS_COUNT; slot++)
+  {
+    if (effects[slot] != NULL)
+    {
+      if (idx == 0)
+      {
+        return effects[slot];
+      }
+
+      idx--;
+    }
+  }
+
+  return NULL;
+}
+
+/**
+ * @brief Counter that is changed on every effects update,
+ *  players should restart if it was changed.
+ */
+uint32_t effects_version(void)
+{
+  return effects_ver;
+}
+
+/**
+ * @brief Record of slot, it's saved in one batch with the rest of configuration
+ */
+nvmc_kv_item_t effect_kv_item_get(uint8_t slot)
+{
+  nvmc_kv_item_t item = {.key = NVMC_KV_KEY_EFFECT_0 + slot, .value = &effect_empty, .size = sizeof(effect_t)};
+
+  ASSERT(slot < EFFECT_SLOTS_COUNT);
+
+  effects_refresh();
+
+  if (effects[slot] != NULL)
+  {
+    item.value = effects[slot];
+  }
+
+  return item;
+}
+
+/**
+ * @brief Replaces effect in slot. Effect is cleared if size is 0.
+ *
+ * @return false if slot or code is incorrect, else true
+ */
+bool effects_upload(uint8_t slot, const uint8_t *code, uint8_t size)
+{
+  effect_t effect = {.size = size};
+
+  if (slot >= EFFECT_SLOTS_COUNT || (size != 0 && !effect_validate(code, size)))
+  {
+    return false;
+  }
+
+  memcpy(effect.code, code, size);
+
+  /* Players and effects_get() run in PWM interrupt, they see either old or new effect.
+   * Edited copy is read until save command writes it. */
+  CRITICAL_REGION_ENTER();
+  effects_edited[slot] = effect;
+  effects_edited_mask |= 1U << slot;
+  effects[slot] = size != 0 ? &effects_edited[slot] : NULL;
+  nrf_atomic_u32_add(&effects_ver, 1);
+  CRITICAL_REGION_EXIT();
+
+  return true;
+}
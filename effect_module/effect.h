@@ -0,0 +1,57 @@
+#ifndef _EFFECT_H
+#define _EFFECT_H
+
+#include "nrfx.h"
+#include "hsv_to_rgb.h"
+#include "nvmc_kv.h"
+
+#define EFFECT_SLOTS_COUNT              4
+#define EFFECT_CODE_MAX_SIZE            43      /* hex string of this size fits into one CLI line */
+
+/**
+ * @brief Effect bytecode. Every instruction is one opcode byte followed by operands.
+ *  Instructions that have frames operand take that count of frames to play,
+ *  frames count MUST be greater than 0.
+ */
+typedef enum effect_op_e
+{
+  EFFECT_OP_END       = 0x00,   /* END: hold current color forever */
+  EFFECT_OP_LOOP      = 0x01,   /* LOOP: continue from the first instruction */
+  EFFECT_OP_SET       = 0x02,   /* SET r g b: change color immediately */
+  EFFECT_OP_FADE      = 0x03,   /* FADE r g b frames: linear fade from current color */
+  EFFECT_OP_HOLD      = 0x04,   /* HOLD frames: keep current color */
+  EFFECT_OP_FLICKER   = 0x05,   /* FLICKER depth frames: random dimming of current color up to depth/255 */
+  EFFECT_OPS_COUNT
+} effect_op_t;
+
+typedef struct effect_s
+{
+  uint8_t size;                         /* 0 means empty slot */
+  uint8_t code[EFFECT_CODE_MAX_SIZE];
+} effect_t;
+
+typedef struct effect_player_s
+{
+  const effect_t *effect;
+  uint32_t color[3];        /* current red, green, blue in Q16 */
+  int32_t step[3];          /* color change per frame in Q16 */
+  rgb_params_t base;        /* color to flicker from */
+  uint16_t lfsr;            /* flicker noise state */
+  uint8_t pc;               /* offset of the next instruction */
+  uint8_t op;               /* instruction that produces frames now */
+  uint8_t frames_left;      /* frames left for current instruction */
+  uint8_t depth;            /* flicker depth */
+} effect_player_t;
+
+bool effect_validate(const uint8_t *code, uint8_t size);
+void effect_player_start(effect_player_t *const player, const effect_t *const effect, rgb_params_t start_color);
+rgb16_params_t effect_player_next_frame(effect_player_t *const player);
+
+void effects_init(void);
+uint8_t effects_count(void);
+const effect_t* effects_get(uint8_t idx);
+uint32_t effects_version(void);
+bool effects_upload(uint8_t slot, const uint8_t *code, uint8_t size);
+nvmc_kv_item_t effect_kv_item_get(uint8_t slot);
+
+#endif /* _EFFECT_H */
@@ -6,6 +6,7 @@
 #include "app_timer.h"
 #include "hsv_to_rgb.h"
 #include "pwm_config.h"
+#include "app_state.h"
 
 typedef struct g_pwm_config_s
 {
@@ -15,29 +16,15 @@ typedef struct g_pwm_config_s
   nrf_pwm_values_individual_t sequence_values;
 } g_pwm_config_t;
 
-typedef struct g_app_flags_s /* contains only flags */
-{
-  bool app_is_running;        /* true if application should change value depending on mode, else false */
-  bool fst_click_occurred;    /* true if first click was occurred */
-  bool btn_pressed;           /* false if released, true if pressed now */
-  bool btn_is_disabled;       /* true if btn won't do anything except @ref btn_state changing, else false */
-} g_app_flags_t;
-
-typedef struct g_app_data_s
-{
-  g_app_flags_t flags;
-  hsv_params_t current_hsv;
-  uint8_t current_led_mode; /* current LED mode */
-} g_app_data_t;
-
-extern g_app_data_t g_app_data;
+#define EFFECT_MODE_INDICATOR_STEP    256    /* indicator step of every effect mode */
 
 static const uint16_t step_list[] =
 {
     0,
     16,
     64,
-    PWM_INDICATOR_TOP_VALUE
+    PWM_INDICATOR_TOP_VALUE,
+    128
 };
 
 
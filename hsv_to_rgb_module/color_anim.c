@@ -0,0 +1,138 @@
+#include "color_anim.h"
+#include "nrf_assert.h"
+
+static void update_outputs(color_anim_channel_t *const ch);
+
+uint32_t color_easing_linear(uint32_t x)
+{
+  return x;
+}
+
+/**
+ * @brief Quadratic ease in: x^2
+ */
+uint32_t color_easing_in(uint32_t x)
+{
+  return (uint32_t)(((uint64_t)x * x) >> COLOR_ANIM_Q);
+}
+
+/**
+ * @brief Smoothstep ease in-out: 3x^2 - 2x^3
+ */
+uint32_t color_easing_in_out(uint32_t x)
+{
+  uint32_t x2 = (uint32_t)(((uint64_t)x * x) >> COLOR_ANIM_Q);
+  return (uint32_t)(((uint64_t)x2 * (3 * COLOR_ANIM_ONE - 2 * x)) >> COLOR_ANIM_Q);
+}
+
+/**
+ * @brief Recalculates value and render_value using current phase.
+ */
+static void update_outputs(color_anim_channel_t *const ch)
+{
+  const uint32_t half = (uint32_t)ch->max_value << COLOR_ANIM_Q;
+  uint32_t pos = ch->phase < half ? ch->phase : 2 * half - ch->phase;
+  uint32_t fraction = ch->easing(pos / ch->max_value);
+
+  ch->value = (fraction * ch->max_value + (COLOR_ANIM_ONE >> 1)) >> COLOR_ANIM_Q;
+  ch->render_value = (fraction * COLOR_ANIM_RENDER_MAX + (COLOR_ANIM_ONE >> 1)) >> COLOR_ANIM_Q;
+}
+
+void color_anim_channel_init(color_anim_channel_t *const ch, uint16_t max_value, color_easing_t easing)
+{
+  ASSERT(max_value > 0);
+  ASSERT(easing != NULL);
+
+  ch->phase = 0;
+  ch->phase_step = 0;
+  ch->max_value = max_value;
+  ch->easing = easing;
+  update_outputs(ch);
+}
+
+/**
+ * @brief Sets channel speed.
+ *
+ * @param units_per_sec how many units of [0; max_value] are passed in one second
+ * @param tick_us time between two ticks, see @ref color_anim_channel_advance
+ */
+void color_anim_channel_speed_set(color_anim_channel_t *const ch, uint16_t units_per_sec, uint32_t tick_us)
+{
+  ch->phase_step = (uint32_t)((((uint64_t)units_per_sec << COLOR_ANIM_Q) * tick_us) / 1000000U);
+}
+
+/**
+ * @brief Moves channel to value that was set outside of animation.
+ *  Counting direction is kept.
+ */
+void color_anim_channel_sync(color_anim_channel_t *const ch, uint16_t value)
+{
+  const uint32_t half = (uint32_t)ch->max_value << COLOR_ANIM_Q;
+  const uint32_t target = ((uint32_t)value << COLOR_ANIM_Q) / ch->max_value;
+  const bool count_down = ch->phase >= half;
+  uint32_t low = 0;
+  uint32_t high = COLOR_ANIM_ONE;
+  uint32_t mid;
+  uint32_t pos;
+
+  ASSERT(value <= ch->max_value);
+
+  /* Easing is monotonic, find the first x where easing(x) >= target */
+  while (low < high)
+  {
+    mid = (low + high) >> 1;
+
+    if (ch->easing(mid) < target)
+    {
+      low = mid + 1;
+    }
+    else
+    {
+      high = mid;
+    }
+  }
+
+  pos = low * ch->max_value;
+  ch->phase = (count_down && pos > 0) ? 2 * half - pos : pos;
+
+  update_outputs(ch);
+  ch->value = value;
+}
+
+bool color_anim_channel_is_counting_down(const color_anim_channel_t *const ch)
+{
+  return ch->phase >= ((uint32_t)ch->max_value << COLOR_ANIM_Q);
+}
+
+/**
+ * @brief Changes counting direction, value is kept: phase is mirrored into the other half of wave.
+ *  Ends of wave belong to one direction only, so they are moved one step inside the other half.
+ */
+void color_anim_channel_direction_set(color_anim_channel_t *const ch, bool count_down)
+{
+  const uint32_t half = (uint32_t)ch->max_value << COLOR_ANIM_Q;
+
+  if (count_down == color_anim_channel_is_counting_down(ch))
+  {
+    return;
+  }
+
+  ch->phase = MIN(2 * half - ch->phase, (count_down ? 2 * half : half) - 1);
+  update_outputs(ch);
+}
+
+/**
+ * @brief Advances channel by given ticks count.
+ *
+ * @return true if rendered value was changed, else false
+ */
+bool color_anim_channel_advance(color_anim_channel_t *const ch, uint16_t ticks)
+{
+  const uint32_t period = (uint32_t)ch->max_value << (COLOR_ANIM_Q + 1);
+  uint8_t prev_render_value = ch->render_value;
+
+  ch->phase = (uint32_t)(((uint64_t)ch->phase_step * ticks + ch->phase) % period);
+  update_outputs(ch);
+
+  return ch->render_value != prev_render_value;
+}
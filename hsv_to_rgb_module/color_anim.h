@@ -0,0 +1,41 @@
+#ifndef _COLOR_ANIM_H
+#define _COLOR_ANIM_H
+
+#include <nrfx.h>
+
+#define COLOR_ANIM_Q                    16
+#define COLOR_ANIM_ONE                  (1UL << COLOR_ANIM_Q)       /* 1.0 in Q16 */
+#define COLOR_ANIM_RENDER_MAX           255                         /* resolution of rendered value */
+
+/**
+ * @brief Easing curve. Maps Q16 fraction [0; COLOR_ANIM_ONE] to Q16 fraction [0; COLOR_ANIM_ONE].
+ *  Must be monotonic, 0 and COLOR_ANIM_ONE must be mapped to themselves.
+ */
+typedef uint32_t (*color_easing_t)(uint32_t x);
+
+/**
+ * @brief One animated value. Counts from 0 to max_value and back,
+ *  position is stored as Q16 phase so speed isn't limited by tick rate.
+ */
+typedef struct color_anim_channel_s
+{
+  uint32_t phase;           /* Q16 position on triangle wave, [0; 2 * max_value) */
+  uint32_t phase_step;      /* Q16 phase increment per tick */
+  color_easing_t easing;
+  uint16_t max_value;
+  uint16_t value;           /* last output in [0; max_value] */
+  uint8_t render_value;     /* last output in [0; COLOR_ANIM_RENDER_MAX] */
+} color_anim_channel_t;
+
+uint32_t color_easing_linear(uint32_t x);
+uint32_t color_easing_in(uint32_t x);
+uint32_t color_easing_in_out(uint32_t x);
+
+void color_anim_channel_init(color_anim_channel_t *const ch, uint16_t max_value, color_easing_t easing);
+void color_anim_channel_speed_set(color_anim_channel_t *const ch, uint16_t units_per_sec, uint32_t tick_us);
+void color_anim_channel_sync(color_anim_channel_t *const ch, uint16_t value);
+bool color_anim_channel_is_counting_down(const color_anim_channel_t *const ch);
+void color_anim_channel_direction_set(color_anim_channel_t *const ch, bool count_down);
+bool color_anim_channel_advance(color_anim_channel_t *const ch, uint16_t ticks);
+
+#endif /* _COLOR_ANIM_H */
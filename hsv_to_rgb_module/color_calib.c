@@ -0,0 +1,199 @@
+#include "color_calib.h"
+#include "nrf_log.h"
+#include "nrf_assert.h"
+#include "app_util_platform.h"
+#include <string.h>
+
+STATIC_ASSERT(sizeof(color_calib_t) <= NVMC_KV_VALUE_MAX_SIZE);
+
+static const color_calib_t color_calib_identity =
+{
+  .matrix =
+  {
+    {COLOR_CALIB_ONE, 0, 0},
+    {0, COLOR_CALIB_ONE, 0},
+    {0, 0, COLOR_CALIB_ONE},
+  },
+  .offset = {0, 0, 0},
+};
+
+/* Saved record in flash, edited copy or identity, renderer reads it in place */
+static const color_calib_t *color_calib = &color_calib_identity;
+static bool color_calib_is_identity = true;
+/* CLI edit that isn't saved yet, it's dropped when flash has the same calibration */
+static color_calib_t color_calib_edited;
+static bool color_calib_is_edited = false;
+static uint32_t color_calib_kv_version;
+
+static bool color_calib_is_valid(const color_calib_t *const calib)
+{
+  for (uint8_t row = 0; row < 3; row++)
+  {
+    for (uint8_t col = 0; col < 3; col++)
+    {
+      if (calib->matrix[row][col] > COLOR_CALIB_COEF_MAX || calib->matrix[row][col] < -COLOR_CALIB_COEF_MAX)
+      {
+        return false;
+      }
+    }
+
+    if (calib->offset[row] > COLOR_CALIB_OFFSET_MAX || calib->offset[row] < -COLOR_CALIB_OFFSET_MAX)
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/**
+ * @return valid calibration saved in flash or NULL
+ */
+static const color_calib_t* color_calib_saved_get(void)
+{
+  const color_calib_t *saved = nvmc_kv_get_ptr(NVMC_KV_KEY_COLOR_CALIB, sizeof(color_calib_t));
+
+  return saved != NULL && color_calib_is_valid(saved) ? saved : NULL;
+}
+
+static void color_calib_publish(const color_calib_t *const calib)
+{
+  color_calib = calib;
+  color_calib_is_identity = !memcmp(calib, &color_calib_identity, sizeof(*calib));
+}
+
+/**
+ * @brief Takes pointer to saved calibration again if store was changed: record is moved
+ *  by compaction and old page is erased after it. Called from PWM interrupt and CLI.
+ */
+static void color_calib_refresh(void)
+{
+  const color_calib_t *saved;
+
+  CRITICAL_REGION_ENTER();
+
+  if (color_calib_kv_version != nvmc_kv_version())
+  {
+    color_calib_kv_version = nvmc_kv_version();
+    saved = color_calib_saved_get();
+
+    if (!color_calib_is_edited)
+    {
+      color_calib_publish(saved != NULL ? saved : &color_calib_identity);
+    }
+    else if (saved != NULL && !memcmp(saved, &color_calib_edited, sizeof(*saved)))
+    {
+      /* Edit is saved */
+      color_calib_is_edited = false;
+      color_calib_publish(saved);
+    }
+  }
+
+  CRITICAL_REGION_EXIT();
+}
+
+/**
+ * @brief Takes calibration from flash, identity is used if there is no one
+ */
+void color_calib_init(void)
+{
+  const color_calib_t *saved = color_calib_saved_get();
+
+  if (saved == NULL && nvmc_kv_get_ptr(NVMC_KV_KEY_COLOR_CALIB, sizeof(color_calib_t)) != NULL)
+  {
+    NRF_LOG_WARNING("Saved calibration is broken, identity is used");
+  }
+
+  color_calib_is_edited = false;
+  color_calib_kv_version = nvmc_kv_version();
+  color_calib_publish(saved != NULL ? saved : &color_calib_identity);
+}
+
+/**
+ * @brief Record of calibration, it's saved in one batch with the rest of configuration
+ */
+nvmc_kv_item_t color_calib_kv_item_get(void)
+{
+  nvmc_kv_item_t item = {.key = NVMC_KV_KEY_COLOR_CALIB, .size = sizeof(color_calib_t)};
+
+  color_calib_refresh();
+  item.value = color_calib;
+
+  return item;
+}
+
+/**
+ * @brief Changes one row of calibration, it's written to flash by save command.
+ *  Until then renderer reads the edited copy in RAM.
+ *
+ * @param row output channel: 0 - red, 1 - green, 2 - blue
+ * @param coefs Q12 coefficients of input red, green and blue
+ * @param offset offset in rgb16 units
+ * @return false if values are out of range
+ */
+bool color_calib_row_set(uint8_t row, const int16_t coefs[3], int16_t offset)
+{
+  color_calib_t calib;
+
+  if (row >= 3)
+  {
+    return false;
+  }
+
+  color_calib_refresh();
+  calib = *color_calib;
+  memcpy(calib.matrix[row], coefs, sizeof(calib.matrix[row]));
+  calib.offset[row] = offset;
+
+  if (!color_calib_is_valid(&calib))
+  {
+    return false;
+  }
+
+  /* Renderer runs in PWM interrupt, it sees either old or new calibration */
+  CRITICAL_REGION_ENTER();
+  color_calib_edited = calib;
+  color_calib_is_edited = true;
+  color_calib_publish(&color_calib_edited);
+  CRITICAL_REGION_EXIT();
+
+  return true;
+}
+
+static inline uint16_t color_calib_channel(const int16_t coefs[3], int16_t offset, const rgb16_params_t *const rgb)
+{
+  int32_t value = coefs[0] * (int32_t)rgb->red + coefs[1] * (int32_t)rgb->green + coefs[2] * (int32_t)rgb->blue;
+
+  value = (value >> COLOR_CALIB_Q) + offset;
+
+  return MIN(MAX(value, 0), (int32_t)(RGB_MAX_VALUE << RGB16_FRACTION_BITS));
+}
+
+/**
+ * @brief Applies calibration to colors in place, 9 MACs per color.
+ *  It's called once per rendered frame, not per PWM period.
+ *  Saved calibration is read from flash, nothing is copied.
+ */
+void color_calib_apply(rgb16_params_t *rgb, uint8_t count)
+{
+  const color_calib_t *calib;
+  rgb16_params_t in;
+
+  color_calib_refresh();
+
+  if (color_calib_is_identity)
+  {
+    return;
+  }
+
+  calib = color_calib;
+
+  while (count--)
+  {
+    in = *rgb;
+    rgb->red = color_calib_channel(calib->matrix[0], calib->offset[0], &in);
+    rgb->green = color_calib_channel(calib->matrix[1], calib->offset[1], &in);
+    rgb->blue = color_calib_channel(calib->matrix[2], calib->offset[2], &in);
+    rgb++;
+  }
+}
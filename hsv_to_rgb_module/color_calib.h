@@ -0,0 +1,28 @@
+#ifndef _COLOR_CALIB_H
+#define _COLOR_CALIB_H
+
+#include "nrfx.h"
+#include "hsv_to_rgb.h"
+#include "nvmc_kv.h"
+
+#define COLOR_CALIB_Q                   12
+#define COLOR_CALIB_ONE                 (1 << COLOR_CALIB_Q)
+#define COLOR_CALIB_COEF_MAX            (2 * COLOR_CALIB_ONE)    /* keeps 3 products of rgb16 in int32 */
+#define COLOR_CALIB_OFFSET_MAX          (INT8_MAX << RGB16_FRACTION_BITS)
+
+/**
+ * @brief Calibration of one unit: out = matrix * in + offset.
+ *  Rows are output red, green and blue, columns are input ones.
+ */
+typedef struct color_calib_s
+{
+  int16_t matrix[3][3];     /* Q12 */
+  int16_t offset[3];        /* in rgb16 units */
+} color_calib_t;
+
+void color_calib_init(void);
+bool color_calib_row_set(uint8_t row, const int16_t coefs[3], int16_t offset);
+void color_calib_apply(rgb16_params_t *rgb, uint8_t count);
+nvmc_kv_item_t color_calib_kv_item_get(void);
+
+#endif /* _COLOR_CALIB_H */
@@ -0,0 +1,159 @@
+#include "color_cct.h"
+#include "nrf_assert.h"
+
+#define CCT_TABLE_SIZE                  ((CCT_MAX_KELVIN - CCT_MIN_KELVIN) / CCT_TABLE_STEP_KELVIN + 1)
+
+/**
+ * Blackbody color for every CCT_TABLE_STEP_KELVIN, normalized to the brightest channel.
+ *  Values are Tanner Helland's fit of Mitchell Charity's blackbody sRGB table,
+ *  converted from sRGB gamma into linear duty, because LED brightness is linear by duty.
+ */
+static const rgb16_params_t cct_table[CCT_TABLE_SIZE] =
+{
+  {65280,  3765,     0},   /*  1000K */
+  {65280,  4896,     0},   /*  1100K */
+  {65280,  6083,     0},   /*  1200K */
+  {65280,  7310,     0},   /*  1300K */
+  {65280,  8565,     0},   /*  1400K */
+  {65280,  9838,     0},   /*  1500K */
+  {65280, 11124,     0},   /*  1600K */
+  {65280, 12416,     0},   /*  1700K */
+  {65280, 13711,     0},   /*  1800K */
+  {65280, 15005,     0},   /*  1900K */
+  {65280, 16296,   284},   /*  2000K */
+  {65280, 17583,   720},   /*  2100K */
+  {65280, 18862,  1334},   /*  2200K */
+  {65280, 20135,  2101},   /*  2300K */
+  {65280, 21399,  2999},   /*  2400K */
+  {65280, 22653,  4006},   /*  2500K */
+  {65280, 23898,  5105},   /*  2600K */
+  {65280, 25133,  6282},   /*  2700K */
+  {65280, 26357,  7524},   /*  2800K */
+  {65280, 27570,  8820},   /*  2900K */
+  {65280, 28773, 10163},   /*  3000K */
+  {65280, 29965, 11544},   /*  3100K */
+  {65280, 31146, 12957},   /*  3200K */
+  {65280, 32316, 14397},   /*  3300K */
+  {65280, 33476, 15860},   /*  3400K */
+  {65280, 34624, 17341},   /*  3500K */
+  {65280, 35762, 18837},   /*  3600K */
+  {65280, 36890, 20346},   /*  3700K */
+  {65280, 38007, 21863},   /*  3800K */
+  {65280, 39114, 23389},   /*  3900K */
+  {65280, 40211, 24920},   /*  4000K */
+  {65280, 41297, 26455},   /*  4100K */
+  {65280, 42374, 27992},   /*  4200K */
+  {65280, 43441, 29531},   /*  4300K */
+  {65280, 44499, 31070},   /*  4400K */
+  {65280, 45547, 32608},   /*  4500K */
+  {65280, 46586, 34145},   /*  4600K */
+  {65280, 47616, 35679},   /*  4700K */
+  {65280, 48636, 37210},   /*  4800K */
+  {65280, 49648, 38737},   /*  4900K */
+  {65280, 50652, 40261},   /*  5000K */
+  {65280, 51647, 41780},   /*  5100K */
+  {65280, 52634, 43294},   /*  5200K */
+  {65280, 53612, 44803},   /*  5300K */
+  {65280, 54582, 46306},   /*  5400K */
+  {65280, 55545, 47804},   /*  5500K */
+  {65280, 56500, 49295},   /*  5600K */
+  {65280, 57447, 50781},   /*  5700K */
+  {65280, 58386, 52260},   /*  5800K */
+  {65280, 59318, 53733},   /*  5900K */
+  {65280, 60243, 55199},   /*  6000K */
+  {65280, 61161, 56659},   /*  6100K */
+  {65280, 62072, 58112},   /*  6200K */
+  {65280, 62975, 59558},   /*  6300K */
+  {65280, 63873, 60997},   /*  6400K */
+  {65280, 64763, 62430},   /*  6500K */
+  {65280, 65280, 65280},   /*  6600K */
+  {64941, 61698, 65280},   /*  6700K */
+  {62367, 60301, 65280},   /*  6800K */
+  {60184, 59096, 65280},   /*  6900K */
+  {58297, 58038, 65280},   /*  7000K */
+  {56642, 57099, 65280},   /*  7100K */
+  {55173, 56254, 65280},   /*  7200K */
+  {53857, 55489, 65280},   /*  7300K */
+  {52667, 54790, 65280},   /*  7400K */
+  {51583, 54147, 65280},   /*  7500K */
+  {50590, 53553, 65280},   /*  7600K */
+  {49675, 53000, 65280},   /*  7700K */
+  {48828, 52485, 65280},   /*  7800K */
+  {48040, 52003, 65280},   /*  7900K */
+  {47305, 51549, 65280},   /*  8000K */
+  {46616, 51121, 65280},   /*  8100K */
+  {45969, 50717, 65280},   /*  8200K */
+  {45359, 50333, 65280},   /*  8300K */
+  {44783, 49969, 65280},   /*  8400K */
+  {44238, 49622, 65280},   /*  8500K */
+  {43720, 49291, 65280},   /*  8600K */
+  {43228, 48975, 65280},   /*  8700K */
+  {42759, 48672, 65280},   /*  8800K */
+  {42312, 48381, 65280},   /*  8900K */
+  {41884, 48103, 65280},   /*  9000K */
+  {41475, 47834, 65280},   /*  9100K */
+  {41082, 47576, 65280},   /*  9200K */
+  {40706, 47327, 65280},   /*  9300K */
+  {40343, 47087, 65280},   /*  9400K */
+  {39995, 46855, 65280},   /*  9500K */
+  {39659, 46631, 65280},   /*  9600K */
+  {39335, 46414, 65280},   /*  9700K */
+  {39023, 46203, 65280},   /*  9800K */
+  {38721, 45999, 65280},   /*  9900K */
+  {38429, 45801, 65280},   /* 10000K */
+};
+
+STATIC_ASSERT((CCT_MAX_KELVIN - CCT_MIN_KELVIN) % CCT_TABLE_STEP_KELVIN == 0);
+
+static inline uint16_t cct_lerp(uint16_t from, uint16_t to, uint32_t frac)
+{
+  return from + (((int32_t)to - from) * (int32_t)frac) / CCT_TABLE_STEP_KELVIN;
+}
+
+/**
+ * @brief Returns blackbody color of full brightness, interpolated between table entries
+ *
+ * @param kelvin temperature, clamped to [CCT_MIN_KELVIN; CCT_MAX_KELVIN]
+ */
+rgb16_params_t cct_to_rgb16(uint16_t kelvin)
+{
+  uint32_t offset;
+  uint32_t idx;
+  uint32_t frac;
+
+  kelvin = MIN(MAX(kelvin, CCT_MIN_KELVIN), CCT_MAX_KELVIN);
+  offset = kelvin - CCT_MIN_KELVIN;
+  idx = offset / CCT_TABLE_STEP_KELVIN;
+  frac = offset % CCT_TABLE_STEP_KELVIN;
+
+  if (frac == 0)
+  {
+    return cct_table[idx];
+  }
+
+  return (rgb16_params_t)
+  {
+    .red = cct_lerp(cct_table[idx].red, cct_table[idx + 1].red, frac),
+    .green = cct_lerp(cct_table[idx].green, cct_table[idx + 1].green, frac),
+    .blue = cct_lerp(cct_table[idx].blue, cct_table[idx + 1].blue, frac)
+  };
+}
+
+/**
+ * @brief Returns blackbody color with brightness
+ *
+ * @param[in] kelvin temperature, clamped to [CCT_MIN_KELVIN; CCT_MAX_KELVIN]
+ * @param[in] brightness brightness in [0; BRIGHT_MAX_VALUE]
+ * @param[out] rgb color
+ */
+void cct_to_rgb(uint16_t kelvin, uint8_t brightness, rgb_params_t *const rgb)
+{
+  const rgb16_params_t rgb16 = cct_to_rgb16(kelvin);
+  const uint32_t divider = BRIGHT_MAX_VALUE << RGB16_FRACTION_BITS;
+
+  ASSERT(brightness <= BRIGHT_MAX_VALUE);
+
+  rgb->red = ((uint32_t)rgb16.red * brightness + divider / 2) / divider;
+  rgb->green = ((uint32_t)rgb16.green * brightness + divider / 2) / divider;
+  rgb->blue = ((uint32_t)rgb16.blue * brightness + divider / 2) / divider;
+}
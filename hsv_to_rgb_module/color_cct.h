@@ -0,0 +1,16 @@
+#ifndef _COLOR_CCT_H
+#define _COLOR_CCT_H
+
+#include "nrfx.h"
+#include "hsv_to_rgb.h"
+
+#define CCT_MIN_KELVIN                  1000
+#define CCT_MAX_KELVIN                  10000
+#define CCT_TABLE_STEP_KELVIN           100
+#define CCT_ANIM_UNIT_KELVIN            10      /* kelvins in one unit of CCT_CHANGE animation */
+#define CCT_ANIM_DEFAULT_SPEED          50      /* units per second */
+
+rgb16_params_t cct_to_rgb16(uint16_t kelvin);
+void cct_to_rgb(uint16_t kelvin, uint8_t brightness, rgb_params_t *const rgb);
+
+#endif /* _COLOR_CCT_H */
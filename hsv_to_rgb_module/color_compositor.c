@@ -0,0 +1,213 @@
+#include "color_compositor.h"
+#include "nrf_atomic.h"
+#include "nrf_assert.h"
+
+#define RGB16_MAX_VALUE                 ((uint32_t)RGB_MAX_VALUE << RGB16_FRACTION_BITS)
+#define LAYER_ALPHA_Q                   8       /* rendering alpha is [0; 1 << LAYER_ALPHA_Q] */
+
+STATIC_ASSERT(COLOR_LAYERS_COUNT <= 32);
+
+/**
+ * @brief Owner writes pending layer, compositor takes it before the next frames.
+ *  Pending bit is cleared while layer is written, so a half written layer is never taken.
+ */
+typedef struct color_layer_slot_s
+{
+  color_layer_t pending;          /* written only by owner */
+  color_layer_t layer;            /* the rest is accessed only by compositor */
+  uint32_t elapsed_frames;
+  uint32_t duration_frames;       /* 0 - no expiry */
+  uint32_t period_frames;
+  uint32_t phase_frames;          /* position in pattern period */
+} color_layer_slot_t;
+
+static color_layer_slot_t layer_slots[COLOR_LAYERS_COUNT];
+static nrf_atomic_u32_t pending_mask;
+static uint32_t active_mask;
+static uint32_t compositor_frame_us;
+
+static uint32_t frames_by_ms(uint16_t ms)
+{
+  uint32_t frames = (uint32_t)ms * 1000 / compositor_frame_us;
+  return frames > 0 ? frames : 1;
+}
+
+/**
+ * @brief Takes layers that were changed by owners since the last frames.
+ */
+static void layers_update(void)
+{
+  uint32_t mask = nrf_atomic_u32_fetch_store(&pending_mask, 0);
+
+  for (uint8_t id = 0; mask != 0; id++, mask >>= 1)
+  {
+    color_layer_slot_t *const slot = &layer_slots[id];
+
+    if (!(mask & 1))
+    {
+      continue;
+    }
+
+    slot->layer = slot->pending;
+    slot->elapsed_frames = 0;
+    slot->phase_frames = 0;
+    slot->duration_frames = slot->layer.duration_ms == COLOR_LAYER_NO_EXPIRY ? 0 : frames_by_ms(slot->layer.duration_ms);
+    slot->period_frames = slot->layer.pattern == COLOR_PATTERN_SOLID ? 1 : frames_by_ms(slot->layer.period_ms);
+
+    if (slot->layer.alpha > 0)
+    {
+      active_mask |= 1UL << id;
+    }
+    else
+    {
+      active_mask &= ~(1UL << id);
+    }
+  }
+}
+
+/**
+ * @brief Returns alpha of the current frame with pattern applied, [0; 1 << LAYER_ALPHA_Q].
+ */
+static uint32_t layer_alpha_get(const color_layer_slot_t *const slot)
+{
+  const uint32_t alpha = slot->layer.alpha + (slot->layer.alpha >> 7);
+  const uint32_t half = slot->period_frames / 2;
+  uint32_t pos;
+
+  switch (slot->layer.pattern)
+  {
+  case COLOR_PATTERN_BLINK:
+    return slot->phase_frames < slot->period_frames - half ? alpha : 0;
+
+  case COLOR_PATTERN_PULSE:
+    if (half == 0)
+    {
+      return alpha;
+    }
+
+    pos = slot->phase_frames < half ? slot->phase_frames : slot->period_frames - slot->phase_frames;
+    pos = MIN(((uint64_t)pos << COLOR_ANIM_Q) / half, COLOR_ANIM_ONE);
+
+    return (alpha * color_easing_in_out(pos)) >> COLOR_ANIM_Q;
+
+  default:
+    return alpha;
+  }
+}
+
+/**
+ * @return true if layer is still active
+ */
+static bool layer_advance(color_layer_slot_t *const slot)
+{
+  if (++slot->phase_frames >= slot->period_frames)
+  {
+    slot->phase_frames = 0;
+  }
+
+  slot->elapsed_frames++;
+
+  return slot->duration_frames == 0 || slot->elapsed_frames < slot->duration_frames;
+}
+
+static inline uint16_t blend_channel(uint32_t base, uint32_t color, uint32_t alpha, color_blend_t blend)
+{
+  uint32_t target;
+
+  switch (blend)
+  {
+  case COLOR_BLEND_ADD:
+    target = MIN(base + color, RGB16_MAX_VALUE);
+    break;
+
+  case COLOR_BLEND_MULTIPLY:
+    target = base * color / RGB16_MAX_VALUE;
+    break;
+
+  default:
+    target = color;
+    break;
+  }
+
+  return (int32_t)base + ((((int32_t)target - (int32_t)base) * (int32_t)alpha) >> LAYER_ALPHA_Q);
+}
+
+void color_compositor_init(uint32_t frame_us)
+{
+  ASSERT(frame_us > 0);
+
+  compositor_frame_us = frame_us;
+  active_mask = 0;
+  nrf_atomic_u32_store(&pending_mask, 0);
+}
+
+/**
+ * @brief Shows layer above base from the next frames, pattern and expiry timer are restarted.
+ *  Must be called only by owner of layer.
+ *
+ * @return false if layer is invalid
+ */
+bool color_compositor_layer_set(color_layer_id_t id, const color_layer_t *const layer)
+{
+  if (id >= COLOR_LAYERS_COUNT || layer->blend >= COLOR_BLENDS_COUNT || layer->pattern >= COLOR_PATTERNS_COUNT ||
+      (layer->pattern != COLOR_PATTERN_SOLID && layer->period_ms == 0))
+  {
+    return false;
+  }
+
+  nrf_atomic_u32_and(&pending_mask, ~(1UL << id));
+  layer_slots[id].pending = *layer;
+  nrf_atomic_u32_or(&pending_mask, 1UL << id);
+
+  return true;
+}
+
+/**
+ * @brief Removes layer from the next frames. Must be called only by owner of layer.
+ */
+void color_compositor_layer_clear(color_layer_id_t id)
+{
+  ASSERT(id < COLOR_LAYERS_COUNT);
+
+  nrf_atomic_u32_and(&pending_mask, ~(1UL << id));
+  layer_slots[id].pending.alpha = 0;
+  nrf_atomic_u32_or(&pending_mask, 1UL << id);
+}
+
+/**
+ * @brief Blends active layers above rendered base frames in place.
+ *  One pass over frames, every frame is blended with all layers from bottom to top.
+ *  Base is only read, so its state (mode, effect, transition) isn't disturbed.
+ */
+void color_compositor_process(rgb16_params_t *rgb, uint8_t count)
+{
+  layers_update();
+
+  for (uint8_t i = 0; i < count && active_mask != 0; i++)
+  {
+    for (uint8_t id = 0; id < COLOR_LAYERS_COUNT; id++)
+    {
+      color_layer_slot_t *const slot = &layer_slots[id];
+      uint32_t alpha;
+
+      if (!(active_mask & (1UL << id)))
+      {
+        continue;
+      }
+
+      alpha = layer_alpha_get(slot);
+
+      if (alpha > 0)
+      {
+        rgb[i].red = blend_channel(rgb[i].red, slot->layer.color.red, alpha, slot->layer.blend);
+        rgb[i].green = blend_channel(rgb[i].green, slot->layer.color.green, alpha, slot->layer.blend);
+        rgb[i].blue = blend_channel(rgb[i].blue, slot->layer.color.blue, alpha, slot->layer.blend);
+      }
+
+      if (!layer_advance(slot))
+      {
+        active_mask &= ~(1UL << id);
+      }
+    }
+  }
+}
@@ -0,0 +1,52 @@
+#ifndef _COLOR_COMPOSITOR_H
+#define _COLOR_COMPOSITOR_H
+
+#include "nrfx.h"
+#include "hsv_to_rgb.h"
+
+#define COLOR_LAYER_ALPHA_MAX           255
+#define COLOR_LAYER_NO_EXPIRY           0
+
+/**
+ * @brief Overlays drawn above the base color or effect, later ones are on top.
+ *  Each layer must be changed from one context only, its owner.
+ */
+typedef enum color_layer_id_e
+{
+  COLOR_LAYER_STATUS,             /* feedback of user actions, e.g. saving, owned by CLI */
+  COLOR_LAYER_ALERT,              /* connection problems, owned by USB events handler */
+  COLOR_LAYERS_COUNT
+} color_layer_id_t;
+
+typedef enum color_blend_e
+{
+  COLOR_BLEND_NORMAL,             /* layer color over base */
+  COLOR_BLEND_ADD,                /* layer color is added to base, saturated */
+  COLOR_BLEND_MULTIPLY,           /* base is filtered by layer color */
+  COLOR_BLENDS_COUNT
+} color_blend_t;
+
+typedef enum color_layer_pattern_e
+{
+  COLOR_PATTERN_SOLID,            /* constant alpha */
+  COLOR_PATTERN_BLINK,            /* alpha is on for the first half of period */
+  COLOR_PATTERN_PULSE,            /* alpha is eased from 0 to max and back during period */
+  COLOR_PATTERNS_COUNT
+} color_layer_pattern_t;
+
+typedef struct color_layer_s
+{
+  rgb16_params_t color;
+  uint16_t period_ms;             /* pattern period, not used by COLOR_PATTERN_SOLID */
+  uint16_t duration_ms;           /* layer is removed after it, COLOR_LAYER_NO_EXPIRY to keep it */
+  uint8_t alpha;                  /* [0; COLOR_LAYER_ALPHA_MAX] */
+  color_blend_t blend;
+  color_layer_pattern_t pattern;
+} color_layer_t;
+
+void color_compositor_init(uint32_t frame_us);
+bool color_compositor_layer_set(color_layer_id_t id, const color_layer_t *const layer);
+void color_compositor_layer_clear(color_layer_id_t id);
+void color_compositor_process(rgb16_params_t *rgb, uint8_t count);
+
+#endif /* _COLOR_COMPOSITOR_H */
@@ -0,0 +1,371 @@
+#include "color_oklab.h"
+#include "nrf_assert.h"
+
+/**
+ * Fixed-point OKLab (https://bottosson.github.io/posts/oklab/).
+ *  PWM duty is linear light already, so rgb16 is used as linear sRGB without gamma.
+ *  Matrices are Q16 and products are accumulated in 64 bits, that's
+ *  one SMLAL per coefficient on Cortex-M4.
+ */
+
+#define RGB16_MAX_VALUE                 ((int32_t)RGB_MAX_VALUE << RGB16_FRACTION_BITS)
+#define CBRT_TABLE_BITS                 7
+#define SIN_TABLE_BITS                  6
+#define GAMUT_SEARCH_STEPS              8
+
+/* linear rgb -> lms */
+static const int32_t m1[3][3] =
+{
+  {27015, 35149,  3372},
+  {13887, 44611,  7038},
+  { 5787, 18463, 41286},
+};
+
+/* cube root of lms -> lab */
+static const int32_t m2[3][3] =
+{
+  { 13792,   52011,   -267},
+  {129630, -159160,  29530},
+  {  1698,   51300, -52998},
+};
+
+/* lab -> cube root of lms */
+static const int32_t m2_inv[3][3] =
+{
+  {65536,  25974,  14143},
+  {65536,  -6918,  -4185},
+  {65536,  -5864, -84639},
+};
+
+/* lms -> linear rgb */
+static const int32_t m1_inv[3][3] =
+{
+  { 267173, -216774,  15137},
+  { -83128,  171033, -22369},
+  {   -275,  -46099, 111910},
+};
+
+/* cbrt(i / 128) in Q16, the last one is clamped to fit */
+static const uint16_t cbrt_table[(1 << CBRT_TABLE_BITS) + 1] =
+{
+      0, 13004, 16384, 18755, 20643, 22237, 23630, 24876,
+  26008, 27049, 28016, 28921, 29772, 30577, 31341, 32071,
+  32768, 33437, 34080, 34700, 35298, 35877, 36438, 36982,
+  37510, 38024, 38524, 39012, 39488, 39952, 40406, 40850,
+  41285, 41711, 42128, 42537, 42938, 43332, 43719, 44099,
+  44473, 44841, 45202, 45558, 45909, 46254, 46594, 46929,
+  47260, 47586, 47907, 48224, 48538, 48847, 49152, 49454,
+  49751, 50046, 50337, 50624, 50909, 51190, 51468, 51744,
+  52016, 52285, 52552, 52816, 53078, 53337, 53593, 53847,
+  54099, 54348, 54595, 54840, 55083, 55323, 55562, 55798,
+  56032, 56265, 56496, 56724, 56951, 57176, 57400, 57621,
+  57841, 58059, 58276, 58491, 58705, 58917, 59127, 59336,
+  59543, 59749, 59954, 60157, 60359, 60560, 60759, 60957,
+  61153, 61349, 61543, 61736, 61928, 62118, 62308, 62496,
+  62683, 62869, 63054, 63238, 63420, 63602, 63783, 63963,
+  64141, 64319, 64496, 64671, 64846, 65020, 65193, 65365,
+  65535,
+};
+
+/* sin of quarter wave in Q15 */
+static const int16_t sin_table[(1 << SIN_TABLE_BITS) + 1] =
+{
+      0,   804,  1608,  2410,  3212,  4011,  4808,  5602,
+   6393,  7179,  7962,  8739,  9512, 10278, 11039, 11793,
+  12539, 13279, 14010, 14732, 15446, 16151, 16846, 17530,
+  18204, 18868, 19519, 20159, 20787, 21403, 22005, 22594,
+  23170, 23731, 24279, 24811, 25329, 25832, 26319, 26790,
+  27245, 27683, 28105, 28510, 28898, 29268, 29621, 29956,
+  30273, 30571, 30852, 31113, 31356, 31580, 31785, 31971,
+  32137, 32285, 32412, 32521, 32609, 32678, 32728, 32757,
+  32767,
+};
+
+static inline void matrix_apply(const int32_t m[3][3], const int32_t in[3], int32_t out[3])
+{
+  for (uint8_t row = 0; row < 3; row++)
+  {
+    out[row] = ((int64_t)m[row][0] * in[0] + (int64_t)m[row][1] * in[1] + (int64_t)m[row][2] * in[2]) >> OKLAB_Q;
+  }
+}
+
+/**
+ * @brief Cube root of Q16 value in [0; 1].
+ *  Value is scaled by 8^k into [1/8; 1], where table is accurate,
+ *  and result is scaled back by 2^k.
+ */
+static int32_t cbrt_q16(int32_t x)
+{
+  uint8_t shift = 0;
+  uint32_t idx;
+  uint32_t frac;
+  int32_t result;
+
+  if (x <= 0)
+  {
+    return 0;
+  }
+
+  if (x >= OKLAB_ONE)
+  {
+    return OKLAB_ONE;
+  }
+
+  while (x < (OKLAB_ONE >> 3))
+  {
+    x <<= 3;
+    shift++;
+  }
+
+  idx = x >> (OKLAB_Q - CBRT_TABLE_BITS);
+  frac = x & ((1 << (OKLAB_Q - CBRT_TABLE_BITS)) - 1);
+  result = cbrt_table[idx] + (((cbrt_table[idx + 1] - cbrt_table[idx]) * (int32_t)frac) >> (OKLAB_Q - CBRT_TABLE_BITS));
+
+  return result >> shift;
+}
+
+/* Q15 sin of binary angle */
+static int32_t sin_q15(uint16_t angle)
+{
+  const uint8_t quadrant = angle >> 14;
+  uint32_t pos = angle & 0x3FFF;
+  uint32_t idx;
+  uint32_t frac;
+  int32_t result;
+
+  if (quadrant & 1)
+  {
+    pos = 0x4000 - pos;
+  }
+
+  idx = pos >> (14 - SIN_TABLE_BITS);
+  frac = pos & ((1 << (14 - SIN_TABLE_BITS)) - 1);
+  result = sin_table[idx];
+
+  if (idx < (1 << SIN_TABLE_BITS))
+  {
+    result += ((sin_table[idx + 1] - sin_table[idx]) * (int32_t)frac) >> (14 - SIN_TABLE_BITS);
+  }
+
+  return (quadrant & 2) ? -result : result;
+}
+
+/**
+ * @brief atan2 as binary angle, error is less than 0.3 degree.
+ *  atan(z) ~ z * pi / 4 + 0.273 * z * (1 - z) for z in [0; 1]
+ */
+static uint16_t atan2_binary(int32_t y, int32_t x)
+{
+  const uint32_t abs_x = x < 0 ? -x : x;
+  const uint32_t abs_y = y < 0 ? -y : y;
+  uint32_t z;
+  uint32_t angle;
+
+  if (abs_x == 0 && abs_y == 0)
+  {
+    return 0;
+  }
+
+  /* z in Q15, angle of the first octant in binary angle units */
+  z = abs_x >= abs_y ? ((uint64_t)abs_y << 15) / abs_x : ((uint64_t)abs_x << 15) / abs_y;
+  angle = (z * 8192 + ((z * ((1 << 15) - z)) >> 15) * 2847) >> 15;
+
+  if (abs_y > abs_x)
+  {
+    angle = 0x4000 - angle;
+  }
+
+  if (x < 0)
+  {
+    angle = 0x8000 - angle;
+  }
+
+  if (y < 0)
+  {
+    angle = 0x10000 - angle;
+  }
+
+  return angle;
+}
+
+static uint32_t isqrt64(uint64_t value)
+{
+  uint64_t result = 0;
+  uint64_t bit = 1ULL << 62;
+
+  while (bit > value)
+  {
+    bit >>= 2;
+  }
+
+  while (bit != 0)
+  {
+    if (value >= result + bit)
+    {
+      value -= result + bit;
+      result = (result >> 1) + bit;
+    }
+    else
+    {
+      result >>= 1;
+    }
+
+    bit >>= 2;
+  }
+
+  return result;
+}
+
+/**
+ * @brief Converts linear rgb16 into OKLab
+ */
+oklab_t oklab_by_rgb16(rgb16_params_t rgb)
+{
+  /* [0; RGB16_MAX_VALUE] -> Q16 [0; 1] */
+  const int32_t in[3] =
+  {
+    ((int32_t)rgb.red * 257) >> 8,
+    ((int32_t)rgb.green * 257) >> 8,
+    ((int32_t)rgb.blue * 257) >> 8,
+  };
+  int32_t lms[3];
+  int32_t lab[3];
+
+  matrix_apply(m1, in, lms);
+
+  for (uint8_t i = 0; i < 3; i++)
+  {
+    lms[i] = cbrt_q16(lms[i]);
+  }
+
+  matrix_apply(m2, lms, lab);
+
+  return (oklab_t){ .l = lab[0], .a = lab[1], .b = lab[2] };
+}
+
+/**
+ * @brief Converts OKLab into linear rgb16, out of gamut channels are clamped
+ *
+ * @return false if color is out of gamut
+ */
+bool rgb16_by_oklab(const oklab_t *const lab, rgb16_params_t *const rgb)
+{
+  const int32_t in[3] = { lab->l, lab->a, lab->b };
+  int32_t lms[3];
+  int32_t out[3];
+  bool is_in_gamut = true;
+
+  matrix_apply(m2_inv, in, lms);
+
+  for (uint8_t i = 0; i < 3; i++)
+  {
+    lms[i] = ((((int64_t)lms[i] * lms[i]) >> OKLAB_Q) * lms[i]) >> OKLAB_Q;
+  }
+
+  matrix_apply(m1_inv, lms, out);
+
+  for (uint8_t i = 0; i < 3; i++)
+  {
+    /* Q16 [0; 1] -> [0; RGB16_MAX_VALUE], a few LSB of rounding error are allowed */
+    out[i] = (out[i] * 255 + 128) >> 8;
+    is_in_gamut &= out[i] >= -RGB_MAX_VALUE && out[i] <= RGB16_MAX_VALUE + RGB_MAX_VALUE;
+    out[i] = MIN(MAX(out[i], 0), RGB16_MAX_VALUE);
+  }
+
+  rgb->red = out[0];
+  rgb->green = out[1];
+  rgb->blue = out[2];
+
+  return is_in_gamut;
+}
+
+oklch_t oklch_by_oklab(const oklab_t *const lab)
+{
+  return (oklch_t)
+  {
+    .l = lab->l,
+    .c = isqrt64((int64_t)lab->a * lab->a + (int64_t)lab->b * lab->b),
+    .h = atan2_binary(lab->b, lab->a)
+  };
+}
+
+oklab_t oklab_by_oklch(const oklch_t *const lch)
+{
+  return (oklab_t)
+  {
+    .l = lch->l,
+    .a = ((int64_t)lch->c * sin_q15(lch->h + 0x4000)) >> 15,
+    .b = ((int64_t)lch->c * sin_q15(lch->h)) >> 15
+  };
+}
+
+/**
+ * @brief Converts OKLCh into rgb16, chroma is reduced until color fits into gamut,
+ *  so lightness and hue are kept.
+ *
+ * @return false if chroma was reduced
+ */
+bool rgb16_by_oklch_in_gamut(oklch_t lch, rgb16_params_t *const rgb)
+{
+  oklab_t lab = oklab_by_oklch(&lch);
+  int32_t c_min = 0;
+  int32_t c_max = lch.c;
+
+  if (rgb16_by_oklab(&lab, rgb))
+  {
+    return true;
+  }
+
+  /* c_min is always in gamut, gray is */
+  for (uint8_t i = 0; i < GAMUT_SEARCH_STEPS; i++)
+  {
+    lch.c = (c_min + c_max) / 2;
+    lab = oklab_by_oklch(&lch);
+
+    if (rgb16_by_oklab(&lab, rgb))
+    {
+      c_min = lch.c;
+    }
+    else
+    {
+      c_max = lch.c;
+    }
+  }
+
+  lch.c = c_min;
+  lab = oklab_by_oklch(&lch);
+  rgb16_by_oklab(&lab, rgb);
+
+  return false;
+}
+
+/**
+ * @param t Q16 fraction of the way
+ */
+oklab_t oklab_lerp(const oklab_t *const from, const oklab_t *const to, uint32_t t)
+{
+  return (oklab_t)
+  {
+    .l = from->l + (int32_t)(((int64_t)(to->l - from->l) * t) >> OKLAB_Q),
+    .a = from->a + (int32_t)(((int64_t)(to->a - from->a) * t) >> OKLAB_Q),
+    .b = from->b + (int32_t)(((int64_t)(to->b - from->b) * t) >> OKLAB_Q)
+  };
+}
+
+/**
+ * @brief Interpolates lightness, chroma and hue by the shortest path
+ *
+ * @param t Q16 fraction of the way
+ */
+oklch_t oklch_lerp(const oklch_t *const from, const oklch_t *const to, uint32_t t)
+{
+  /* int16_t difference of binary angles is the shortest path */
+  const int16_t hue_diff = (int16_t)(to->h - from->h);
+
+  return (oklch_t)
+  {
+    .l = from->l + (int32_t)(((int64_t)(to->l - from->l) * t) >> OKLAB_Q),
+    .c = from->c + (int32_t)(((int64_t)(to->c - from->c) * t) >> OKLAB_Q),
+    .h = from->h + (int16_t)(((int32_t)hue_diff * (int32_t)(t >> 1)) >> (OKLAB_Q - 1))
+  };
+}
@@ -0,0 +1,37 @@
+#ifndef _COLOR_OKLAB_H
+#define _COLOR_OKLAB_H
+
+#include "nrfx.h"
+#include "hsv_to_rgb.h"
+
+#define OKLAB_Q                         16
+#define OKLAB_ONE                       (1L << OKLAB_Q)
+#define OKLCH_HUE_BY_DEGREES(deg)       ((uint16_t)(((uint32_t)(deg) << 16) / 360))
+
+/* OKLab color, every component is Q16: l in [0; 1], a and b roughly in [-0.5; 0.5] */
+typedef struct oklab_s
+{
+  int32_t l;
+  int32_t a;
+  int32_t b;
+} oklab_t;
+
+/* OKLab in polar form, l and c are Q16, h is binary angle: 65536 is 360 degrees */
+typedef struct oklch_s
+{
+  int32_t l;
+  int32_t c;
+  uint16_t h;
+} oklch_t;
+
+oklab_t oklab_by_rgb16(rgb16_params_t rgb);
+bool rgb16_by_oklab(const oklab_t *const lab, rgb16_params_t *const rgb);
+
+oklch_t oklch_by_oklab(const oklab_t *const lab);
+oklab_t oklab_by_oklch(const oklch_t *const lch);
+bool rgb16_by_oklch_in_gamut(oklch_t lch, rgb16_params_t *const rgb);
+
+oklab_t oklab_lerp(const oklab_t *const from, const oklab_t *const to, uint32_t t);
+oklch_t oklch_lerp(const oklch_t *const from, const oklch_t *const to, uint32_t t);
+
+#endif /* _COLOR_OKLAB_H */
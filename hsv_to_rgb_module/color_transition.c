@@ -0,0 +1,329 @@
+#include "color_transition.h"
+#include "color_anim.h"
+#include "color_oklab.h"
+#include "nrf_assert.h"
+#include "app_util_platform.h"
+#include "app_error.h"
+
+#define RGB16_MAX_VALUE                 ((uint32_t)RGB_MAX_VALUE << RGB16_FRACTION_BITS)
+#define OKLCH_GRAY_CHROMA               (OKLAB_ONE / 256)   /* hue of less chromatic color is noise */
+
+typedef struct color_transition_s
+{
+  rgb16_params_t from_rgb;        /* output when transition was started, in space of transition */
+  hsv_params_t from_hsv;
+  oklab_t from_lab;
+  oklch_t from_lch;
+  rgb16_params_t out_rgb;         /* last output */
+  hsv_params_t out_hsv;           /* last output, valid only if out_hsv_is_valid */
+  uint32_t progress;              /* Q16, transition is finished at COLOR_ANIM_ONE */
+  uint32_t step;                  /* Q16 progress per frame, 0 means no transition */
+  color_transition_space_t space;
+  uint32_t pending_step;          /* config of the next transition, see @ref color_transition_start */
+  color_transition_space_t pending_space;
+  bool out_hsv_is_valid;
+} color_transition_t;
+
+static color_transition_t transition =
+{
+  .progress = COLOR_ANIM_ONE,
+  .space = COLOR_TRANSITION_RGB,
+  .pending_space = COLOR_TRANSITION_RGB,
+};
+static uint32_t transition_frame_us;
+
+static uint32_t isqrt(uint32_t value)
+{
+  uint32_t result = 0;
+  uint32_t bit = 1UL << 30;
+
+  while (bit > value)
+  {
+    bit >>= 2;
+  }
+
+  while (bit != 0)
+  {
+    if (value >= result + bit)
+    {
+      value -= result + bit;
+      result = (result >> 1) + bit;
+    }
+    else
+    {
+      result >>= 1;
+    }
+
+    bit >>= 2;
+  }
+
+  return result;
+}
+
+static inline int32_t lerp(int32_t from, int32_t to, uint32_t t)
+{
+  return from + (int32_t)(((int64_t)(to - from) * t) >> COLOR_ANIM_Q);
+}
+
+/* sqrt(v / max) * max, so equal steps of encoded value look like equal brightness steps */
+static inline uint16_t perceptual_encode(uint16_t value)
+{
+  return isqrt(value * RGB16_MAX_VALUE);
+}
+
+static inline uint16_t perceptual_decode(uint16_t value)
+{
+  return (uint32_t)value * value / RGB16_MAX_VALUE;
+}
+
+static rgb16_params_t rgb16_perceptual_encode(rgb16_params_t rgb)
+{
+  return (rgb16_params_t)
+  {
+    .red = perceptual_encode(rgb.red),
+    .green = perceptual_encode(rgb.green),
+    .blue = perceptual_encode(rgb.blue)
+  };
+}
+
+static rgb16_params_t rgb16_lerp(rgb16_params_t from, rgb16_params_t to, uint32_t t)
+{
+  return (rgb16_params_t)
+  {
+    .red = lerp(from.red, to.red, t),
+    .green = lerp(from.green, to.green, t),
+    .blue = lerp(from.blue, to.blue, t)
+  };
+}
+
+static hsv_params_t hsv_lerp(hsv_params_t from, hsv_params_t to, uint32_t t)
+{
+  hsv_params_t hsv;
+  int32_t hue_diff;
+  int32_t hue;
+
+  /* Hue of gray is meaningless, only saturation is changed */
+  if (from.saturation == 0)
+  {
+    from.hue = to.hue;
+  }
+  else if (to.saturation == 0)
+  {
+    to.hue = from.hue;
+  }
+
+  hue_diff = (int32_t)to.hue - from.hue;
+
+  if (hue_diff > HUE_MAX_VALUE / 2)
+  {
+    hue_diff -= HUE_MAX_VALUE;
+  }
+  else if (hue_diff < -HUE_MAX_VALUE / 2)
+  {
+    hue_diff += HUE_MAX_VALUE;
+  }
+
+  hue = lerp(from.hue, from.hue + hue_diff, t);
+  hue += (hue < 0) ? HUE_MAX_VALUE : 0;
+  hue -= (hue >= HUE_MAX_VALUE) ? HUE_MAX_VALUE : 0;
+
+  hsv.hue = hue;
+  hsv.saturation = lerp(from.saturation, to.saturation, t);
+  hsv.brightness = lerp(from.brightness, to.brightness, t);
+
+  return hsv;
+}
+
+static oklch_t oklch_by_rgb16(rgb16_params_t rgb)
+{
+  const oklab_t lab = oklab_by_rgb16(rgb);
+
+  return oklch_by_oklab(&lab);
+}
+
+/**
+ * @brief Hue of gray is meaningless, only chroma is changed as in @ref hsv_lerp
+ */
+static oklch_t oklch_gray_lerp(oklch_t from, oklch_t to, uint32_t t)
+{
+  if (from.c < OKLCH_GRAY_CHROMA)
+  {
+    from.h = to.h;
+  }
+  else if (to.c < OKLCH_GRAY_CHROMA)
+  {
+    to.h = from.h;
+  }
+
+  return oklch_lerp(&from, &to, t);
+}
+
+static hsv_params_t hsv_by_rgb16(rgb16_params_t rgb16)
+{
+  const rgb_params_t rgb =
+  {
+    .red = rgb16.red >> RGB16_FRACTION_BITS,
+    .green = rgb16.green >> RGB16_FRACTION_BITS,
+    .blue = rgb16.blue >> RGB16_FRACTION_BITS
+  };
+
+  return hsv_by_rgb(rgb);
+}
+
+/**
+ * @brief Inits transitions with default config
+ *
+ * @param frame_us time between two @ref color_transition_process calls
+ */
+void color_transition_init(uint32_t frame_us)
+{
+  transition_frame_us = frame_us;
+  APP_ERROR_CHECK_BOOL(color_transition_config(COLOR_TRANSITION_DEFAULT_DURATION_MS, COLOR_TRANSITION_RGB));
+}
+
+/**
+ * @brief Changes duration and space of the next transitions. Running transition
+ *  keeps its config, its start values are valid only in its space.
+ *
+ * @param duration_ms transition duration, 0 to change color immediately
+ * @param space interpolation space
+ * @return false if arguments are out of range
+ */
+bool color_transition_config(uint16_t duration_ms, color_transition_space_t space)
+{
+  uint32_t step;
+
+  if (duration_ms > COLOR_TRANSITION_MAX_DURATION_MS || space >= COLOR_TRANSITION_SPACES_COUNT)
+  {
+    return false;
+  }
+
+  step = duration_ms ? COLOR_ANIM_ONE * transition_frame_us / (duration_ms * 1000UL) : 0;
+
+  /* Very short transitions take one frame */
+  if (duration_ms && step == 0)
+  {
+    step = 1;
+  }
+
+  /* Config is read by PWM interrupt in @ref color_transition_start */
+  CRITICAL_REGION_ENTER();
+  transition.pending_space = space;
+  transition.pending_step = step;
+  CRITICAL_REGION_EXIT();
+
+  return true;
+}
+
+/**
+ * @brief Starts transition from current output to target of next @ref color_transition_process calls.
+ *  It may be called while transition isn't finished, then it continues from the current output.
+ *  Config of @ref color_transition_config is applied here.
+ */
+void color_transition_start(void)
+{
+  transition.space = transition.pending_space;
+  transition.step = transition.pending_step;
+
+  if (transition.step == 0)
+  {
+    return;
+  }
+
+  switch (transition.space)
+  {
+    case COLOR_TRANSITION_HSV:
+      transition.from_hsv = transition.out_hsv_is_valid ? transition.out_hsv : hsv_by_rgb16(transition.out_rgb);
+      break;
+
+    case COLOR_TRANSITION_PERCEPTUAL:
+      transition.from_rgb = rgb16_perceptual_encode(transition.out_rgb);
+      break;
+
+    case COLOR_TRANSITION_OKLAB:
+      transition.from_lab = oklab_by_rgb16(transition.out_rgb);
+      break;
+
+    case COLOR_TRANSITION_OKLCH:
+      transition.from_lch = oklch_by_rgb16(transition.out_rgb);
+      break;
+
+    default:
+      transition.from_rgb = transition.out_rgb;
+      break;
+  }
+
+  transition.progress = 0;
+}
+
+/**
+ * @brief Returns color of the next frame. Target may change every frame,
+ *  e.g. if color changing mode is running, transition follows it.
+ *
+ * @param target_hsv color that should be shown without transition
+ * @param target_rgb the same color in rgb
+ * @return color to show
+ */
+rgb16_params_t color_transition_process(const hsv_params_t *const target_hsv, rgb16_params_t target_rgb)
+{
+  rgb_params_t rgb;
+  oklab_t lab;
+  uint32_t t;
+
+  transition.progress = MIN(transition.progress + transition.step, COLOR_ANIM_ONE);
+
+  if (transition.progress >= COLOR_ANIM_ONE || transition.step == 0)
+  {
+    transition.progress = COLOR_ANIM_ONE;
+    transition.out_rgb = target_rgb;
+    transition.out_hsv = *target_hsv;
+    transition.out_hsv_is_valid = true;
+
+    return target_rgb;
+  }
+
+  t = color_easing_in_out(transition.progress);
+
+  switch (transition.space)
+  {
+    case COLOR_TRANSITION_HSV:
+      transition.out_hsv = hsv_lerp(transition.from_hsv, *target_hsv, t);
+      transition.out_hsv_is_valid = true;
+      hsv_to_rgb(&transition.out_hsv, &rgb);
+      transition.out_rgb = (rgb16_params_t)
+      {
+        .red = rgb.red << RGB16_FRACTION_BITS,
+        .green = rgb.green << RGB16_FRACTION_BITS,
+        .blue = rgb.blue << RGB16_FRACTION_BITS
+      };
+      break;
+
+    case COLOR_TRANSITION_PERCEPTUAL:
+      transition.out_rgb = rgb16_lerp(transition.from_rgb, rgb16_perceptual_encode(target_rgb), t);
+      transition.out_rgb.red = perceptual_decode(transition.out_rgb.red);
+      transition.out_rgb.green = perceptual_decode(transition.out_rgb.green);
+      transition.out_rgb.blue = perceptual_decode(transition.out_rgb.blue);
+      transition.out_hsv_is_valid = false;
+      break;
+
+    case COLOR_TRANSITION_OKLAB:
+      lab = oklab_by_rgb16(target_rgb);
+      lab = oklab_lerp(&transition.from_lab, &lab, t);
+      rgb16_by_oklab(&lab, &transition.out_rgb);
+      transition.out_hsv_is_valid = false;
+      break;
+
+    case COLOR_TRANSITION_OKLCH:
+      rgb16_by_oklch_in_gamut(oklch_gray_lerp(transition.from_lch, oklch_by_rgb16(target_rgb), t),
+                              &transition.out_rgb);
+      transition.out_hsv_is_valid = false;
+      break;
+
+    default:
+      transition.out_rgb = rgb16_lerp(transition.from_rgb, target_rgb, t);
+      transition.out_hsv_is_valid = false;
+      break;
+  }
+
+  return transition.out_rgb;
+}
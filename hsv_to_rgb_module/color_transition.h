@@ -0,0 +1,25 @@
+#ifndef _COLOR_TRANSITION_H
+#define _COLOR_TRANSITION_H
+
+#include "nrfx.h"
+#include "hsv_to_rgb.h"
+
+#define COLOR_TRANSITION_DEFAULT_DURATION_MS    500
+#define COLOR_TRANSITION_MAX_DURATION_MS        60000
+
+typedef enum color_transition_space_e
+{
+  COLOR_TRANSITION_RGB,           /* linear duty */
+  COLOR_TRANSITION_HSV,           /* hue by the shortest path */
+  COLOR_TRANSITION_PERCEPTUAL,    /* square root of duty, even brightness steps */
+  COLOR_TRANSITION_OKLAB,         /* straight line in OKLab, even lightness and hue steps */
+  COLOR_TRANSITION_OKLCH,         /* hue by the shortest arc in OKLCh, chroma doesn't dip through gray */
+  COLOR_TRANSITION_SPACES_COUNT
+} color_transition_space_t;
+
+void color_transition_init(uint32_t frame_us);
+bool color_transition_config(uint16_t duration_ms, color_transition_space_t space);
+void color_transition_start(void);
+rgb16_params_t color_transition_process(const hsv_params_t *const target_hsv, rgb16_params_t target_rgb);
+
+#endif /* _COLOR_TRANSITION_H */
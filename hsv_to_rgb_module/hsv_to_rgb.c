@@ -1,171 +1,375 @@
 #include "hsv_to_rgb.h"
+#include "color_anim.h"
+#include "color_cct.h"
+#include "color_oklab.h"
 #include "nrf_assert.h"
 #include <string.h>
 
-static bool count_down_flags[MODES_COUNT]; /* true means that we need to start counting down to prevent overflow */
+/* hsv with every component in [0; 255] range */
+typedef struct hsv8_params_s
+{
+  uint8_t hue;
+  uint8_t saturation;
+  uint8_t brightness;
+} hsv8_params_t;
 
-static void hsv_to_rgb(const hsv_params_t *const hsv, rgb_params_t *const rgb);
-static uint16_t update_ctr(uint16_t ctr, uint16_t step, uint16_t max_value, bool *const count_down);
+static color_anim_channel_t anim_channels[MODES_COUNT]; /* indexed by mode, NO_CHANGE isn't used */
+static uint32_t anim_tick_us;
+
+/* the last rendered color, rgb is recalculated only if hsv8 is changed */
+static hsv8_params_t hsv8_values;
+static rgb_params_t rgb_values =
+{
+  .red = 0,
+  .green = 0,
+  .blue = 0
+};
+
+static void hsv8_to_rgb(const hsv8_params_t *const hsv, rgb_params_t *const rgb);
+static hsv8_params_t hsv8_by_hsv(const hsv_params_t *const hsv);
+static uint16_t hsv_component_get(const hsv_params_t *const hsv, color_changing_mode_t mode);
+static void hsv_component_set(hsv_params_t *const hsv, hsv8_params_t *const hsv8,
+                              const color_anim_channel_t *const ch, color_changing_mode_t mode);
+
+/* hue / 43 for hue in [0; 255] */
+#define HUE8_REGION(hue)                (((uint32_t)(hue) * 1525U) >> 16)
+
+/* Byte offsets of {red, green, blue} inside of packed {v, t, p, q} word for every region */
+static const uint8_t region_shifts[6][3] =
+{
+  {0,  8,  16},   /* v, t, p */
+  {24, 0,  16},   /* q, v, p */
+  {16, 0,  8},    /* p, v, t */
+  {16, 24, 0},    /* p, q, v */
+  {8,  16, 0},    /* t, p, v */
+  {0,  16, 24},   /* v, p, q */
+};
 
 /**
  * @brief Updates red, green and blue value using
- *  hue, saturation and brightness.
+ *  hue, saturation and brightness in [0; 255] range.
  *  Link to algorithm: https://stackoverflow.com/questions/24152553/hsv-to-rgb-and-back-without-floating-point-math-in-python
  *
+ *  Branchless version: q and t are calculated by one multiplication with
+ *  both factors packed into 16 bit lanes (products are less than 2^16, so lanes
+ *  never overflow), region is selected by table of byte offsets.
+ *
+ * @param[in] hsv pointer to hsv8 params struct
+ * @param[out] rgb pointer to rgb params struct
+ */
+static void hsv8_to_rgb(const hsv8_params_t *const hsv, rgb_params_t *const rgb)
+{
+  const uint32_t v = hsv->brightness;
+  const uint32_t s = hsv->saturation;
+  const uint32_t region = HUE8_REGION(hsv->hue);
+  const uint32_t reminder = (hsv->hue - region * 43) * 6;
+  const uint32_t s_mask = 0U - (uint32_t)(s != 0);   /* all ones if saturation isn't 0 */
+
+  uint32_t s_rem = s * reminder;                     /* s * reminder */
+  uint32_t s_rem_inv = (s << 8) - s - s_rem;         /* s * (255 - reminder) */
+  uint32_t qt = v * ((255 - (s_rem >> 8)) | ((255 - (s_rem_inv >> 8)) << 16));
+  uint32_t p = (v * (255 - s)) >> 8;
+  uint32_t packed = v | (((qt >> 24) & 0xFF) << 8) | (p << 16) | (((qt >> 8) & 0xFF) << 24);
+
+  /* Gray if saturation is 0 */
+  packed = (packed & s_mask) | ((v * 0x01010101U) & ~s_mask);
+
+  rgb->red = packed >> region_shifts[region][0];
+  rgb->green = packed >> region_shifts[region][1];
+  rgb->blue = packed >> region_shifts[region][2];
+}
+
+/**
+ * @brief From 0-100, 0-360 to 0-255
+ */
+static hsv8_params_t hsv8_by_hsv(const hsv_params_t *const hsv)
+{
+  hsv8_params_t hsv8;
+
+  ASSERT(hsv->hue <= HUE_MAX_VALUE);
+  ASSERT(hsv->brightness <= BRIGHT_MAX_VALUE);
+  ASSERT(hsv->saturation <= SAT_MAX_VALUE);
+
+  hsv8.hue = COLOR_REDUCE_POW(COLOR_POW((uint32_t)hsv->hue) * 255 / HUE_MAX_VALUE);
+  hsv8.saturation = COLOR_REDUCE_POW(COLOR_POW((uint32_t)hsv->saturation) * 255 / SAT_MAX_VALUE);
+  hsv8.brightness = COLOR_REDUCE_POW(COLOR_POW((uint32_t)hsv->brightness) * 255 / BRIGHT_MAX_VALUE);
+
+  return hsv8;
+}
+
+/**
+ * @brief Updates red, green and blue value using
+ *  hue, saturation and brightness.
+ *
  * @param[in] hsv pointer to hsv params struct
  * @param[out] rgb pointer to rgb params struct
  */
-static void hsv_to_rgb(const hsv_params_t *const hsv, rgb_params_t *const rgb)
+void hsv_to_rgb(const hsv_params_t *const hsv, rgb_params_t *const rgb)
+{
+  hsv8_params_t hsv8 = hsv8_by_hsv(hsv);
+  hsv8_to_rgb(&hsv8, rgb);
+}
+
+/**
+ * @brief Converts array of colors, for gradients and pixels of strip frames,
+ *  results are the same as of @ref hsv_to_rgb for every color.
+ *  The per-pixel core is branchless already, so it's a plain loop over it.
+ *
+ * @param[in] hsv array of hsv colors
+ * @param[out] rgb array of rgb colors, at least count elements
+ * @param[in] count colors count
+ */
+void hsv_to_rgb_batch(const hsv_params_t *hsv, rgb_params_t *rgb, uint16_t count)
 {
-  ASSERT(hsv->hue <= 360);
-  ASSERT(hsv->brightness <= 100);
-  ASSERT(hsv->saturation <= 100);
+  hsv8_params_t hsv8;
 
-  if (hsv->saturation == 0)
+  while (count--)
   {
-    uint8_t brightness = COLOR_REDUCE_POW(COLOR_POW((uint32_t)hsv->brightness) * 255U / 100U);
-    rgb->red = brightness;
-    rgb->blue = brightness;
-    rgb->green = brightness;
+    hsv8 = hsv8_by_hsv(hsv++);
+    hsv8_to_rgb(&hsv8, rgb++);
   }
-  else
+}
+
+static uint16_t hsv_component_get(const hsv_params_t *const hsv, color_changing_mode_t mode)
+{
+  /* Hue and color temperature are swept by their own machines */
+  switch (mode)
   {
-    /* From 0-100, 0-360 to 0-255 */
-    uint8_t hue = COLOR_REDUCE_POW(COLOR_POW((uint32_t)hsv->hue) * 255 / 360);
-    uint8_t saturation = COLOR_REDUCE_POW(COLOR_POW((uint32_t)hsv->saturation) * 255 / 100);
-    uint8_t brightness = COLOR_REDUCE_POW(COLOR_POW((uint32_t)hsv->brightness) * 255 / 100);
-
-    uint8_t region = hue / 43;
-    uint8_t reminder = (hue - region * 43) * 6;
-    uint8_t p = (brightness * (255 - saturation)) >> 8;
-    uint8_t q = (brightness * (255 - ((saturation * reminder) >> 8))) >> 8;
-    uint8_t t = (brightness * (255 - ((saturation * (255 - reminder)) >> 8))) >> 8;
-
-    switch (region)
-    {
-    case 0:
-      rgb->red = brightness;
-      rgb->green = t;
-      rgb->blue = p;
-      break;
+    case SATURATION_CHANGE:
+      return hsv->saturation;
 
-    case 1:
-      rgb->red = q;
-      rgb->green = brightness;
-      rgb->blue = p;
-      break;
+    case BRIGHTNESS_CHANGE:
+      return hsv->brightness;
 
-    case 2:
-      rgb->red = p;
-      rgb->green = brightness;
-      rgb->blue = t;
-      break;
+    default:
+      return 0;
+  }
+}
 
-    case 3:
-      rgb->red = p;
-      rgb->green = q;
-      rgb->blue = brightness;
+/**
+ * @brief Writes channel output into hsv component that is changed by mode.
+ *  hsv8 gets full render resolution of channel.
+ */
+static void hsv_component_set(hsv_params_t *const hsv, hsv8_params_t *const hsv8,
+                              const color_anim_channel_t *const ch, color_changing_mode_t mode)
+{
+  switch (mode)
+  {
+    case SATURATION_CHANGE:
+      hsv->saturation = ch->value;
+      hsv8->saturation = ch->render_value;
       break;
 
-    case 4:
-      rgb->red = t;
-      rgb->green = p;
-      rgb->blue = brightness;
+    case BRIGHTNESS_CHANGE:
+      hsv->brightness = ch->value;
+      hsv8->brightness = ch->render_value;
       break;
 
     default:
-      rgb->red = brightness;
-      rgb->green = p;
-      rgb->blue = q;
       break;
-    }
   }
 }
 
 /**
- * @brief Function for updating counter that contains unsigned value
- *  that counts from 0 to max_value if count_down == 0 then
- *  counts from max_value to 0 if count_down == 1.
- * Also updates count_down value.
+ * @brief Inits animation channels for every changing mode
  *
- * @param ctr Counter that we need to change
- * @param step Value changing step
- * @param max_value Max counter value
- * @param count_down 1 if couning down, 0 otherwise. Updates on overflow and underflow
- * @return uint16_t new ctr value
+ * @param tick_us time between two @ref color_changing_machine calls with one tick
  */
-static uint16_t update_ctr(uint16_t ctr, uint16_t step, uint16_t max_value, bool *const count_down)
+void color_anim_init(uint32_t tick_us)
 {
-  if (*count_down)
+  anim_tick_us = tick_us;
+
+  color_anim_channel_init(&anim_channels[HUE_CHANGE], HUE_MAX_VALUE, &color_easing_linear);
+  color_anim_channel_init(&anim_channels[SATURATION_CHANGE], SAT_MAX_VALUE, &color_easing_linear);
+  color_anim_channel_init(&anim_channels[BRIGHTNESS_CHANGE], BRIGHT_MAX_VALUE, &color_easing_linear);
+  color_anim_channel_init(&anim_channels[CCT_CHANGE], (CCT_MAX_KELVIN - CCT_MIN_KELVIN) / CCT_ANIM_UNIT_KELVIN,
+                          &color_easing_linear);
+
+  color_anim_speed_set(HUE_CHANGE, COLOR_ANIM_DEFAULT_SPEED);
+  color_anim_speed_set(SATURATION_CHANGE, COLOR_ANIM_DEFAULT_SPEED);
+  color_anim_speed_set(BRIGHTNESS_CHANGE, COLOR_ANIM_DEFAULT_SPEED);
+  color_anim_speed_set(CCT_CHANGE, CCT_ANIM_DEFAULT_SPEED);
+}
+
+/**
+ * @brief Sets speed of mode in units per second, independently of tick rate.
+ */
+void color_anim_speed_set(color_changing_mode_t mode, uint16_t units_per_sec)
+{
+  ASSERT(mode > NO_CHANGE && mode < MODES_COUNT);
+  color_anim_channel_speed_set(&anim_channels[mode], units_per_sec, anim_tick_us);
+}
+
+/**
+ * @brief Sets easing curve of mode, see @ref color_easing_t
+ */
+void color_anim_easing_set(color_changing_mode_t mode, color_easing_t easing)
+{
+  ASSERT(mode > NO_CHANGE && mode < MODES_COUNT);
+  ASSERT(easing != NULL);
+  anim_channels[mode].easing = easing;
+  color_anim_channel_sync(&anim_channels[mode], anim_channels[mode].value);
+}
+
+/**
+ * @brief Returns counting directions of changing modes, bit (1 << mode) is set if mode counts down.
+ *  Together with hsv they are enough to continue animation after reboot.
+ */
+uint8_t color_anim_directions_get(void)
+{
+  uint8_t directions = 0;
+
+  for (uint8_t mode = HUE_CHANGE; mode < MODES_COUNT; mode++)
   {
-    if (ctr < step)
-    {
-      *count_down = 0;
-      return ctr + step;
-    }
+    directions |= color_anim_channel_is_counting_down(&anim_channels[mode]) ? 1U << mode : 0;
+  }
+
+  return directions;
+}
 
-    ctr -= step;
+/**
+ * @brief Restores directions of @ref color_anim_directions_get, values of channels are kept.
+ *  Must not be preempted by @ref color_changing_machine.
+ */
+void color_anim_directions_set(uint8_t directions)
+{
+  for (uint8_t mode = HUE_CHANGE; mode < MODES_COUNT; mode++)
+  {
+    color_anim_channel_direction_set(&anim_channels[mode], (directions & (1U << mode)) != 0);
   }
-  else
+}
+
+/**
+ * @brief Makes rgb the rendered color, hsv gets the nearest value.
+ *  Other modes keep exact rgb until hsv is changed.
+ *
+ * @return true if rgb was changed since previous call
+ */
+static bool machine_output_set(hsv_params_t *const hsv, rgb_params_t new_rgb, rgb_params_t *const rgb)
+{
+  const bool is_changed = memcmp(&new_rgb, &rgb_values, sizeof(new_rgb)) != 0;
+
+  *hsv = hsv_by_rgb(new_rgb);
+  hsv8_values = hsv8_by_hsv(hsv);
+  rgb_values = new_rgb;
+
+  *rgb = rgb_values;
+  return is_changed;
+}
+
+/**
+ * @brief Sweeps color temperature with brightness of hsv.
+ */
+static bool cct_changing_machine(hsv_params_t *const hsv, uint16_t ticks, rgb_params_t *const rgb)
+{
+  color_anim_channel_t *ch = &anim_channels[CCT_CHANGE];
+  rgb_params_t cct_rgb;
+
+  color_anim_channel_advance(ch, ticks);
+  cct_to_rgb(CCT_MIN_KELVIN + ch->value * CCT_ANIM_UNIT_KELVIN, hsv->brightness, &cct_rgb);
+
+  return machine_output_set(hsv, cct_rgb, rgb);
+}
+
+/**
+ * @brief Sweeps OKLCh hue, so perceived lightness and speed are even for every hue.
+ *  Lightness and chroma are taken from hsv when it's changed outside,
+ *  chroma is reduced for hues where it doesn't fit into gamut.
+ */
+static bool hue_changing_machine(hsv_params_t *const hsv, uint16_t ticks, rgb_params_t *const rgb)
+{
+  static hsv_params_t produced_hsv;
+  static oklch_t sweep_lch;
+  color_anim_channel_t *ch = &anim_channels[HUE_CHANGE];
+  rgb16_params_t rgb16;
+  rgb_params_t hue_rgb;
+  oklab_t lab;
+  bool is_changed;
+
+  if (memcmp(hsv, &produced_hsv, sizeof(produced_hsv)) != 0)
   {
-    if (ctr > max_value - step)
+    hsv_to_rgb(hsv, &hue_rgb);
+    rgb16 = (rgb16_params_t)
     {
-      *count_down = 1;
-      return ctr - step;
-    }
-
-    ctr += step;
+      .red = hue_rgb.red << RGB16_FRACTION_BITS,
+      .green = hue_rgb.green << RGB16_FRACTION_BITS,
+      .blue = hue_rgb.blue << RGB16_FRACTION_BITS
+    };
+
+    lab = oklab_by_rgb16(rgb16);
+    sweep_lch = oklch_by_oklab(&lab);
+    color_anim_channel_sync(ch, ((uint32_t)sweep_lch.h * HUE_MAX_VALUE) >> 16);
   }
 
-  return ctr;
+  color_anim_channel_advance(ch, ticks);
+  sweep_lch.h = OKLCH_HUE_BY_DEGREES(ch->value);
+  rgb16_by_oklch_in_gamut(sweep_lch, &rgb16);
+
+  hue_rgb.red = (rgb16.red + RGB16_FRACTION_MASK / 2) >> RGB16_FRACTION_BITS;
+  hue_rgb.green = (rgb16.green + RGB16_FRACTION_MASK / 2) >> RGB16_FRACTION_BITS;
+  hue_rgb.blue = (rgb16.blue + RGB16_FRACTION_MASK / 2) >> RGB16_FRACTION_BITS;
+
+  is_changed = machine_output_set(hsv, hue_rgb, rgb);
+  produced_hsv = *hsv;
+
+  return is_changed;
 }
 
 /**
  * @brief This function handles logic of changing hsv color depending on
- *  selected mode and step
+ *  selected mode. RGB is recalculated only if rendered color was changed.
  *
- * @param hsv HSV values
- * @param step step to increment
- * @param mode mode to handle
- * @return rgb_params_t
+ * @param[in,out] hsv HSV values
+ * @param[in] ticks ticks passed since previous call
+ * @param[in] mode mode to handle
+ * @param[out] rgb current rgb color
+ * @return true if rgb was changed since previous call, else false
  */
-rgb_params_t color_changing_machine(hsv_params_t *const hsv, uint16_t step, color_changing_mode_t mode)
+bool color_changing_machine(hsv_params_t *const hsv, uint16_t ticks, color_changing_mode_t mode, rgb_params_t *const rgb)
 {
-  static rgb_params_t rgb_values =
-  {
-    .red = 0,
-    .green = 0,
-    .blue = 0
-  };
+  color_anim_channel_t *ch;
+  hsv8_params_t hsv8;
+  bool is_changed = false;
 
   ASSERT(mode < MODES_COUNT);
+  ch = &anim_channels[mode];
 
-  /* Update rgb_params first */
-  hsv_to_rgb(hsv, &rgb_values);
-
-  switch (mode)
+  if (mode == HUE_CHANGE || mode == CCT_CHANGE)
   {
-    case NO_CHANGE:
-      /* Nothing to do */
-      break;
+    /* Paused sweep shows the current color, so color set outside isn't overwritten */
+    if (ticks == 0)
+    {
+      mode = NO_CHANGE;
+    }
+    else
+    {
+      return mode == HUE_CHANGE ? hue_changing_machine(hsv, ticks, rgb) : cct_changing_machine(hsv, ticks, rgb);
+    }
+  }
 
-    case HUE_CHANGE:
-      hsv->hue = update_ctr(hsv->hue, step, HUE_MAX_VALUE, &count_down_flags[mode]);
-      break;
+  hsv8 = hsv8_by_hsv(hsv);
 
-    case SATURATION_CHANGE:
-      hsv->saturation = update_ctr(hsv->saturation, step, SAT_MAX_VALUE, &count_down_flags[mode]);
-      break;
+  if (mode != NO_CHANGE)
+  {
+    /* hsv was changed outside, continue from it */
+    if (hsv_component_get(hsv, mode) != ch->value)
+    {
+      color_anim_channel_sync(ch, hsv_component_get(hsv, mode));
+    }
 
-    case BRIGHTNESS_CHANGE:
-      hsv->brightness = update_ctr(hsv->brightness, step, BRIGHT_MAX_VALUE, &count_down_flags[mode]);
-      break;
+    color_anim_channel_advance(ch, ticks);
+    hsv_component_set(hsv, &hsv8, ch, mode);
+  }
 
-    default:
-      break;
+  if (memcmp(&hsv8, &hsv8_values, sizeof(hsv8)) != 0)
+  {
+    hsv8_values = hsv8;
+    hsv8_to_rgb(&hsv8_values, &rgb_values);
+    is_changed = true;
   }
 
-  return rgb_values;
+  *rgb = rgb_values;
+  return is_changed;
 }
 
 bool validate_hsv_by_ptr(void* ptr, uint16_t size)
@@ -183,48 +387,46 @@ bool validate_hsv_by_ptr(void* ptr, uint16_t size)
 
 
 /**
- * @brief Using pointer for rgb
- *  Link to algorithm: https://stackoverflow.com/questions/24152553/hsv-to-rgb-and-back-without-floating-point-math-in-python
+ * @brief Converts rgb into hsv directly in [0; 360], [0; 100] ranges
+ *  with rounding to the nearest value. Gray colors have hue 0.
+ *  Uses 2 divisions, division by 255 is replaced with multiplication by compiler.
  *
- * @param[in] rgb pointer to rgb params struct
+ * @param[in] rgb rgb params struct
  * @returns hsv params struct equal to rgb
  */
 hsv_params_t hsv_by_rgb(const rgb_params_t rgb)
 {
   hsv_params_t hsv;
 
-  uint8_t rgb_max = MAX(rgb.red, MAX(rgb.green, rgb.blue));
-  uint8_t rgb_min = MIN(rgb.red, MIN(rgb.green, rgb.blue));
+  const int32_t r = rgb.red;
+  const int32_t g = rgb.green;
+  const int32_t b = rgb.blue;
+  const int32_t rgb_max = MAX(r, MAX(g, b));
+  const int32_t rgb_min = MIN(r, MIN(g, b));
+  const int32_t delta = rgb_max - rgb_min;
+  int32_t hue_num;
+  uint32_t hue;
 
-  hsv.brightness = rgb_max;
-  hsv.brightness = COLOR_REDUCE_POW(COLOR_POW(hsv.brightness) * BRIGHT_MAX_VALUE / 255); /* from [0; 255] to [0; 100] */
+  hsv.brightness = (rgb_max * BRIGHT_MAX_VALUE + RGB_MAX_VALUE / 2) / RGB_MAX_VALUE;
+  hsv.saturation = 0;
+  hsv.hue = 0;
 
-  if (rgb_max == 0)
+  if (delta == 0)
   {
+    /* Gray, includes black */
     return hsv;
   }
 
-  hsv.saturation = 255 * (rgb_max - rgb_min) / rgb_max;
-  hsv.saturation = COLOR_REDUCE_POW(COLOR_POW(hsv.saturation) * SAT_MAX_VALUE / 255);
+  hsv.saturation = (delta * 2 * SAT_MAX_VALUE + rgb_max) / (2 * rgb_max);
 
-  if (hsv.saturation == 0)
-  {
-    return hsv;
-  }
+  /* hue * delta, sector offset keeps it positive */
+  hue_num = (rgb_max == r) ? (g - b) * 60 + 360 * delta :
+            (rgb_max == g) ? (b - r) * 60 + 120 * delta :
+                             (r - g) * 60 + 240 * delta;
 
-  if (rgb_max == rgb.red)
-  {
-    hsv.hue = 43 * (rgb.green - rgb.blue) / (rgb_max - rgb_min);
-  }
-  else if (rgb_max == rgb.green)
-  {
-    hsv.hue = 85 + 43 * (rgb.blue - rgb.red) / (rgb_max - rgb_min);
-  }
-  else /* rgb_max == blue */
-  {
-    hsv.hue = 171 + 43 * (rgb.red - rgb.green) / (rgb_max - rgb_min);
-  }
+  hue = (2 * (uint32_t)hue_num + delta) / (2 * (uint32_t)delta);
+  hue -= (hue >= HUE_MAX_VALUE) ? HUE_MAX_VALUE : 0;
+  hsv.hue = hue;
 
-  hsv.hue = COLOR_REDUCE_POW(COLOR_POW(hsv.hue) * HUE_MAX_VALUE / 255);
   return hsv;
-}
\ No newline at end of file
+}
@@ -2,6 +2,7 @@
 #define _RGB_HSV_UTILS
 
 #include <nrfx.h>
+#include "color_anim.h"
 
 #define COLOR_POWER                     10      //must be greater than 0 less than 10 cus using 32 bit for calculations
 #define COLOR_POW(color)                ((uint32_t)(color) << COLOR_POWER)
@@ -12,6 +13,10 @@
 #define BRIGHT_MAX_VALUE                100
 
 #define RGB_MAX_VALUE                   255
+#define RGB16_FRACTION_BITS             8
+#define RGB16_FRACTION_MASK             ((1U << RGB16_FRACTION_BITS) - 1)
+
+#define COLOR_ANIM_DEFAULT_SPEED        10      /* units per second */
 
 #define HSV_STRUCT_DEFAULT_VALUE        \
 {                                       \
@@ -27,6 +32,14 @@ typedef struct rgb_params_s
   uint8_t blue;
 } rgb_params_t;
 
+/* rgb with RGB16_FRACTION_BITS fractional bits, [0; RGB_MAX_VALUE << RGB16_FRACTION_BITS] */
+typedef struct rgb16_params_s
+{
+  uint16_t red;
+  uint16_t green;
+  uint16_t blue;
+} rgb16_params_t;
+
 typedef struct hsv_params_s
 {
   uint16_t hue;
@@ -40,10 +53,19 @@ typedef enum color_changing_mode_e
   HUE_CHANGE        = 1,
   SATURATION_CHANGE = 2,
   BRIGHTNESS_CHANGE = 3,
-  MODES_COUNT       = 4
+  CCT_CHANGE        = 4,    /* sweep of blackbody color temperature */
+  MODES_COUNT       = 5
 } color_changing_mode_t;
 
-rgb_params_t color_changing_machine(hsv_params_t *const hsv, uint16_t step, color_changing_mode_t mode);
+void color_anim_init(uint32_t tick_us);
+void color_anim_speed_set(color_changing_mode_t mode, uint16_t units_per_sec);
+void color_anim_easing_set(color_changing_mode_t mode, color_easing_t easing);
+uint8_t color_anim_directions_get(void);
+void color_anim_directions_set(uint8_t directions);
+bool color_changing_machine(hsv_params_t *const hsv, uint16_t ticks, color_changing_mode_t mode, rgb_params_t *const rgb);
+
+void hsv_to_rgb(const hsv_params_t *const hsv, rgb_params_t *const rgb);
+void hsv_to_rgb_batch(const hsv_params_t *hsv, rgb_params_t *rgb, uint16_t count);
 
 bool validate_hsv_by_ptr(void* ptr, uint16_t size);
 hsv_params_t hsv_by_rgb(const rgb_params_t rgb);
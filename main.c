@@ -16,15 +16,26 @@
 #include "pwm_module.h"
 #include "hsv_to_rgb.h"
 #include "nvmc_module.h"
+#include "nvmc_kv.h"
 #include "usbd_module.h"
 #include "cli_usb.h"
+#include "app_state.h"
+#include "effect.h"
+#include "color_calib.h"
+#include "preset.h"
+#include "color_history.h"
+#include "state_journal.h"
+#include "settings.h"
+#include "crash_dump.h"
 
 
 /* Timer timeouts ==============================================*/
 #define BTN_DISABLE_ACTIVITY_TIMEOUT_TICKS          (APP_TIMER_CLOCK_FREQ / 14)     /* RTC timer ticks */
 #define BTN_DOUBLE_CLICK_TIMEOUT_TICKS              APP_TIMER_CLOCK_FREQ            /* 1 sec timeout */
 #define BTN_LONG_CLICK_TIMEOUT_TICKS                (APP_TIMER_CLOCK_FREQ >> 1)     /* MUST be less than BTN_DOUBLE_CLICK_TIMEOUT_TICKS */
+#define BTN_UNDO_CLICK_TIMEOUT_TICKS                (APP_TIMER_CLOCK_FREQ * 2)      /* 2 sec hold */
 STATIC_ASSERT(BTN_LONG_CLICK_TIMEOUT_TICKS < BTN_DOUBLE_CLICK_TIMEOUT_TICKS);
+STATIC_ASSERT(BTN_LONG_CLICK_TIMEOUT_TICKS < BTN_UNDO_CLICK_TIMEOUT_TICKS);
 
 /* static vars declaration ======================================= */
 /* timer config */
@@ -32,8 +43,6 @@ APP_TIMER_DEF(timer_id_double_click_timeout);
 APP_TIMER_DEF(timer_id_en_btn_timeout);
 /* btn config */
 static nrfx_gpiote_in_config_t gpiote_btn_config;
-/* app data */
-g_app_data_t g_app_data;
 
 /* static function declaration  ====================================*/
 static void logs_init(void);
@@ -42,68 +51,84 @@ static void init_all();
 /* interrupt handlers ============================================== */
 static void timer_double_click_timeout_handler(void *p_context)
 {
-  g_app_data.flags.fst_click_occurred = false;
+  app_state_flag_clear(APP_FLAG_FST_CLICK_OCCURRED);
 }
 
 static void timer_en_btn_timeout_handler(void *p_context)
 {
   /* btn value at the end of disable timeout */
-  if (g_app_data.flags.btn_pressed)
-  {
-    g_app_data.flags.app_is_running = true;
-  }
-  else
-  {
-    g_app_data.flags.app_is_running = false;
-  }
-
-  g_app_data.flags.btn_is_disabled = false;
+  app_state_flag_write(APP_FLAG_APP_IS_RUNNING, app_state_flag_get(APP_FLAG_BTN_PRESSED));
+  app_state_flag_clear(APP_FLAG_BTN_IS_DISABLED);
 }
 
 static void btn_pressed_evt_handler(nrfx_gpiote_pin_t pin, nrf_gpiote_polarity_t action)
 {
   static uint32_t timer_start_timestamp = 0;
+  static uint32_t press_timestamp = 0;
+  uint8_t led_mode;
 
   /* Track btn state: false is released, true is pressed now */
-  g_app_data.flags.btn_pressed ^= true;
+  bool btn_pressed = app_state_flag_toggle(APP_FLAG_BTN_PRESSED);
+
+  crash_dump_trace(CRASH_TRACE_BTN, btn_pressed);
 
-  if (!(g_app_data.flags.btn_is_disabled))
+  if (!app_state_flag_get(APP_FLAG_BTN_IS_DISABLED))
   {
-    if (g_app_data.flags.btn_pressed)
+    if (btn_pressed)
     {
       NRF_LOG_INFO("Btn pressed");
+      press_timestamp = app_timer_cnt_get();
 
-      if (!(g_app_data.flags.fst_click_occurred))
+      if (!app_state_flag_get(APP_FLAG_FST_CLICK_OCCURRED))
       {
         timer_start_timestamp = app_timer_cnt_get();
-        g_app_data.flags.fst_click_occurred = true;
+        app_state_flag_set(APP_FLAG_FST_CLICK_OCCURRED);
         app_timer_start(timer_id_double_click_timeout, BTN_DOUBLE_CLICK_TIMEOUT_TICKS, NULL);
       }
       else if (app_timer_cnt_diff_compute(app_timer_cnt_get(), timer_start_timestamp) < BTN_DOUBLE_CLICK_TIMEOUT_TICKS)
       {
-        g_app_data.flags.fst_click_occurred = false;
-        g_app_data.current_led_mode = (g_app_data.current_led_mode + 1) % MODES_COUNT;
+        app_state_flag_clear(APP_FLAG_FST_CLICK_OCCURRED);
         reset_indicator_led();
 
-        if (!g_app_data.current_led_mode)
+        /* Effects are selected after color changing modes */
+        led_mode = app_state_led_mode_next(MODES_COUNT + effects_count());
+        crash_dump_trace(CRASH_TRACE_LED_MODE, led_mode);
+
+        if (led_mode == NO_CHANGE)
         {
-          nvmc_write_new_record(g_app_data.current_hsv);
+          /* Only color edited by button is saved, CLI edits wait for its save command */
+          color_history_commit(app_state_hsv_get());
+          settings_color_save_request();
         }
       }
     }
     else
     {
+      const uint32_t hold_ticks = app_timer_cnt_diff_compute(app_timer_cnt_get(), press_timestamp);
+      hsv_params_t hsv;
+
       NRF_LOG_INFO("Btn released");
 
+      /* Holding does nothing in NO_CHANGE mode, so long click there recalls
+       * the next preset and very long one returns the previous color */
+      if (app_state_led_mode_get() == NO_CHANGE && hold_ticks >= BTN_UNDO_CLICK_TIMEOUT_TICKS)
+      {
+        color_history_undo(&hsv);
+      }
+      else if (app_state_led_mode_get() == NO_CHANGE && hold_ticks >= BTN_LONG_CLICK_TIMEOUT_TICKS)
+      {
+        preset_load_next();
+      }
+
       /* It isn't double click */
       if (app_timer_cnt_diff_compute(app_timer_cnt_get(), timer_start_timestamp) < BTN_DOUBLE_CLICK_TIMEOUT_TICKS)
       {
-        g_app_data.flags.fst_click_occurred = false;
+        app_state_flag_clear(APP_FLAG_FST_CLICK_OCCURRED);
       }
     }
 
     /* Always disable any actions with btn if it was enabled */
-    g_app_data.flags.btn_is_disabled = true;
+    app_state_flag_set(APP_FLAG_BTN_IS_DISABLED);
     app_timer_start(timer_id_en_btn_timeout, BTN_DISABLE_ACTIVITY_TIMEOUT_TICKS, NULL);
   }
 }
@@ -116,15 +141,36 @@ static void btn_pressed_evt_handler(nrfx_gpiote_pin_t pin, nrf_gpiote_polarity_t
  */
 int main(void)
 {
-  g_app_data.current_hsv = nvmc_find_last_record();
+  uint8_t led_mode;
+
+  /* Settings are loaded first and report broken ones */
+  logs_init();
+  crash_dump_init();
+
+  nvmc_init();
+  app_state_init(nvmc_find_last_record());
+  effects_init();
+  color_calib_init();
+  presets_init();
+  color_history_init(app_state_hsv_get());
+
+  if (nvmc_kv_get(NVMC_KV_KEY_LED_MODE, &led_mode, sizeof(led_mode)) &&
+      led_mode < MODES_COUNT + effects_count())
+  {
+    app_state_led_mode_set(led_mode);
+  }
+
+  state_journal_init();
 
   init_pwm();
   init_all();
-  init_cli(&update_leds, &nvmc_write_new_record);
 
   while (true)
   {
+    settings_process();
     nvmc_erase_last_written_page();
+    state_journal_process();
+    crash_dump_process();
 
     __WFE();
 
@@ -157,8 +203,6 @@ static void init_all()
   /* Init systick */
   nrfx_systick_init();
 
-  /* Init logs */
-  logs_init();
   NRF_LOG_INFO("Starting up the test project with USB logging");
 
   /* Init leds and btns */
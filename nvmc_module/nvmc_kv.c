@@ -0,0 +1,702 @@
+#include "nvmc_kv.h"
+#include "nvmc_module.h"
+#include "nrfx_nvmc.h"
+#include "nrf_nvmc.h"
+#include "crc16.h"
+#include "app_util_platform.h"
+#include "nrf_assert.h"
+#include <string.h>
+
+#define NVMC_KV_ERASED_WORD                 0xFFFFFFFFU
+#define NVMC_KV_INDEX_EMPTY                 0xFFFF
+#define NVMC_KV_INDEX_MASK                  (NVMC_KV_INDEX_SIZE - 1)
+
+#define NVMC_KV_WORD_ALIGN(size)            (((size) + sizeof(uint32_t) - 1) & ~(sizeof(uint32_t) - 1))
+#define NVMC_KV_RECORD_SIZE(value_size)     (NVMC_KV_RECORD_HEADER_SIZE + NVMC_KV_WORD_ALIGN(value_size))
+
+/* Set in stored key of every record of batch except the last one */
+#define RECORD_FLAG_MORE                    0x80
+
+/* Record header: key in the lowest byte, value size in the next one and crc16 in high half word */
+#define RECORD_HEADER(key, size, crc)       ((uint32_t)(key) | ((uint32_t)(size) << 8) | ((uint32_t)(crc) << 16))
+#define RECORD_KEY(header)                  ((header) & ~RECORD_FLAG_MORE & 0xFF)
+#define RECORD_IS_MORE(header)              (((header) & RECORD_FLAG_MORE) != 0)
+#define RECORD_VALUE_SIZE(header)           (((header) >> 8) & 0xFF)
+#define RECORD_CRC(header)                  ((header) >> 16)
+
+/* One page is the log, the other one is erased in background and receives live records on compaction */
+STATIC_ASSERT(NVMC_PAGES_CNT == 2);
+STATIC_ASSERT((NVMC_KV_INDEX_SIZE & NVMC_KV_INDEX_MASK) == 0);
+STATIC_ASSERT(NVMC_KV_KEYS_MAX < NVMC_KV_INDEX_SIZE);
+STATIC_ASSERT(NVMC_KV_VALUE_MAX_SIZE <= UINT8_MAX);
+STATIC_ASSERT(NVMC_KV_KEYS_END < RECORD_FLAG_MORE);
+STATIC_ASSERT(NVMC_KV_BATCH_MAX <= NVMC_KV_KEYS_MAX);
+STATIC_ASSERT(NVMC_KV_KEYS_MAX * NVMC_KV_RECORD_SIZE(NVMC_KV_VALUE_MAX_SIZE) <= CODE_PAGE_SIZE - NVMC_KV_PAGE_HEADER_SIZE);
+
+typedef struct nvmc_kv_page_header_s
+{
+  uint32_t magic;               /* written last, page isn't used without it */
+  uint32_t generation;          /* page with bigger one is newer */
+} nvmc_kv_page_header_t;
+
+STATIC_ASSERT(sizeof(nvmc_kv_page_header_t) == NVMC_KV_PAGE_HEADER_SIZE);
+
+typedef struct nvmc_kv_index_entry_s
+{
+  uint16_t offset;              /* of the last record of key from page start, NVMC_KV_INDEX_EMPTY if entry is free */
+  uint8_t key;
+} nvmc_kv_index_entry_t;
+
+typedef struct nvmc_kv_s
+{
+  nvmc_kv_index_entry_t index[NVMC_KV_INDEX_SIZE];
+  uint32_t page_addr;           /* page of the log */
+  uint32_t generation;
+  uint32_t free_offset;         /* the next record is appended here */
+  uint32_t version;             /* changed when any value is written or moved, see @ref nvmc_kv_get_ptr */
+  uint8_t keys_count;
+  bool spare_is_dirty;          /* spare page must be erased before compaction */
+} nvmc_kv_t;
+
+static nvmc_kv_t kv;
+
+#if NVMC_KV_STATS_ENABLED
+#include "nrf_log.h"
+
+typedef enum nvmc_kv_op_e
+{
+  NVMC_KV_OP_INIT,                /* boot recovery: page selection and index build */
+  NVMC_KV_OP_PUT,                 /* append of one batch, compaction is included if it was triggered */
+  NVMC_KV_OP_COMPACT,             /* page rollover with blocking erase if it's needed */
+  NVMC_KV_OP_ERASE_STEP,          /* one step of background erase */
+} nvmc_kv_op_t;
+
+static const char *const stats_op_names[] = {"init", "put", "compact", "erase_step"};
+
+static void stats_init(void)
+{
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CYCCNT = 0;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+  NRF_LOG_INFO("nvmc_kv,op,cycles,fill");
+}
+
+static inline uint32_t stats_start(void)
+{
+  return DWT->CYCCNT;
+}
+
+/**
+ * @brief Logs one sample, distribution is built from samples on host.
+ *  Fill is measured after operation, so rollover cost can be tracked against it.
+ */
+static void stats_sample(nvmc_kv_op_t op, uint32_t start)
+{
+  const uint32_t cycles = DWT->CYCCNT - start;
+
+  NRF_LOG_INFO("nvmc_kv,%s,%u,%u", stats_op_names[op], cycles, kv.free_offset * 100 / CODE_PAGE_SIZE);
+}
+
+#else /* NVMC_KV_STATS_ENABLED */
+#define stats_init()
+#define stats_start()                       0
+#define stats_sample(op, start)             UNUSED_VARIABLE(start)
+
+#endif /* NVMC_KV_STATS_ENABLED */
+
+static uint32_t spare_page_addr_get(void)
+{
+  return kv.page_addr == NVMC_START_APP_DATA_ADDR ? NVMC_START_APP_DATA_ADDR + CODE_PAGE_SIZE : NVMC_START_APP_DATA_ADDR;
+}
+
+/**
+ * @brief Flash is written in one session: NVMC is switched to write mode once
+ *  and back to read only when all words are written, not around every word as
+ *  nrfx_nvmc_word_write() does. Session mustn't include erase.
+ */
+static void write_session_begin(void)
+{
+  nrf_nvmc_mode_set(NRF_NVMC, NRF_NVMC_MODE_WRITE);
+}
+
+static void write_session_word(uint32_t addr, uint32_t value)
+{
+  while (!nrf_nvmc_ready_check(NRF_NVMC))
+  {
+  }
+
+  *(volatile uint32_t*)addr = value;
+  __DMB();
+}
+
+/**
+ * @brief Writes value by words, the tail of the last word is padded with 0xFF.
+ */
+static void write_session_value(uint32_t addr, const void *value, uint8_t size)
+{
+  uint32_t word;
+
+  for (uint8_t pos = 0; pos < size; pos += sizeof(uint32_t), addr += sizeof(uint32_t))
+  {
+    word = NVMC_KV_ERASED_WORD;
+    memcpy(&word, (const uint8_t*)value + pos, MIN(sizeof(uint32_t), (uint32_t)(size - pos)));
+    write_session_word(addr, word);
+  }
+}
+
+static void write_session_end(void)
+{
+  while (!nrf_nvmc_ready_check(NRF_NVMC))
+  {
+  }
+
+  nrf_nvmc_mode_set(NRF_NVMC, NRF_NVMC_MODE_READONLY);
+}
+
+static uint16_t record_crc(uint8_t key, uint8_t size, const void *value)
+{
+  const uint8_t header[2] = {key, size};
+  uint16_t crc = crc16_compute(header, sizeof(header), NULL);
+
+  return size > 0 ? crc16_compute(value, size, &crc) : crc;
+}
+
+static inline uint32_t record_header_get(uint32_t offset)
+{
+  return *(uint32_t*)(kv.page_addr + offset);
+}
+
+/**
+ * @brief Finds index entry of key. Keys are small sequential numbers,
+ *  so the low bits are used as hash and almost every key has its own entry.
+ *
+ * @param is_insert return free entry if key isn't indexed
+ * @return entry or NULL if key isn't indexed (and index is full when is_insert)
+ */
+static nvmc_kv_index_entry_t* index_entry_get(uint8_t key, bool is_insert)
+{
+  uint8_t pos = key & NVMC_KV_INDEX_MASK;
+
+  for (uint8_t i = 0; i < NVMC_KV_INDEX_SIZE; i++, pos = (pos + 1) & NVMC_KV_INDEX_MASK)
+  {
+    nvmc_kv_index_entry_t *const entry = &kv.index[pos];
+
+    if (entry->offset == NVMC_KV_INDEX_EMPTY)
+    {
+      return is_insert && kv.keys_count < NVMC_KV_KEYS_MAX ? entry : NULL;
+    }
+
+    if (entry->key == key)
+    {
+      return entry;
+    }
+  }
+
+  return NULL;
+}
+
+static bool index_set(uint8_t key, uint32_t offset)
+{
+  nvmc_kv_index_entry_t *const entry = index_entry_get(key, true);
+
+  if (entry == NULL)
+  {
+    return false;
+  }
+
+  if (entry->offset == NVMC_KV_INDEX_EMPTY)
+  {
+    entry->key = key;
+    kv.keys_count++;
+  }
+
+  entry->offset = offset;
+
+  return true;
+}
+
+/**
+ * @brief Rebuilds index from the log page.
+ *  Every record is written first by its header, so a broken record can be only
+ *  the last one. Records of batch are indexed when its last record is read, batch
+ *  without it is dropped as a whole. Nothing is appended after broken record
+ *  or dropped batch, the page is compacted on the next put.
+ */
+static void page_scan(void)
+{
+  uint16_t batch_offsets[NVMC_KV_BATCH_MAX];
+  uint8_t batch_count = 0;
+  uint32_t offset = NVMC_KV_PAGE_HEADER_SIZE;
+  uint32_t header;
+  uint8_t size;
+  uint8_t key;
+
+  memset(kv.index, 0xFF, sizeof(kv.index));
+  kv.keys_count = 0;
+
+  while (offset + NVMC_KV_RECORD_HEADER_SIZE <= CODE_PAGE_SIZE)
+  {
+    header = record_header_get(offset);
+
+    if (header == NVMC_KV_ERASED_WORD)
+    {
+      break;
+    }
+
+    key = RECORD_KEY(header);
+    size = RECORD_VALUE_SIZE(header);
+
+    if (key == NVMC_KV_KEY_INVALID || key >= NVMC_KV_KEYS_END || batch_count == NVMC_KV_BATCH_MAX ||
+        size > NVMC_KV_VALUE_MAX_SIZE || offset + NVMC_KV_RECORD_SIZE(size) > CODE_PAGE_SIZE ||
+        RECORD_CRC(header) != record_crc(key, size, (void*)(kv.page_addr + offset + NVMC_KV_RECORD_HEADER_SIZE)))
+    {
+      offset = CODE_PAGE_SIZE;
+      break;
+    }
+
+    batch_offsets[batch_count++] = offset;
+    offset += NVMC_KV_RECORD_SIZE(size);
+
+    if (RECORD_IS_MORE(header))
+    {
+      continue;
+    }
+
+    for (uint8_t i = 0; i < batch_count; i++)
+    {
+      if (!index_set(RECORD_KEY(record_header_get(batch_offsets[i])), batch_offsets[i]))
+      {
+        offset = CODE_PAGE_SIZE;
+        break;
+      }
+    }
+
+    batch_count = 0;
+  }
+
+  kv.free_offset = batch_count == 0 ? offset : CODE_PAGE_SIZE;
+}
+
+static void page_header_write(uint32_t page_addr, uint32_t generation)
+{
+  nrfx_nvmc_word_write(page_addr + offsetof(nvmc_kv_page_header_t, generation), generation);
+  nrfx_nvmc_word_write(page_addr + offsetof(nvmc_kv_page_header_t, magic), NVMC_KV_PAGE_MAGIC);
+}
+
+/**
+ * @brief Clears magic of page that isn't the log anymore. Partially erased page
+ *  may keep its old magic and get any generation, so it's never left valid.
+ */
+static void page_invalidate(uint32_t page_addr)
+{
+  nrfx_nvmc_word_write(page_addr + offsetof(nvmc_kv_page_header_t, magic), 0);
+}
+
+/**
+ * @brief Copies live records into spare page and makes it the log.
+ *  Old page stays valid until the new one has its magic, so power loss
+ *  at any moment leaves one of them. Old page is invalidated and erased in background.
+ *  Blocks for a whole page erase if background erase hasn't finished yet.
+ */
+static void page_compact(void)
+{
+  const uint32_t stats_start_cycles = stats_start();
+  const uint32_t spare_addr = spare_page_addr_get();
+  uint32_t offset = NVMC_KV_PAGE_HEADER_SIZE;
+  uint32_t header;
+  uint8_t size;
+
+  if (kv.spare_is_dirty)
+  {
+    nvmc_page_erase_cancel(spare_addr);
+    nrfx_nvmc_page_erase(spare_addr);
+    kv.spare_is_dirty = false;
+  }
+
+  write_session_begin();
+
+  for (uint8_t i = 0; i < NVMC_KV_INDEX_SIZE; i++)
+  {
+    if (kv.index[i].offset == NVMC_KV_INDEX_EMPTY)
+    {
+      continue;
+    }
+
+    header = record_header_get(kv.index[i].offset);
+    size = RECORD_VALUE_SIZE(header);
+
+    /* Deleted key */
+    if (size == 0)
+    {
+      continue;
+    }
+
+    /* crc doesn't depend on address and batch flag, record is copied as a single one */
+    write_session_word(spare_addr + offset, header & ~RECORD_FLAG_MORE);
+    write_session_value(spare_addr + offset + NVMC_KV_RECORD_HEADER_SIZE,
+                        (void*)(kv.page_addr + kv.index[i].offset + NVMC_KV_RECORD_HEADER_SIZE), size);
+    offset += NVMC_KV_RECORD_SIZE(size);
+  }
+
+  write_session_end();
+
+  page_header_write(spare_addr, ++kv.generation);
+  page_invalidate(kv.page_addr);
+
+  /* The same for spare page, it's erased in background after every boot */
+  kv.spare_is_dirty = true;
+
+  /* Renderer takes pointers in interrupts, index and page are switched at once */
+  CRITICAL_REGION_ENTER();
+  kv.page_addr = spare_addr;
+  page_scan();
+  kv.version++;
+  CRITICAL_REGION_EXIT();
+
+  stats_sample(NVMC_KV_OP_COMPACT, stats_start_cycles);
+}
+
+/**
+ * @return true if records fit into the rest of page and index has entries for their keys
+ */
+static bool records_fit(const nvmc_kv_item_t *items, uint8_t count)
+{
+  uint32_t records_size = 0;
+  uint8_t new_keys = 0;
+
+  for (uint8_t i = 0; i < count; i++)
+  {
+    records_size += NVMC_KV_RECORD_SIZE(items[i].size);
+    new_keys += index_entry_get(items[i].key, false) == NULL ? 1 : 0;
+  }
+
+  if (kv.free_offset + records_size > CODE_PAGE_SIZE || kv.keys_count + new_keys > NVMC_KV_KEYS_MAX)
+  {
+    return false;
+  }
+
+  /* Place after the last record must be erased, otherwise the page is compacted */
+  for (uint32_t offset = kv.free_offset; offset < kv.free_offset + records_size; offset += sizeof(uint32_t))
+  {
+    if (record_header_get(offset) != NVMC_KV_ERASED_WORD)
+    {
+      kv.free_offset = CODE_PAGE_SIZE;
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/**
+ * @brief Appends records as one batch in one write session, header of every record is written first.
+ *  Keys of batch must be different.
+ *
+ * @param items records, value size 0 deletes key
+ */
+static bool records_append(const nvmc_kv_item_t *items, uint8_t count)
+{
+  uint32_t addr;
+  uint8_t key;
+
+  /* Deleted keys hold index entries until compaction */
+  if (!records_fit(items, count))
+  {
+    page_compact();
+
+    if (!records_fit(items, count))
+    {
+      return false;
+    }
+  }
+
+  write_session_begin();
+
+  for (uint8_t i = 0; i < count; i++)
+  {
+    addr = kv.page_addr + kv.free_offset;
+    key = i + 1 < count ? items[i].key | RECORD_FLAG_MORE : items[i].key;
+
+    write_session_word(addr, RECORD_HEADER(key, items[i].size, record_crc(items[i].key, items[i].size, items[i].value)));
+    write_session_value(addr + NVMC_KV_RECORD_HEADER_SIZE, items[i].value, items[i].size);
+
+    index_set(items[i].key, kv.free_offset);
+    kv.free_offset += NVMC_KV_RECORD_SIZE(items[i].size);
+  }
+
+  write_session_end();
+  kv.version++;
+
+  return true;
+}
+
+/**
+ * @return value size of key or -1 if key isn't stored
+ */
+static int16_t value_get(uint8_t key, const void **value)
+{
+  const nvmc_kv_index_entry_t *entry = index_entry_get(key, false);
+  uint32_t header;
+
+  if (entry == NULL)
+  {
+    return -1;
+  }
+
+  header = record_header_get(entry->offset);
+  *value = (const void*)(kv.page_addr + entry->offset + NVMC_KV_RECORD_HEADER_SIZE);
+
+  return RECORD_VALUE_SIZE(header) > 0 ? RECORD_VALUE_SIZE(header) : -1;
+}
+
+static inline bool key_is_valid(nvmc_kv_key_t key)
+{
+  return key != NVMC_KV_KEY_INVALID && key < NVMC_KV_KEYS_END;
+}
+
+/**
+ * @brief Selects the newest valid page as the log and builds RAM index.
+ *  Blank or broken flash gets a new empty log.
+ */
+void nvmc_kv_init(void)
+{
+  const nvmc_kv_page_header_t *pages[NVMC_PAGES_CNT] =
+  {
+    (const nvmc_kv_page_header_t*)NVMC_START_APP_DATA_ADDR,
+    (const nvmc_kv_page_header_t*)(NVMC_START_APP_DATA_ADDR + CODE_PAGE_SIZE),
+  };
+  const bool is_valid[NVMC_PAGES_CNT] =
+  {
+    pages[0]->magic == NVMC_KV_PAGE_MAGIC,
+    pages[1]->magic == NVMC_KV_PAGE_MAGIC,
+  };
+  uint8_t active = 0;
+  uint32_t stats_start_cycles;
+
+  stats_init();
+  stats_start_cycles = stats_start();
+
+  if (is_valid[0] && is_valid[1])
+  {
+    /* Power was lost before old page was erased after compaction */
+    active = (int32_t)(pages[1]->generation - pages[0]->generation) > 0 ? 1 : 0;
+  }
+  else if (is_valid[1])
+  {
+    active = 1;
+  }
+
+  kv.page_addr = (uint32_t)pages[active];
+  kv.generation = pages[active]->generation;
+
+  if (!is_valid[active])
+  {
+    /* Erase interrupted by power loss may leave page that reads as erased,
+     * but it can't be written until it's erased again */
+    nrfx_nvmc_page_erase(kv.page_addr);
+
+    kv.generation = 0;
+    page_header_write(kv.page_addr, kv.generation);
+  }
+
+  if (is_valid[0] && is_valid[1])
+  {
+    page_invalidate(spare_page_addr_get());
+  }
+
+  /* The same for spare page, it's erased in background after every boot */
+  kv.spare_is_dirty = true;
+
+  page_scan();
+
+  stats_sample(NVMC_KV_OP_INIT, stats_start_cycles);
+}
+
+/**
+ * @brief Copies value of key.
+ *
+ * @param size expected value size
+ * @return false if key isn't stored or has other size
+ */
+bool nvmc_kv_get(nvmc_kv_key_t key, void *value, uint8_t size)
+{
+  const void *stored;
+  bool ret = false;
+
+  if (!key_is_valid(key))
+  {
+    return false;
+  }
+
+  CRITICAL_REGION_ENTER();
+
+  if (value_get(key, &stored) == size)
+  {
+    memcpy(value, stored, size);
+    ret = true;
+  }
+
+  CRITICAL_REGION_EXIT();
+
+  return ret;
+}
+
+/**
+ * @brief Returns value of key in place, flash is memory mapped and nothing is copied.
+ *  Value was verified by crc when the page was scanned or when it was written.
+ *  Pointer is valid until @ref nvmc_kv_version is changed: new value of the key
+ *  is written elsewhere and compaction moves records and erases the old page.
+ *
+ * @param size expected value size
+ * @return word aligned value or NULL if key isn't stored or has other size
+ */
+const void* nvmc_kv_get_ptr(nvmc_kv_key_t key, uint8_t size)
+{
+  const void *stored;
+  const void *ret = NULL;
+
+  if (!key_is_valid(key))
+  {
+    return NULL;
+  }
+
+  CRITICAL_REGION_ENTER();
+
+  if (value_get(key, &stored) == size)
+  {
+    ret = stored;
+  }
+
+  CRITICAL_REGION_EXIT();
+
+  return ret;
+}
+
+/**
+ * @brief Counter that is changed on every write and compaction,
+ *  pointers of @ref nvmc_kv_get_ptr must be taken again if it was changed.
+ */
+uint32_t nvmc_kv_version(void)
+{
+  return kv.version;
+}
+
+/**
+ * @brief Appends new values of keys as one batch, nothing is written for values
+ *  that aren't changed. After power loss either all new values are read or none
+ *  of them. Page is compacted when it's full.
+ *
+ * @param items up to NVMC_KV_BATCH_MAX values of different keys
+ * @return false if any value is invalid or there is no place for them
+ */
+bool nvmc_kv_put_batch(const nvmc_kv_item_t *items, uint8_t count)
+{
+  nvmc_kv_item_t changed[NVMC_KV_BATCH_MAX];
+  uint8_t changed_count = 0;
+  uint32_t stats_start_cycles;
+  const void *stored;
+  bool ret = true;
+
+  if (count > NVMC_KV_BATCH_MAX)
+  {
+    return false;
+  }
+
+  for (uint8_t i = 0; i < count; i++)
+  {
+    if (!key_is_valid(items[i].key) || items[i].size == 0 || items[i].size > NVMC_KV_VALUE_MAX_SIZE)
+    {
+      return false;
+    }
+
+    for (uint8_t j = 0; j < i; j++)
+    {
+      if (items[j].key == items[i].key)
+      {
+        return false;
+      }
+    }
+  }
+
+  /* CPU is stalled by NVMC while flash is written anyway,
+   * so the store is simply locked for callers from any priority */
+  CRITICAL_REGION_ENTER();
+
+  for (uint8_t i = 0; i < count; i++)
+  {
+    if (value_get(items[i].key, &stored) != items[i].size || memcmp(stored, items[i].value, items[i].size))
+    {
+      changed[changed_count++] = items[i];
+    }
+  }
+
+  if (changed_count > 0)
+  {
+    stats_start_cycles = stats_start();
+    ret = records_append(changed, changed_count);
+    stats_sample(NVMC_KV_OP_PUT, stats_start_cycles);
+  }
+
+  CRITICAL_REGION_EXIT();
+
+  return ret;
+}
+
+bool nvmc_kv_put(nvmc_kv_key_t key, const void *value, uint8_t size)
+{
+  const nvmc_kv_item_t item = {.key = key, .value = value, .size = size};
+
+  return nvmc_kv_put_batch(&item, 1);
+}
+
+bool nvmc_kv_delete(nvmc_kv_key_t key)
+{
+  const nvmc_kv_item_t item = {.key = key, .value = NULL, .size = 0};
+  const void *stored;
+  bool ret = true;
+
+  if (!key_is_valid(key))
+  {
+    return false;
+  }
+
+  CRITICAL_REGION_ENTER();
+
+  if (value_get(key, &stored) >= 0)
+  {
+    ret = records_append(&item, 1);
+  }
+
+  CRITICAL_REGION_EXIT();
+
+  return ret;
+}
+
+/**
+ * @brief Erases spare page step by step, call it from main loop.
+ *  Number of calls to erase page: 85 / NVMC_ERASE_DURATION_MS
+ */
+void nvmc_kv_process(void)
+{
+  uint32_t stats_start_cycles;
+  bool is_erased;
+
+  /* Compaction erases and fills spare page, it mustn't happen between steps */
+  CRITICAL_REGION_ENTER();
+
+  if (kv.spare_is_dirty)
+  {
+    stats_start_cycles = stats_start();
+    is_erased = nvmc_page_erase_process(spare_page_addr_get());
+
+    stats_sample(NVMC_KV_OP_ERASE_STEP, stats_start_cycles);
+
+    if (is_erased)
+    {
+      kv.spare_is_dirty = false;
+    }
+  }
+
+  CRITICAL_REGION_EXIT();
+}
@@ -0,0 +1,54 @@
+#ifndef _NVMC_KV_H
+#define _NVMC_KV_H
+
+#include "nrfx.h"
+
+#define NVMC_KV_PAGE_MAGIC                  0x4B564C47U     /* "GLVK", page is a valid log */
+#define NVMC_KV_PAGE_HEADER_SIZE            8               /* magic and generation */
+#define NVMC_KV_RECORD_HEADER_SIZE          4               /* key, value size and crc16 */
+#define NVMC_KV_VALUE_MAX_SIZE              128
+#define NVMC_KV_KEYS_MAX                    24              /* keys that can be stored at once */
+#define NVMC_KV_INDEX_SIZE                  32              /* power of 2, bigger than NVMC_KV_KEYS_MAX to keep probes short */
+#define NVMC_KV_BATCH_MAX                   10              /* records that are written at once, the whole configuration */
+
+/* Logs DWT cycles of every store operation as CSV row "nvmc_kv,<op>,<cycles>,<fill %>" */
+#ifndef NVMC_KV_STATS_ENABLED
+#define NVMC_KV_STATS_ENABLED               0
+#endif
+
+/**
+ * @brief Keys of settings. Values are never reused for other data,
+ *  new keys are only appended.
+ */
+typedef enum nvmc_kv_key_e
+{
+  NVMC_KV_KEY_INVALID = 0,
+  NVMC_KV_KEY_HSV,                  /* hsv_params_t, color of NO_CHANGE mode */
+  NVMC_KV_KEY_LED_MODE,             /* uint8_t, led mode that is selected at boot */
+  NVMC_KV_KEY_PRESETS,              /* color presets table of @ref preset.h */
+  NVMC_KV_KEY_COLOR_HISTORY,        /* undo ring of @ref color_history.h */
+  NVMC_KV_KEY_COLOR_CALIB,          /* color_calib_t */
+  NVMC_KV_KEY_EFFECT_0,             /* effect_t of every slot */
+  NVMC_KV_KEY_EFFECT_1,
+  NVMC_KV_KEY_EFFECT_2,
+  NVMC_KV_KEY_EFFECT_3,
+  NVMC_KV_KEYS_END = 0x7F           /* keys are 7 bit, the 8th bit of stored key marks batch */
+} nvmc_kv_key_t;
+
+typedef struct nvmc_kv_item_s
+{
+  nvmc_kv_key_t key;
+  const void *value;
+  uint8_t size;
+} nvmc_kv_item_t;
+
+void nvmc_kv_init(void);
+bool nvmc_kv_get(nvmc_kv_key_t key, void *value, uint8_t size);
+const void* nvmc_kv_get_ptr(nvmc_kv_key_t key, uint8_t size);
+uint32_t nvmc_kv_version(void);
+bool nvmc_kv_put(nvmc_kv_key_t key, const void *value, uint8_t size);
+bool nvmc_kv_put_batch(const nvmc_kv_item_t *items, uint8_t count);
+bool nvmc_kv_delete(nvmc_kv_key_t key);
+void nvmc_kv_process(void);
+
+#endif /* _NVMC_KV_H */
@@ -18,12 +18,19 @@
 
 #endif /* BOARD_PCA10059 */
 
-#define NVMC_PAGE_PREAMBULE                 0x0FEEDBEEU
-#define NVMC_PAGE_PREAMBULE_SIZE            4
-#define NVMC_STUCT_SIZE                     (sizeof(hsv_params_t))
+/* The first NVMC_PAGES_CNT pages keep the whole configuration in settings log of @ref nvmc_kv.h,
+ * they are A/B banks: the active one is selected by its header and the other one receives live
+ * records on compaction. The page after them keeps journal of @ref state_journal.h */
+#define NVMC_JOURNAL_PAGE_ADDR              (NVMC_START_APP_DATA_ADDR + NVMC_PAGES_CNT * CODE_PAGE_SIZE)
 
+/* The page before app data area keeps dumps of @ref crash_dump.h. It's far above the end of
+ * application in linker script, but DFU doesn't keep it, so dumps are checked before use */
+#define NVMC_CRASH_PAGE_ADDR                (NVMC_START_APP_DATA_ADDR - CODE_PAGE_SIZE)
+
+void nvmc_init(void);
 hsv_params_t nvmc_find_last_record(void);
-void nvmc_write_new_record(hsv_params_t curr_params);
 void nvmc_erase_last_written_page(void);
+bool nvmc_page_erase_process(uint32_t page_addr);
+void nvmc_page_erase_cancel(uint32_t page_addr);
 
 #endif /* _NVMC_MODULE_H */
\ No newline at end of file
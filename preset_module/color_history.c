@@ -0,0 +1,181 @@
+#include "color_history.h"
+#include "app_state.h"
+#include "app_util_platform.h"
+#include "nrf_assert.h"
+#include <string.h>
+
+/**
+ * @brief Ring of colors set by user, the oldest one is overwritten when it's full.
+ *  Colors after the current one are undone and can be redone until a new color is set.
+ *  Ring is changed in RAM only and is written to flash together with the color on save.
+ */
+typedef struct color_history_s
+{
+  hsv_params_t hsv[COLOR_HISTORY_SIZE];
+  uint8_t first;                          /* position of the oldest color */
+  uint8_t count;                          /* colors in ring, including undone ones */
+  uint8_t current;                        /* index of the current color from the oldest one */
+} color_history_t;
+
+STATIC_ASSERT(sizeof(color_history_t) <= NVMC_KV_VALUE_MAX_SIZE);
+STATIC_ASSERT(COLOR_HISTORY_SIZE <= UINT8_MAX);
+
+static color_history_t history;
+
+static inline hsv_params_t* entry_get(uint8_t idx)
+{
+  return &history.hsv[(history.first + idx) % COLOR_HISTORY_SIZE];
+}
+
+static bool history_is_valid(const color_history_t *const saved)
+{
+  if (saved->first >= COLOR_HISTORY_SIZE || saved->count > COLOR_HISTORY_SIZE ||
+      (saved->count > 0 && saved->current >= saved->count))
+  {
+    return false;
+  }
+
+  for (uint8_t i = 0; i < saved->count; i++)
+  {
+    const hsv_params_t *const hsv = &saved->hsv[(saved->first + i) % COLOR_HISTORY_SIZE];
+
+    if (!validate_hsv_by_ptr((void*)hsv, sizeof(*hsv)))
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/**
+ * @brief Makes color the current one, undone colors are dropped. Must be called with store locked.
+ */
+static void entry_commit(hsv_params_t hsv)
+{
+  if (history.count > 0)
+  {
+    if (!memcmp(entry_get(history.current), &hsv, sizeof(hsv)))
+    {
+      return;
+    }
+
+    history.count = history.current + 1;
+  }
+
+  if (history.count == COLOR_HISTORY_SIZE)
+  {
+    history.first = (history.first + 1) % COLOR_HISTORY_SIZE;
+    history.count--;
+  }
+
+  *entry_get(history.count) = hsv;
+  history.current = history.count;
+  history.count++;
+}
+
+/**
+ * @brief Restores history saved with the last color. Broken history is dropped.
+ *
+ * @param hsv color at boot, it becomes the current one if it differs from the saved one
+ */
+void color_history_init(hsv_params_t hsv)
+{
+  const color_history_t *saved = nvmc_kv_get_ptr(NVMC_KV_KEY_COLOR_HISTORY, sizeof(color_history_t));
+
+  memset(&history, 0, sizeof(history));
+
+  if (saved != NULL && history_is_valid(saved))
+  {
+    history = *saved;
+  }
+
+  entry_commit(hsv);
+}
+
+/**
+ * @brief Adds color to history, nothing is added if it's equal to the current one.
+ *  Used after color was changed by the renderer, e.g. by button in color changing modes.
+ */
+void color_history_commit(hsv_params_t hsv)
+{
+  CRITICAL_REGION_ENTER();
+  entry_commit(hsv);
+  CRITICAL_REGION_EXIT();
+}
+
+/**
+ * @brief Sets the current color and adds it to history.
+ */
+void color_history_apply(hsv_params_t hsv)
+{
+  CRITICAL_REGION_ENTER();
+  app_state_hsv_set(hsv);
+  entry_commit(hsv);
+  CRITICAL_REGION_EXIT();
+}
+
+/**
+ * @brief Returns to the previous color. Color that was changed
+ *  by the renderer after the last commit is added first, so it can be redone.
+ *
+ * @param[out] hsv restored color
+ * @return false if there is nothing to undo
+ */
+bool color_history_undo(hsv_params_t *const hsv)
+{
+  bool ret = false;
+
+  CRITICAL_REGION_ENTER();
+
+  entry_commit(app_state_hsv_get());
+
+  if (history.current > 0)
+  {
+    history.current--;
+    *hsv = *entry_get(history.current);
+    app_state_hsv_set(*hsv);
+    ret = true;
+  }
+
+  CRITICAL_REGION_EXIT();
+
+  return ret;
+}
+
+/**
+ * @brief Sets again the color that was undone.
+ *
+ * @param[out] hsv restored color
+ * @return false if there is nothing to redo or color was changed after undo
+ */
+bool color_history_redo(hsv_params_t *const hsv)
+{
+  bool ret = false;
+
+  CRITICAL_REGION_ENTER();
+
+  entry_commit(app_state_hsv_get());
+
+  if (history.current + 1 < history.count)
+  {
+    history.current++;
+    *hsv = *entry_get(history.current);
+    app_state_hsv_set(*hsv);
+    ret = true;
+  }
+
+  CRITICAL_REGION_EXIT();
+
+  return ret;
+}
+
+/**
+ * @brief Record of the whole ring, it's saved in one batch with the current color
+ */
+nvmc_kv_item_t color_history_kv_item_get(void)
+{
+  const nvmc_kv_item_t item = {.key = NVMC_KV_KEY_COLOR_HISTORY, .value = &history, .size = sizeof(history)};
+
+  return item;
+}
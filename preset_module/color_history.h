@@ -0,0 +1,17 @@
+#ifndef _COLOR_HISTORY_H
+#define _COLOR_HISTORY_H
+
+#include "nrfx.h"
+#include "hsv_to_rgb.h"
+#include "nvmc_kv.h"
+
+#define COLOR_HISTORY_SIZE              16      /* colors kept for undo, including the current one */
+
+void color_history_init(hsv_params_t hsv);
+void color_history_commit(hsv_params_t hsv);
+void color_history_apply(hsv_params_t hsv);
+bool color_history_undo(hsv_params_t *const hsv);
+bool color_history_redo(hsv_params_t *const hsv);
+nvmc_kv_item_t color_history_kv_item_get(void);
+
+#endif /* _COLOR_HISTORY_H */
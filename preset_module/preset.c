@@ -0,0 +1,129 @@
+#include "preset.h"
+#include "nvmc_kv.h"
+#include "color_history.h"
+#include "nrf_assert.h"
+#include <string.h>
+
+/**
+ * @brief All slots are kept in one settings record, so saving
+ *  any number of changed slots costs one flash write.
+ */
+typedef struct presets_s
+{
+  hsv_params_t hsv[PRESET_SLOTS_COUNT];
+  uint32_t used_mask;                     /* bit of every not empty slot */
+} presets_t;
+
+STATIC_ASSERT(sizeof(presets_t) <= NVMC_KV_VALUE_MAX_SIZE);
+
+static presets_t presets;
+static uint8_t last_loaded_slot = PRESET_SLOTS_COUNT - 1;
+
+/**
+ * @brief Loads presets from flash, slots with invalid color are left empty
+ */
+void presets_init(void)
+{
+  const presets_t *saved = nvmc_kv_get_ptr(NVMC_KV_KEY_PRESETS, sizeof(presets_t));
+
+  memset(&presets, 0, sizeof(presets));
+
+  if (saved == NULL)
+  {
+    return;
+  }
+
+  for (uint8_t slot = 0; slot < PRESET_SLOTS_COUNT; slot++)
+  {
+    if ((saved->used_mask & (1UL << slot)) &&
+        validate_hsv_by_ptr((void*)&saved->hsv[slot], sizeof(saved->hsv[slot])))
+    {
+      presets.hsv[slot] = saved->hsv[slot];
+      presets.used_mask |= 1UL << slot;
+    }
+  }
+}
+
+/**
+ * @brief Stores color in RAM slot, it's written to flash by save command
+ *  with the other settings, see @ref presets_kv_item_get
+ */
+bool preset_set(uint8_t slot, hsv_params_t hsv)
+{
+  if (slot >= PRESET_SLOTS_COUNT || !validate_hsv_by_ptr(&hsv, sizeof(hsv)))
+  {
+    return false;
+  }
+
+  presets.hsv[slot] = hsv;
+  presets.used_mask |= 1UL << slot;
+
+  return true;
+}
+
+/**
+ * @return false if slot is empty
+ */
+bool preset_get(uint8_t slot, hsv_params_t *const hsv)
+{
+  if (slot >= PRESET_SLOTS_COUNT || !(presets.used_mask & (1UL << slot)))
+  {
+    return false;
+  }
+
+  *hsv = presets.hsv[slot];
+
+  return true;
+}
+
+/**
+ * @brief Makes preset the current color, renderer fades to it.
+ *
+ * @return false if slot is empty
+ */
+bool preset_load(uint8_t slot)
+{
+  hsv_params_t hsv;
+
+  if (!preset_get(slot, &hsv))
+  {
+    return false;
+  }
+
+  last_loaded_slot = slot;
+  color_history_apply(hsv);
+
+  return true;
+}
+
+/**
+ * @brief Loads the next not empty slot after the last loaded one.
+ *
+ * @return loaded slot or PRESET_SLOTS_COUNT if all slots are empty
+ */
+uint8_t preset_load_next(void)
+{
+  uint8_t slot = last_loaded_slot;
+
+  for (uint8_t i = 0; i < PRESET_SLOTS_COUNT; i++)
+  {
+    slot = (slot + 1) % PRESET_SLOTS_COUNT;
+
+    if (preset_load(slot))
+    {
+      return slot;
+    }
+  }
+
+  return PRESET_SLOTS_COUNT;
+}
+
+/**
+ * @brief Record of all slots, it's saved in one batch with the rest of settings
+ */
+nvmc_kv_item_t presets_kv_item_get(void)
+{
+  const nvmc_kv_item_t item = {.key = NVMC_KV_KEY_PRESETS, .value = &presets, .size = sizeof(presets)};
+
+  return item;
+}
@@ -0,0 +1,17 @@
+#ifndef _PRESET_H
+#define _PRESET_H
+
+#include "nrfx.h"
+#include "hsv_to_rgb.h"
+#include "nvmc_kv.h"
+
+#define PRESET_SLOTS_COUNT              5       /* "preset list" of all slots fits into one CLI line */
+
+void presets_init(void);
+bool preset_set(uint8_t slot, hsv_params_t hsv);
+bool preset_get(uint8_t slot, hsv_params_t *const hsv);
+bool preset_load(uint8_t slot);
+uint8_t preset_load_next(void);
+nvmc_kv_item_t presets_kv_item_get(void);
+
+#endif /* _PRESET_H */
@@ -9,9 +9,14 @@
 
 /* defines common for all boards */
 #define PWM_RGB_TOP_VALUE                     255
-#define PWM_RGB_CYCLES_FOR_ONE_STEP           100
-#define PWM_INDICATOR_TOP_VALUE               1024
+#define PWM_RGB_CYCLES_FOR_ONE_STEP           10
+#define PWM_RGB_FRAMES_CNT                    4       /* frames in one buffer, rendered at once */
+#define PWM_INDICATOR_RGB_PERIODS_RATIO       4       /* indicator period is exactly this count of RGB periods */
+#define PWM_INDICATOR_TOP_VALUE               (PWM_RGB_TOP_VALUE * PWM_INDICATOR_RGB_PERIODS_RATIO)
 #define PWM_INDICATOR_CYCLES_FOR_ONE_STEP     2
+/* indicator frames that are played in the same time as one RGB buffer */
+#define PWM_INDICATOR_FRAMES_CNT              (PWM_RGB_FRAMES_CNT * PWM_RGB_CYCLES_FOR_ONE_STEP / \
+                                               (PWM_INDICATOR_RGB_PERIODS_RATIO * PWM_INDICATOR_CYCLES_FOR_ONE_STEP))
 
 /* I think that we can add another board after that if needed */
 #ifdef BOARD_PCA10059
@@ -46,6 +51,7 @@
 #undef NRFX_PWM_DEFAULT_CONFIG_BASE_CLOCK
 #define NRFX_PWM_DEFAULT_CONFIG_BASE_CLOCK     NRF_PWM_CLK_250kHz
 #endif /* NRFX_PWM_DEFAULT_CONFIG_BASE_CLOCK */
+#define PWM_BASE_CLOCK_FREQ_HZ                 250000U     /* MUST match NRFX_PWM_DEFAULT_CONFIG_BASE_CLOCK */
 
 #ifdef NRFX_PWM_DEFAULT_CONFIG_COUNT_MODE
 #undef NRFX_PWM_DEFAULT_CONFIG_COUNT_MODE
@@ -69,6 +75,10 @@
 
 #endif /* BOARD_PCA10059 */
 
+/* time of one RGB frame, it's one tick of color animation */
+#define PWM_RGB_STEP_PERIOD_US                ((uint32_t)PWM_RGB_TOP_VALUE * PWM_RGB_CYCLES_FOR_ONE_STEP * \
+                                               (1000000U / PWM_BASE_CLOCK_FREQ_HZ))
+
 /**
  * @brief macro for sequence config definition
  * @param seq_values uint16_t array with @ref NRF_PWM_CHANNEL_COUNT size
@@ -83,3 +93,16 @@
     .repeats             = 0,                                          \
     .end_delay           = 0                                           \
 }
+
+/**
+ * @brief macro for sequence config of frames array definition
+ * @param frames nrf_pwm_values_individual_t array
+ * @param periods_per_frame how many PWM periods every frame is played
+ */
+#define PWM_INDIVIDUAL_SEQ_FRAMES_CONFIG(frames, periods_per_frame)    \
+{                                                                      \
+    .values.p_individual = (frames),                                   \
+    .length              = NRFX_ARRAY_SIZE(frames) * NRF_PWM_CHANNEL_COUNT,\
+    .repeats             = (periods_per_frame) - 1,                    \
+    .end_delay           = 0                                           \
+}
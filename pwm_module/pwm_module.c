@@ -1,87 +1,292 @@
 #include "pwm_module.h"
+#include <string.h>
 #include "tutor_bsp.h"
 #include "nrf_assert.h"
-#include "nrf_drv_systick.h"
 #include "nrf_log.h"
 #include "nrf_log_ctrl.h"
+#include "nrfx_ppi.h"
+#include "nrf_egu.h"
 #include "hsv_to_rgb.h"
 #include "pwm_config.h"
 #include "g_context.h"
+#include "effect.h"
+#include "color_calib.h"
+#include "color_transition.h"
+#include "color_compositor.h"
 
 /*pwm config */
 static g_pwm_config_t pwm_rgb_config;
 static g_pwm_config_t pwm_indicator_config;
 static uint16_t pwm_indicator_period = 0;
 
+/* RGB pwm plays both buffers one by one, each frame is PWM_RGB_CYCLES_FOR_ONE_STEP periods
+ * and every period has its own value for dithering.
+ * Buffer is rendered only when EasyDMA has finished it and plays the other one. */
+static pwm_rgb_buffer_t pwm_rgb_buffers[PWM_RGB_BUFFERS_CNT];
 
-void pwm_process_one_period(uint8_t led_idx, uint8_t duty_cycle)
+/* Indicator pwm is started together with RGB one and has the same buffer duration,
+ * so its buffers are refilled from RGB handler and indicator pwm has no interrupts at all. */
+static pwm_indicator_buffer_t pwm_indicator_buffers[PWM_RGB_BUFFERS_CNT];
+
+STATIC_ASSERT(PWM_INDICATOR_FRAMES_CNT * PWM_INDICATOR_CYCLES_FOR_ONE_STEP * PWM_INDICATOR_RGB_PERIODS_RATIO ==
+              PWM_RGB_FRAMES_CNT * PWM_RGB_CYCLES_FOR_ONE_STEP);
+
+STATIC_ASSERT(NRFX_ARRAY_SIZE(step_list) == MODES_COUNT);
+
+/* EGU event is used only as software trigger of PPI */
+#define PWM_SYNC_EGU                      NRF_EGU3
+
+static effect_player_t effect_player;
+static uint32_t effect_player_version;
+
+
+static bool rgb16_is_equal(rgb16_params_t a, rgb16_params_t b)
 {
-  ASSERT(led_idx < LEDS_NUMBER);
-  ASSERT(duty_cycle <= 100U);
+  return a.red == b.red && a.green == b.green && a.blue == b.blue;
+}
 
-  led_toggle(led_idx);
-  nrfx_systick_delay_us(PWM_PERCENT_TIME_US * duty_cycle);
+static rgb16_params_t rgb16_by_rgb(rgb_params_t rgb)
+{
+  return (rgb16_params_t)
+  {
+    .red = rgb.red << RGB16_FRACTION_BITS,
+    .green = rgb.green << RGB16_FRACTION_BITS,
+    .blue = rgb.blue << RGB16_FRACTION_BITS
+  };
+}
 
-  led_toggle(led_idx);
-  nrfx_systick_delay_us(PWM_PERCENT_TIME_US * (100 - duty_cycle));
+/**
+ * @brief First order sigma-delta: returns integer duty and keeps
+ *  the fractional part in error accumulator for the next period.
+ */
+static inline uint16_t dither_channel(uint16_t value, uint16_t *const error)
+{
+  *error += value & RGB16_FRACTION_MASK;
+  value = (value >> RGB16_FRACTION_BITS) + (*error >> RGB16_FRACTION_BITS);
+  *error &= RGB16_FRACTION_MASK;
+
+  return value;
 }
 
+/**
+ * @brief Calibrates rendered colors and expands them into PWM periods of buffer.
+ *  Fractional part is spread over periods by dithering, so
+ *  effective resolution is more than PWM_RGB_TOP_VALUE steps.
+ *  Frames that already contain the same not dithered color aren't written.
+ */
+static void rgb_buffer_fill(pwm_rgb_buffer_t *const buffer, rgb16_params_t *const rgb)
+{
+  static uint16_t dither_error[3];
+  nrf_pwm_values_individual_t *values = buffer->values;
+  bool is_uniform = true;
 
-static void rgb_pwm_handler(nrfx_pwm_evt_type_t event_type)
+  color_calib_apply(rgb, PWM_RGB_FRAMES_CNT);
+
+  for (uint8_t i = 0; i < PWM_RGB_FRAMES_CNT; i++)
+  {
+    is_uniform &= rgb16_is_equal(rgb[0], rgb[i]) &&
+                  !((rgb[i].red | rgb[i].green | rgb[i].blue) & RGB16_FRACTION_MASK);
+
+    if (buffer->is_uniform && rgb16_is_equal(buffer->uniform_rgb, rgb[i]))
+    {
+      values += PWM_RGB_CYCLES_FOR_ONE_STEP;
+      continue;
+    }
+
+    for (uint8_t period = 0; period < PWM_RGB_CYCLES_FOR_ONE_STEP; period++, values++)
+    {
+      values->channel_0 = 0;
+      values->channel_1 = dither_channel(rgb[i].red, &dither_error[0]);
+      values->channel_2 = dither_channel(rgb[i].green, &dither_error[1]);
+      values->channel_3 = dither_channel(rgb[i].blue, &dither_error[2]);
+    }
+  }
+
+  buffer->is_uniform = is_uniform;
+  buffer->uniform_rgb = rgb[0];
+}
+
+/**
+ * @brief Renders next PWM_RGB_FRAMES_CNT frames of color changing mode.
+ *
+ * @param ticks animation ticks per frame, 0 to keep current color
+ */
+static void render_color_frames(rgb16_params_t *const rgb16, color_changing_mode_t mode, uint16_t ticks)
 {
+  static hsv_params_t rendered_hsv;
+  static bool is_rendered = false;
   rgb_params_t rgb;
+  hsv_params_t hsv = app_state_hsv_get();
+  hsv_params_t prev_hsv = hsv;
+  bool is_changed = false;
 
-  if (event_type == NRFX_PWM_EVT_FINISHED)
+  /* Color was set outside, e.g. by CLI, fade to it from what is shown now */
+  if (is_rendered && memcmp(&hsv, &rendered_hsv, sizeof(hsv)) != 0)
   {
-    if (g_app_data.flags.app_is_running)
-    {
-      rgb = color_changing_machine(&g_app_data.current_hsv, COLOR_CHANGE_STEP, g_app_data.current_led_mode);
+    color_transition_start();
+  }
 
-      pwm_rgb_config.sequence_values.channel_1 = rgb.red;
-      pwm_rgb_config.sequence_values.channel_2 = rgb.green;
-      pwm_rgb_config.sequence_values.channel_3 = rgb.blue;
+  for (uint8_t i = 0; i < PWM_RGB_FRAMES_CNT; i++)
+  {
+    is_changed |= color_changing_machine(&hsv, ticks, mode, &rgb);
+    rgb16[i] = color_transition_process(&hsv, rgb16_by_rgb(rgb));
+  }
 
-      NRF_LOG_INFO("Current values:");
-      NRF_LOG_INFO("h: %d, s: %d, v: %d", g_app_data.current_hsv.hue,
-                                      g_app_data.current_hsv.saturation,
-                                      g_app_data.current_hsv.brightness);
-    }
+  rendered_hsv = hsv;
+  is_rendered = true;
+
+  /* Color was changed by somebody else meanwhile, it wins on the next buffer */
+  if (app_state_hsv_cmp_exch(&prev_hsv, hsv) && is_changed && ticks > 0)
+  {
+    NRF_LOG_INFO("Current values:");
+    NRF_LOG_INFO("h: %d, s: %d, v: %d", hsv.hue, hsv.saturation, hsv.brightness);
+  }
+}
+
+/**
+ * @brief Renders next PWM_RGB_FRAMES_CNT frames of effect.
+ *  Effect is restarted from current color if it was changed.
+ */
+static void render_effect_frames(rgb16_params_t *const rgb16, uint8_t effect_idx)
+{
+  const effect_t *effect = effects_get(effect_idx);
+  rgb_params_t rgb;
+  hsv_params_t hsv;
+
+  /* Effect was removed */
+  if (effect == NULL)
+  {
+    render_color_frames(rgb16, NO_CHANGE, 0);
+    return;
+  }
+
+  if (effect_player.effect != effect || effect_player_version != effects_version())
+  {
+    hsv = app_state_hsv_get();
+    hsv_to_rgb(&hsv, &rgb);
+
+    effect_player_version = effects_version();
+    effect_player_start(&effect_player, effect, rgb);
+  }
+
+  for (uint8_t i = 0; i < PWM_RGB_FRAMES_CNT; i++)
+  {
+    rgb16[i] = effect_player_next_frame(&effect_player);
   }
 }
 
-static void indicator_pwm_handler(nrfx_pwm_evt_type_t event_type)
+/**
+ * @brief Renders the next content of buffer: base frames depending on current mode
+ *  and overlays of compositor above them. Called only for buffer that isn't played now.
+ */
+static void render_rgb_buffer(pwm_rgb_buffer_t *const buffer)
 {
-  if (event_type == NRFX_PWM_EVT_FINISHED)
+  rgb16_params_t rgb16[PWM_RGB_FRAMES_CNT];
+  uint8_t mode = app_state_led_mode_get();
+
+  if (mode >= MODES_COUNT)
+  {
+    /* Effects are always playing */
+    render_effect_frames(rgb16, mode - MODES_COUNT);
+  }
+  else
+  {
+    /* Player should restart when effect is selected next time */
+    effect_player.effect = NULL;
+
+    /* Not running mode still picks up color that was set outside */
+    render_color_frames(rgb16, mode, app_state_flag_get(APP_FLAG_APP_IS_RUNNING) ? 1 : 0);
+  }
+
+  color_compositor_process(rgb16, PWM_RGB_FRAMES_CNT);
+  rgb_buffer_fill(buffer, rgb16);
+}
+
+/**
+ * @brief Renders the next PWM_INDICATOR_FRAMES_CNT frames of indicator LED.
+ */
+static void render_indicator_buffer(pwm_indicator_buffer_t *const buffer)
+{
+  const uint8_t mode = app_state_led_mode_get();
+  const uint16_t step = mode < MODES_COUNT ? step_list[mode] : EFFECT_MODE_INDICATOR_STEP;
+
+  for (uint8_t i = 0; i < PWM_INDICATOR_FRAMES_CNT; i++)
   {
     /* LED is always on */
-    if (step_list[g_app_data.current_led_mode] >= PWM_INDICATOR_TOP_VALUE)
+    if (step >= PWM_INDICATOR_TOP_VALUE)
     {
-      pwm_indicator_config.sequence_values.channel_0 = PWM_INDICATOR_TOP_VALUE;
+      buffer->values[i].channel_0 = PWM_INDICATOR_TOP_VALUE;
+      continue;
     }
-    else
+
+    /* handle overflow */
+    if (pwm_indicator_period >= 2U * PWM_INDICATOR_TOP_VALUE)
     {
-      /* handle overflow */
-      if (pwm_indicator_period >= 2U * PWM_INDICATOR_TOP_VALUE)
-      {
-        pwm_indicator_period = 0;
-      }
+      pwm_indicator_period = 0;
+    }
 
-      pwm_indicator_config.sequence_values.channel_0 = pwm_indicator_period > PWM_INDICATOR_TOP_VALUE
-                                                    ? 2U * PWM_INDICATOR_TOP_VALUE - pwm_indicator_period
-                                                    : pwm_indicator_period;
+    buffer->values[i].channel_0 = pwm_indicator_period > PWM_INDICATOR_TOP_VALUE
+                                ? 2U * PWM_INDICATOR_TOP_VALUE - pwm_indicator_period
+                                : pwm_indicator_period;
 
-      pwm_indicator_period += step_list[g_app_data.current_led_mode];
-    }
+    pwm_indicator_period += step;
+  }
+}
+
+static void rgb_pwm_handler(nrfx_pwm_evt_type_t event_type)
+{
+  /* Sequence has finished and the other one is playing, so it's safe to refill it.
+   * Indicator pwm has switched its sequence at the same moment. */
+  if (event_type == NRFX_PWM_EVT_END_SEQ0)
+  {
+    render_rgb_buffer(&pwm_rgb_buffers[0]);
+    render_indicator_buffer(&pwm_indicator_buffers[0]);
+  }
+  else if (event_type == NRFX_PWM_EVT_END_SEQ1)
+  {
+    render_rgb_buffer(&pwm_rgb_buffers[1]);
+    render_indicator_buffer(&pwm_indicator_buffers[1]);
   }
 }
 
-void update_leds(void)
+/**
+ * @brief Starts both pwm instances by one PPI channel, so they are phase-locked.
+ *  Channel is freed only when both sequences are started: tasks are delivered
+ *  by PPI some cycles after the trigger.
+ *
+ * @param rgb_task SEQSTART task address of RGB pwm
+ * @param indicator_task SEQSTART task address of indicator pwm
+ */
+static void pwm_synchronized_start(uint32_t rgb_task, uint32_t indicator_task)
 {
-  rgb_params_t rgb = color_changing_machine(&g_app_data.current_hsv, 0, g_app_data.current_led_mode);
+  NRF_PWM_Type *const rgb_pwm = pwm_rgb_config.instance.p_registers;
+  NRF_PWM_Type *const indicator_pwm = pwm_indicator_config.instance.p_registers;
+  nrf_ppi_channel_t channel;
+  const uint32_t trigger_event = (uint32_t)nrf_egu_event_address_get(PWM_SYNC_EGU, NRF_EGU_EVENT_TRIGGERED0);
 
-  pwm_rgb_config.sequence_values.channel_1 = rgb.red;
-  pwm_rgb_config.sequence_values.channel_2 = rgb.green;
-  pwm_rgb_config.sequence_values.channel_3 = rgb.blue;
+  nrf_egu_event_clear(PWM_SYNC_EGU, NRF_EGU_EVENT_TRIGGERED0);
+  nrf_pwm_event_clear(rgb_pwm, NRF_PWM_EVENT_SEQSTARTED0);
+  nrf_pwm_event_clear(indicator_pwm, NRF_PWM_EVENT_SEQSTARTED0);
+
+  APP_ERROR_CHECK(nrfx_ppi_channel_alloc(&channel));
+  APP_ERROR_CHECK(nrfx_ppi_channel_assign(channel, trigger_event, rgb_task));
+  APP_ERROR_CHECK(nrfx_ppi_channel_fork_assign(channel, indicator_task));
+  APP_ERROR_CHECK(nrfx_ppi_channel_enable(channel));
+
+  nrf_egu_task_trigger(PWM_SYNC_EGU, NRF_EGU_TASK_TRIGGER0);
+
+  while (!nrf_egu_event_check(PWM_SYNC_EGU, NRF_EGU_EVENT_TRIGGERED0)
+         || !nrf_pwm_event_check(rgb_pwm, NRF_PWM_EVENT_SEQSTARTED0)
+         || !nrf_pwm_event_check(indicator_pwm, NRF_PWM_EVENT_SEQSTARTED0))
+  {
+  }
+
+  /* Loops are restarted by shorts, channel is needed only once */
+  APP_ERROR_CHECK(nrfx_ppi_channel_disable(channel));
+  APP_ERROR_CHECK(nrfx_ppi_channel_free(channel));
+  nrf_egu_event_clear(PWM_SYNC_EGU, NRF_EGU_EVENT_TRIGGERED0);
+  nrf_pwm_event_clear(rgb_pwm, NRF_PWM_EVENT_SEQSTARTED0);
+  nrf_pwm_event_clear(indicator_pwm, NRF_PWM_EVENT_SEQSTARTED0);
 }
 
 void reset_indicator_led(void)
@@ -93,12 +298,12 @@ void init_pwm(void)
 {
   /* Indicator pwm init start */
   uint8_t i = 0;
-  rgb_params_t rgb;
+  rgb16_params_t rgb16[PWM_RGB_FRAMES_CNT];
+  uint32_t rgb_start_task;
+  uint32_t indicator_start_task;
 
   pwm_indicator_config.config = (nrfx_pwm_config_t)NRFX_PWM_DEFAULT_CONFIG;
   pwm_indicator_config.instance = (nrfx_pwm_t)NRFX_PWM_INSTANCE(1);
-  pwm_indicator_config.sequence = (nrf_pwm_sequence_t)PWM_INDIVIDUAL_SEQ_DEFAULT_CONFIG(
-                                  pwm_indicator_config.sequence_values);
 
   pwm_indicator_config.config.output_pins[i++] = LED_1;
   pwm_indicator_config.config.output_pins[i++] = NRFX_PWM_PIN_NOT_USED;
@@ -106,49 +311,59 @@ void init_pwm(void)
   pwm_indicator_config.config.output_pins[i++] = NRFX_PWM_PIN_NOT_USED;
   pwm_indicator_config.config.top_value = PWM_INDICATOR_TOP_VALUE;
 
-  pwm_indicator_config.sequence_values.channel_0 = 0;
-  pwm_indicator_config.sequence_values.channel_1 = 0;
-  pwm_indicator_config.sequence_values.channel_2 = 0;
-  pwm_indicator_config.sequence_values.channel_3 = 0;
+  for (i = 0; i < PWM_RGB_BUFFERS_CNT; i++)
+  {
+    pwm_indicator_buffers[i].sequence = (nrf_pwm_sequence_t)PWM_INDIVIDUAL_SEQ_FRAMES_CONFIG(
+          pwm_indicator_buffers[i].values, PWM_INDICATOR_CYCLES_FOR_ONE_STEP);
+    render_indicator_buffer(&pwm_indicator_buffers[i]);
+  }
 
+  /* No handler: buffers are refilled by RGB pwm events */
   APP_ERROR_CHECK(nrfx_pwm_init(&pwm_indicator_config.instance,
-          &pwm_indicator_config.config, indicator_pwm_handler));
+          &pwm_indicator_config.config, NULL));
   NRF_LOG_INFO("Indicator PWM Initiated");
   /* Indicator pwm init end */
 
   /* RGB pwm init start */
   pwm_rgb_config.config = (nrfx_pwm_config_t)NRFX_PWM_DEFAULT_CONFIG;
   pwm_rgb_config.instance = (nrfx_pwm_t)NRFX_PWM_INSTANCE(0);
-  pwm_rgb_config.sequence = (nrf_pwm_sequence_t)PWM_INDIVIDUAL_SEQ_DEFAULT_CONFIG(
-        pwm_rgb_config.sequence_values);
-
   pwm_rgb_config.config.output_pins[0] = NRFX_PWM_PIN_NOT_USED;
 
-  memcpy(&pwm_rgb_config.sequence_values,
-  &pwm_indicator_config.sequence_values,
-                sizeof(nrf_pwm_values_individual_t));
-
-  rgb = color_changing_machine(&g_app_data.current_hsv, 0, 0);
-
-  pwm_rgb_config.sequence_values.channel_1 = rgb.red;
-  pwm_rgb_config.sequence_values.channel_2 = rgb.green;
-  pwm_rgb_config.sequence_values.channel_3 = rgb.blue;
+  color_anim_init(PWM_RGB_STEP_PERIOD_US);
+  color_transition_init(PWM_RGB_STEP_PERIOD_US);
+  color_compositor_init(PWM_RGB_STEP_PERIOD_US);
 
+  for (i = 0; i < PWM_RGB_BUFFERS_CNT; i++)
+  {
+    pwm_rgb_buffers[i].sequence = (nrf_pwm_sequence_t)PWM_INDIVIDUAL_SEQ_FRAMES_CONFIG(
+          pwm_rgb_buffers[i].values, 1);
+    pwm_rgb_buffers[i].is_uniform = false;
+    render_color_frames(rgb16, NO_CHANGE, 0);
+    rgb_buffer_fill(&pwm_rgb_buffers[i], rgb16);
+  }
 
   APP_ERROR_CHECK(nrfx_pwm_init(&pwm_rgb_config.instance,
                 &pwm_rgb_config.config, rgb_pwm_handler));
 
+  /* Ping-pong: each buffer is refilled while the other one is played.
+   * Both instances are only prepared here and started by one PPI channel. */
+  rgb_start_task = nrfx_pwm_complex_playback(&pwm_rgb_config.instance,
+                            &pwm_rgb_buffers[0].sequence,
+                            &pwm_rgb_buffers[1].sequence,
+                            1, NRFX_PWM_FLAG_LOOP | NRFX_PWM_FLAG_SIGNAL_END_SEQ0 |
+                            NRFX_PWM_FLAG_SIGNAL_END_SEQ1 | NRFX_PWM_FLAG_NO_EVT_FINISHED |
+                            NRFX_PWM_FLAG_START_VIA_TASK);
 
-  nrfx_pwm_simple_playback(&pwm_rgb_config.instance,
-                            &pwm_rgb_config.sequence,
-                            PWM_RGB_CYCLES_FOR_ONE_STEP, NRFX_PWM_FLAG_LOOP);
+  indicator_start_task = nrfx_pwm_complex_playback(&pwm_indicator_config.instance,
+                            &pwm_indicator_buffers[0].sequence,
+                            &pwm_indicator_buffers[1].sequence,
+                            1, NRFX_PWM_FLAG_LOOP | NRFX_PWM_FLAG_NO_EVT_FINISHED |
+                            NRFX_PWM_FLAG_START_VIA_TASK);
 
-  nrfx_pwm_simple_playback(&pwm_indicator_config.instance,
-                            &pwm_indicator_config.sequence,
-                            PWM_INDICATOR_CYCLES_FOR_ONE_STEP, NRFX_PWM_FLAG_LOOP);
+  pwm_synchronized_start(rgb_start_task, indicator_start_task);
 
   NRF_LOG_INFO("LED PWM Initiated");
   /* RGB pwm init end */
 
   NRF_LOG_FLUSH();
-}
\ No newline at end of file
+}
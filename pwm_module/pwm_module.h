@@ -1,19 +1,31 @@
 #ifndef __PWM_MODULE_H
 #define __PWM_MODULE_H
 
-#ifndef PWM_PERCENT_TIME_US
-#define PWM_PERCENT_TIME_US       10U
-#endif
+#include "nrfx_pwm.h"
+#include "hsv_to_rgb.h"
+#include "pwm_config.h"
+
+#define PWM_RGB_BUFFERS_CNT       2
+
+typedef struct pwm_rgb_buffer_s
+{
+  nrf_pwm_values_individual_t values[PWM_RGB_FRAMES_CNT * PWM_RGB_CYCLES_FOR_ONE_STEP]; /* one value per period */
+  nrf_pwm_sequence_t sequence;
+  rgb16_params_t uniform_rgb;   /* color of every frame if is_uniform */
+  bool is_uniform;
+} pwm_rgb_buffer_t;
+
+typedef struct pwm_indicator_buffer_s
+{
+  nrf_pwm_values_individual_t values[PWM_INDICATOR_FRAMES_CNT];
+  nrf_pwm_sequence_t sequence;
+} pwm_indicator_buffer_t;
 
 #ifdef BOARD_PCA10059
 #include "pca10059.h"
 #endif /* BOARD_PCA10059 */
 
-#define COLOR_CHANGE_STEP 1
-
-void pwm_process_one_period(uint8_t led_idx, uint8_t duty_cycle);
 void init_pwm(void);
 void reset_indicator_led(void);
-void update_leds(void);
 
 #endif /* __PWM_MODULE_H */
\ No newline at end of file
@@ -0,0 +1,197 @@
+#include "soft_pwm.h"
+#include "nrfx_timer.h"
+#include "nrfx_ppi.h"
+#include "nrfx_gpiote.h"
+#include "nrf_assert.h"
+#include "app_error.h"
+
+/**
+ * Software PWM for pins that don't fit into PWM instances.
+ *  Timer is cleared by the period compare, which switches every pin on,
+ *  and the channel compare switches its pin off. Both edges are routed to
+ *  GPIOTE SET/CLR tasks by PPI, so CPU isn't used at all while playing.
+ */
+
+typedef struct soft_pwm_channel_s
+{
+  uint32_t pin;
+  nrf_ppi_channel_t ppi_on;
+  nrf_ppi_channel_t ppi_off;
+  uint8_t duty;
+  bool is_active_low;
+} soft_pwm_channel_t;
+
+#define SOFT_PWM_PERIOD_CC                  NRF_TIMER_CC_CHANNEL5
+
+static const nrfx_timer_t soft_pwm_timer = NRFX_TIMER_INSTANCE(SOFT_PWM_TIMER_INSTANCE_ID);
+static soft_pwm_channel_t soft_pwm_channels[SOFT_PWM_CHANNELS_CNT];
+static uint8_t soft_pwm_channels_cnt = 0;
+static uint32_t soft_pwm_period_ticks;
+
+/* Timer is used only as event source, no interrupts are enabled */
+static void soft_pwm_timer_handler(nrf_timer_event_t event_type, void *p_context)
+{
+}
+
+static uint32_t pin_on_task_get(const soft_pwm_channel_t *const ch)
+{
+  return ch->is_active_low ? nrfx_gpiote_clr_task_addr_get(ch->pin) : nrfx_gpiote_set_task_addr_get(ch->pin);
+}
+
+static uint32_t pin_off_task_get(const soft_pwm_channel_t *const ch)
+{
+  return ch->is_active_low ? nrfx_gpiote_set_task_addr_get(ch->pin) : nrfx_gpiote_clr_task_addr_get(ch->pin);
+}
+
+static void pin_write(const soft_pwm_channel_t *const ch, bool is_on)
+{
+  if (is_on != ch->is_active_low)
+  {
+    nrfx_gpiote_set_task_trigger(ch->pin);
+  }
+  else
+  {
+    nrfx_gpiote_clr_task_trigger(ch->pin);
+  }
+}
+
+/**
+ * @brief Applies duty of channel to hardware.
+ *  0 and SOFT_PWM_DUTY_MAX have no edges, so PPI is disabled and pin is static.
+ *  If compare is moved below current timer value, it's missed and
+ *  pin is kept on for one period, there is no other glitches.
+ */
+static void soft_pwm_channel_apply(uint8_t idx)
+{
+  soft_pwm_channel_t *ch = &soft_pwm_channels[idx];
+
+  if (ch->duty == 0 || ch->duty >= SOFT_PWM_DUTY_MAX)
+  {
+    APP_ERROR_CHECK(nrfx_ppi_channel_disable(ch->ppi_on));
+    APP_ERROR_CHECK(nrfx_ppi_channel_disable(ch->ppi_off));
+    pin_write(ch, ch->duty != 0);
+    return;
+  }
+
+  nrfx_timer_compare(&soft_pwm_timer, (nrf_timer_cc_channel_t)idx,
+                     soft_pwm_period_ticks * ch->duty / SOFT_PWM_DUTY_MAX, false);
+  APP_ERROR_CHECK(nrfx_ppi_channel_enable(ch->ppi_on));
+  APP_ERROR_CHECK(nrfx_ppi_channel_enable(ch->ppi_off));
+}
+
+static void soft_pwm_period_set(uint32_t frequency_hz)
+{
+  ASSERT(frequency_hz > 0 && frequency_hz <= SOFT_PWM_MAX_FREQ_HZ);
+
+  soft_pwm_period_ticks = SOFT_PWM_TIMER_FREQ_HZ / frequency_hz;
+  nrfx_timer_extended_compare(&soft_pwm_timer, SOFT_PWM_PERIOD_CC, soft_pwm_period_ticks,
+                              NRF_TIMER_SHORT_COMPARE5_CLEAR_MASK, false);
+
+  for (uint8_t i = 0; i < soft_pwm_channels_cnt; i++)
+  {
+    soft_pwm_channel_apply(i);
+  }
+}
+
+/**
+ * @brief Inits timer of software PWM, channels are added by @ref soft_pwm_channel_add
+ *
+ * @param frequency_hz PWM frequency, not more than SOFT_PWM_MAX_FREQ_HZ
+ */
+void soft_pwm_init(uint32_t frequency_hz)
+{
+  nrfx_timer_config_t config = NRFX_TIMER_DEFAULT_CONFIG;
+
+  config.frequency = NRF_TIMER_FREQ_16MHz;
+  config.bit_width = NRF_TIMER_BIT_WIDTH_32;
+
+  if (!nrfx_gpiote_is_init())
+  {
+    APP_ERROR_CHECK(nrfx_gpiote_init());
+  }
+
+  APP_ERROR_CHECK(nrfx_timer_init(&soft_pwm_timer, &config, soft_pwm_timer_handler));
+  soft_pwm_period_set(frequency_hz);
+  nrfx_timer_enable(&soft_pwm_timer);
+}
+
+/**
+ * @brief Adds pin to software PWM, it starts with 0 duty
+ *
+ * @param[in] pin pin number
+ * @param[in] is_active_low pin is on when it's low
+ * @param[out] channel index of added channel
+ * @return false if there is no free timer compare, PPI or GPIOTE channel
+ */
+bool soft_pwm_channel_add(uint32_t pin, bool is_active_low, uint8_t *const channel)
+{
+  nrfx_gpiote_out_config_t out_config = NRFX_GPIOTE_CONFIG_OUT_TASK_TOGGLE(is_active_low);
+  soft_pwm_channel_t *ch;
+
+  if (soft_pwm_channels_cnt >= SOFT_PWM_CHANNELS_CNT)
+  {
+    return false;
+  }
+
+  ch = &soft_pwm_channels[soft_pwm_channels_cnt];
+
+  if (nrfx_gpiote_out_init(pin, &out_config) != NRFX_SUCCESS)
+  {
+    return false;
+  }
+
+  if (nrfx_ppi_channel_alloc(&ch->ppi_on) != NRFX_SUCCESS)
+  {
+    nrfx_gpiote_out_uninit(pin);
+    return false;
+  }
+
+  if (nrfx_ppi_channel_alloc(&ch->ppi_off) != NRFX_SUCCESS)
+  {
+    APP_ERROR_CHECK(nrfx_ppi_channel_free(ch->ppi_on));
+    nrfx_gpiote_out_uninit(pin);
+    return false;
+  }
+
+  ch->pin = pin;
+  ch->is_active_low = is_active_low;
+  ch->duty = 0;
+
+  APP_ERROR_CHECK(nrfx_ppi_channel_assign(ch->ppi_on,
+        nrfx_timer_compare_event_address_get(&soft_pwm_timer, SOFT_PWM_PERIOD_CC), pin_on_task_get(ch)));
+  APP_ERROR_CHECK(nrfx_ppi_channel_assign(ch->ppi_off,
+        nrfx_timer_compare_event_address_get(&soft_pwm_timer, soft_pwm_channels_cnt), pin_off_task_get(ch)));
+  nrfx_gpiote_out_task_enable(pin);
+
+  *channel = soft_pwm_channels_cnt++;
+  soft_pwm_channel_apply(*channel);
+
+  return true;
+}
+
+/**
+ * @brief Sets duty of channel, takes effect from the next period
+ *
+ * @param channel channel returned by @ref soft_pwm_channel_add
+ * @param duty duty cycle in [0; SOFT_PWM_DUTY_MAX] range
+ */
+void soft_pwm_duty_set(uint8_t channel, uint8_t duty)
+{
+  ASSERT(channel < soft_pwm_channels_cnt);
+  ASSERT(duty <= SOFT_PWM_DUTY_MAX);
+
+  soft_pwm_channels[channel].duty = duty;
+  soft_pwm_channel_apply(channel);
+}
+
+/**
+ * @brief Changes PWM frequency of every channel, duties are kept.
+ *  Timer is paused and restarted, so new period can't be missed.
+ */
+void soft_pwm_frequency_set(uint32_t frequency_hz)
+{
+  nrfx_timer_pause(&soft_pwm_timer);
+  soft_pwm_period_set(frequency_hz);
+  nrfx_timer_clear(&soft_pwm_timer);
+  nrfx_timer_resume(&soft_pwm_timer);
+}
@@ -0,0 +1,19 @@
+#ifndef _SOFT_PWM_H
+#define _SOFT_PWM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* TIMER3 has 6 CC registers: one per channel and the last one for period */
+#define SOFT_PWM_TIMER_INSTANCE_ID          3
+#define SOFT_PWM_CHANNELS_CNT               5
+#define SOFT_PWM_DUTY_MAX                   100U
+#define SOFT_PWM_TIMER_FREQ_HZ              16000000U
+#define SOFT_PWM_MAX_FREQ_HZ                (SOFT_PWM_TIMER_FREQ_HZ / SOFT_PWM_DUTY_MAX)
+
+void soft_pwm_init(uint32_t frequency_hz);
+bool soft_pwm_channel_add(uint32_t pin, bool is_active_low, uint8_t *const channel);
+void soft_pwm_duty_set(uint8_t channel, uint8_t duty);
+void soft_pwm_frequency_set(uint32_t frequency_hz);
+
+#endif /* _SOFT_PWM_H */
@@ -0,0 +1,146 @@
+#include "app_state.h"
+#include "nrf_assert.h"
+
+/* hsv_params_t is published as one aligned word, so a reader can't see a torn triple */
+STATIC_ASSERT(sizeof(hsv_params_t) == sizeof(uint32_t));
+
+typedef union hsv_word_u
+{
+  hsv_params_t hsv;
+  uint32_t word;
+} hsv_word_t;
+
+/**
+ * @brief Everything that is shared between ISRs and thread mode.
+ *  Each field is a separate word which is only accessed with
+ *  single-copy atomic loads or nrf_atomic operations.
+ */
+typedef struct app_state_s
+{
+  nrf_atomic_u32_t flags;     /* @ref app_flag_t bitmask */
+  nrf_atomic_u32_t hsv;       /* @ref hsv_word_t */
+  nrf_atomic_u32_t led_mode;  /* @ref color_changing_mode_t or MODES_COUNT + effect index */
+} app_state_t;
+
+static app_state_t app_state;
+
+void app_state_init(hsv_params_t hsv)
+{
+  hsv_word_t value = { .hsv = hsv };
+
+  nrf_atomic_u32_store(&app_state.flags, 0);
+  nrf_atomic_u32_store(&app_state.hsv, value.word);
+  nrf_atomic_u32_store(&app_state.led_mode, NO_CHANGE);
+}
+
+bool app_state_flag_get(app_flag_t flag)
+{
+  return (app_state.flags & flag) != 0;
+}
+
+void app_state_flag_set(app_flag_t flag)
+{
+  nrf_atomic_u32_or(&app_state.flags, flag);
+}
+
+void app_state_flag_clear(app_flag_t flag)
+{
+  nrf_atomic_u32_and(&app_state.flags, ~(uint32_t)flag);
+}
+
+void app_state_flag_write(app_flag_t flag, bool value)
+{
+  if (value)
+  {
+    app_state_flag_set(flag);
+  }
+  else
+  {
+    app_state_flag_clear(flag);
+  }
+}
+
+/**
+ * @brief Toggles flag in one atomic operation.
+ *
+ * @return new flag value
+ */
+bool app_state_flag_toggle(app_flag_t flag)
+{
+  return (nrf_atomic_u32_xor(&app_state.flags, flag) & flag) != 0;
+}
+
+/**
+ * @brief Returns all flags of @ref app_flag_t at once
+ */
+uint32_t app_state_flags_get(void)
+{
+  return app_state.flags;
+}
+
+/**
+ * @brief Returns consistent snapshot of current color.
+ *  Safe to call from any ISR.
+ */
+hsv_params_t app_state_hsv_get(void)
+{
+  hsv_word_t value = { .word = app_state.hsv };
+  return value.hsv;
+}
+
+void app_state_hsv_set(hsv_params_t hsv)
+{
+  hsv_word_t value = { .hsv = hsv };
+  nrf_atomic_u32_store(&app_state.hsv, value.word);
+}
+
+/**
+ * @brief Publishes desired color only if current color is still equal to expected.
+ *  Used by read-modify-write users (e.g. color changing in PWM ISR)
+ *  so they never overwrite a color that was set by somebody else meanwhile.
+ *
+ * @param[in,out] expected color read before modification, updated with current color on failure
+ * @param[in] desired new color
+ * @return true if desired color was published, else false
+ */
+bool app_state_hsv_cmp_exch(hsv_params_t *const expected, hsv_params_t desired)
+{
+  hsv_word_t expected_value = { .hsv = *expected };
+  hsv_word_t desired_value = { .hsv = desired };
+  bool ret;
+
+  ret = nrf_atomic_u32_cmp_exch(&app_state.hsv, &expected_value.word, desired_value.word);
+  *expected = expected_value.hsv;
+
+  return ret;
+}
+
+uint8_t app_state_led_mode_get(void)
+{
+  return (uint8_t)app_state.led_mode;
+}
+
+void app_state_led_mode_set(uint8_t mode)
+{
+  nrf_atomic_u32_store(&app_state.led_mode, mode);
+}
+
+/**
+ * @brief Switches LED mode to the next one.
+ *
+ * @param modes_count count of modes that can be selected now
+ * @return new LED mode
+ */
+uint8_t app_state_led_mode_next(uint8_t modes_count)
+{
+  uint32_t mode = app_state.led_mode;
+
+  ASSERT(modes_count > 0);
+
+  while (!nrf_atomic_u32_cmp_exch(&app_state.led_mode, &mode, (mode + 1) % modes_count))
+  {
+    /* mode was reloaded by cmp_exch, try again */
+  }
+
+  return (mode + 1) % modes_count;
+}
@@ -0,0 +1,41 @@
+#ifndef _APP_STATE_H
+#define _APP_STATE_H
+
+#include "nrfx.h"
+#include "nrf_atomic.h"
+#include "hsv_to_rgb.h"
+
+/**
+ * @brief Application flags. Each flag is a single bit of one word,
+ *  so every flag operation is one atomic instruction sequence and
+ *  never races with another context changing a neighbour flag.
+ */
+typedef enum app_flag_e
+{
+  APP_FLAG_APP_IS_RUNNING     = (1U << 0), /* true if application should change value depending on mode, else false */
+  APP_FLAG_FST_CLICK_OCCURRED = (1U << 1), /* true if first click was occurred */
+  APP_FLAG_BTN_PRESSED        = (1U << 2), /* false if released, true if pressed now */
+  APP_FLAG_BTN_IS_DISABLED    = (1U << 3), /* true if btn won't do anything except @ref APP_FLAG_BTN_PRESSED changing */
+} app_flag_t;
+
+void app_state_init(hsv_params_t hsv);
+
+/* flags */
+bool app_state_flag_get(app_flag_t flag);
+void app_state_flag_set(app_flag_t flag);
+void app_state_flag_clear(app_flag_t flag);
+void app_state_flag_write(app_flag_t flag, bool value);
+bool app_state_flag_toggle(app_flag_t flag);
+uint32_t app_state_flags_get(void);
+
+/* current color */
+hsv_params_t app_state_hsv_get(void);
+void app_state_hsv_set(hsv_params_t hsv);
+bool app_state_hsv_cmp_exch(hsv_params_t *const expected, hsv_params_t desired);
+
+/* current LED mode */
+uint8_t app_state_led_mode_get(void);
+void app_state_led_mode_set(uint8_t mode);
+uint8_t app_state_led_mode_next(uint8_t modes_count);
+
+#endif /* _APP_STATE_H */
@@ -0,0 +1,82 @@
+#include "settings.h"
+#include "app_state.h"
+#include "effect.h"
+#include "color_calib.h"
+#include "preset.h"
+#include "color_history.h"
+#include "nvmc_kv.h"
+#include "nrf_atomic.h"
+#include "nrf_log.h"
+
+/* Color, led mode, presets, history, calibration and effects are one batch */
+#define SETTINGS_ITEMS_COUNT            (5 + EFFECT_SLOTS_COUNT)
+/* Color and history that has it as the newest entry */
+#define SETTINGS_COLOR_ITEMS_COUNT      2
+
+STATIC_ASSERT(SETTINGS_ITEMS_COUNT <= NVMC_KV_BATCH_MAX);
+
+static nrf_atomic_flag_t color_save_is_requested;
+
+/**
+ * @brief Writes the whole configuration in one batch, it's never restored half saved.
+ *  Compaction may erase page, so it's called from CLI, not from button handler.
+ *
+ * @return false if configuration isn't saved
+ */
+bool settings_save(void)
+{
+  const hsv_params_t hsv = app_state_hsv_get();
+  const uint8_t led_mode = app_state_led_mode_get();
+  nvmc_kv_item_t items[SETTINGS_ITEMS_COUNT];
+  uint8_t items_count = 0;
+
+  items[items_count++] = (nvmc_kv_item_t){.key = NVMC_KV_KEY_HSV, .value = &hsv, .size = sizeof(hsv)};
+  items[items_count++] = (nvmc_kv_item_t){.key = NVMC_KV_KEY_LED_MODE, .value = &led_mode, .size = sizeof(led_mode)};
+  items[items_count++] = presets_kv_item_get();
+  items[items_count++] = color_history_kv_item_get();
+  items[items_count++] = color_calib_kv_item_get();
+
+  for (uint8_t slot = 0; slot < EFFECT_SLOTS_COUNT; slot++)
+  {
+    items[items_count++] = effect_kv_item_get(slot);
+  }
+
+  return nvmc_kv_put_batch(items, items_count);
+}
+
+/**
+ * @brief Writes color with history in one batch, so undo after boot starts from it.
+ *  Calibration, effects and presets staged by CLI are kept until CLI saves them.
+ *
+ * @return false if color isn't saved
+ */
+static bool settings_color_save(void)
+{
+  const hsv_params_t hsv = app_state_hsv_get();
+  const nvmc_kv_item_t items[SETTINGS_COLOR_ITEMS_COUNT] =
+  {
+    {.key = NVMC_KV_KEY_HSV, .value = &hsv, .size = sizeof(hsv)},
+    color_history_kv_item_get(),
+  };
+
+  return nvmc_kv_put_batch(items, SETTINGS_COLOR_ITEMS_COUNT);
+}
+
+/**
+ * @brief Asks main loop to save color of button, safe to call from any ISR
+ */
+void settings_color_save_request(void)
+{
+  nrf_atomic_flag_set(&color_save_is_requested);
+}
+
+/**
+ * @brief Saves color if it was requested, call it from main loop
+ */
+void settings_process(void)
+{
+  if (nrf_atomic_flag_clear_fetch(&color_save_is_requested) && !settings_color_save())
+  {
+    NRF_LOG_WARNING("Requested color isn't saved");
+  }
+}
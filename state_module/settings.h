@@ -0,0 +1,10 @@
+#ifndef _SETTINGS_H
+#define _SETTINGS_H
+
+#include "nrfx.h"
+
+bool settings_save(void);
+void settings_color_save_request(void);
+void settings_process(void);
+
+#endif /* _SETTINGS_H */
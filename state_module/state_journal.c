@@ -0,0 +1,571 @@
+#include "state_journal.h"
+#include "app_state.h"
+#include "hsv_to_rgb.h"
+#include "nvmc_module.h"
+#include "nrfx_nvmc.h"
+#include "crc16.h"
+#include "app_timer.h"
+#include "app_util_platform.h"
+#include "nrf_assert.h"
+#include "nrf_log.h"
+#include <string.h>
+
+/**
+ * Journal of animation state on its own page. Entries are replayed one after another,
+ *  the tag is in bits 7..5 of the first byte of entry:
+ *  snapshot - 2 words: mode, directions and hsv, it starts the page and is written
+ *             again when mode or directions of other modes are changed
+ *  state    - 1 word: hsv and direction of the mode, when several fields are changed,
+ *             e.g. by hue sweep that moves in OKLCh
+ *  delta    - half word: difference of the field of the mode and its direction
+ *             against the previous entry, e.g. of brightness animation
+ *
+ * Every word can be written twice between erases, so two deltas share a word:
+ *  the first one is written with erased upper half, the second one writes the word
+ *  again with the first one kept. Word entries start at word boundary, half word
+ *  before them is left erased. Write interrupted by power loss may leave the word
+ *  erased, so the first word after boot isn't shared.
+ *
+ * Interrupted write and partial erase only leave bits at 1, so every entry keeps count
+ *  of its zero bits: missing zeros of data make it less, ones of the count make it
+ *  more, and any such damage is found. Tags have two zeros of three bits, so a damaged
+ *  tag isn't another valid one.
+ *
+ * There are no periodic snapshots. Page always starts with one, so replay is bounded
+ *  by the page, and nothing is appended after a broken entry, the page is erased first.
+ *  A snapshot every 64 entries would add 1.6 % of bytes to the hue sweep and 6.2 %
+ *  to brightness animation of bench_state_journal and restore nothing.
+ */
+#define JOURNAL_ERASED_WORD             0xFFFFFFFFU
+#define JOURNAL_ERASED_HALF             0xFFFFU
+#define JOURNAL_HALF_SIZE               sizeof(uint16_t)
+#define JOURNAL_SNAPSHOT_SIZE           8       /* header, hue, saturation, brightness, mode, directions, count */
+#define JOURNAL_TAG_POS                 5
+#define JOURNAL_TAG_MASK                0xE0
+#define JOURNAL_TAG_SNAPSHOT            (0x3 << JOURNAL_TAG_POS)
+#define JOURNAL_TAG_STATE               (0x5 << JOURNAL_TAG_POS)
+#define JOURNAL_TAG_DELTA               (0x6 << JOURNAL_TAG_POS)
+#define JOURNAL_STATE_COUNT_MASK        0x1F    /* of zeros of tag and 24 bits of state */
+#define JOURNAL_STATE_BITS              (3 + 24)
+#define JOURNAL_DELTA_DIRECTION         0x10
+#define JOURNAL_DELTA_COUNT_MASK        0x0F    /* of zeros of tag, direction and diff */
+#define JOURNAL_DELTA_BITS              (3 + 1 + 8)
+#define JOURNAL_NO_FIELD                0xFF
+#define JOURNAL_PERIOD_TICKS            APP_TIMER_TICKS(STATE_JOURNAL_PERIOD_MS)
+
+STATIC_ASSERT(MODES_COUNT <= 8);
+STATIC_ASSERT(JOURNAL_STATE_BITS <= JOURNAL_STATE_COUNT_MASK && JOURNAL_DELTA_BITS <= JOURNAL_DELTA_COUNT_MASK);
+STATIC_ASSERT(HUE_MAX_VALUE < (1U << 9) && SAT_MAX_VALUE < (1U << 7) && BRIGHT_MAX_VALUE < (1U << 7));
+
+typedef enum journal_field_e
+{
+  JOURNAL_FIELD_HUE,
+  JOURNAL_FIELD_SATURATION,
+  JOURNAL_FIELD_BRIGHTNESS,
+  JOURNAL_FIELDS_COUNT
+} journal_field_t;
+
+typedef struct journal_state_s
+{
+  hsv_params_t hsv;
+  uint8_t led_mode;
+  uint8_t directions;             /* @ref color_anim_directions_get */
+} journal_state_t;
+
+typedef struct journal_s
+{
+  journal_state_t written;        /* state of the last entry */
+  uint32_t free_offset;           /* the next entry is written here, half word aligned */
+  uint32_t write_ticks;           /* app timer counter of the last write */
+  bool has_snapshot;              /* state and delta entries are applied to written */
+  bool is_erasing;
+  bool is_started;
+  bool directions_are_pending;    /* restored directions aren't applied to animation yet */
+  bool is_free_word_unknown;      /* may have been written by interrupted write before boot */
+} journal_t;
+
+static journal_t journal;
+
+static inline bool mode_is_animated(uint8_t led_mode)
+{
+  return led_mode > NO_CHANGE && led_mode < MODES_COUNT;
+}
+
+/**
+ * @return field that is animated by mode, JOURNAL_NO_FIELD if mode changes the whole hsv
+ */
+static uint8_t mode_field_get(uint8_t led_mode)
+{
+  switch (led_mode)
+  {
+    case HUE_CHANGE:
+      return JOURNAL_FIELD_HUE;
+
+    case SATURATION_CHANGE:
+      return JOURNAL_FIELD_SATURATION;
+
+    case BRIGHTNESS_CHANGE:
+      return JOURNAL_FIELD_BRIGHTNESS;
+
+    default:
+      return JOURNAL_NO_FIELD;
+  }
+}
+
+static uint16_t field_get(const hsv_params_t *const hsv, journal_field_t field)
+{
+  switch (field)
+  {
+    case JOURNAL_FIELD_HUE:
+      return hsv->hue;
+
+    case JOURNAL_FIELD_SATURATION:
+      return hsv->saturation;
+
+    default:
+      return hsv->brightness;
+  }
+}
+
+static void field_set(hsv_params_t *const hsv, journal_field_t field, uint16_t value)
+{
+  switch (field)
+  {
+    case JOURNAL_FIELD_HUE:
+      hsv->hue = value;
+      break;
+
+    case JOURNAL_FIELD_SATURATION:
+      hsv->saturation = (uint8_t)value;
+      break;
+
+    default:
+      hsv->brightness = (uint8_t)value;
+      break;
+  }
+}
+
+/**
+ * @return zero bits of the low bits_cnt bits of value
+ */
+static uint8_t zeros_count(uint32_t value, uint8_t bits_cnt)
+{
+  uint8_t zeros = 0;
+
+  for (uint8_t bit = 0; bit < bits_cnt; bit++)
+  {
+    zeros += ((value >> bit) & 1U) == 0;
+  }
+
+  return zeros;
+}
+
+static inline uint8_t direction_get(const journal_state_t *const state)
+{
+  return (state->directions >> state->led_mode) & 1U;
+}
+
+static inline void direction_set(journal_state_t *const state, uint8_t direction)
+{
+  state->directions = (state->directions & ~(1U << state->led_mode)) | (direction << state->led_mode);
+}
+
+static inline uint32_t word_align_up(uint32_t offset)
+{
+  return (offset + sizeof(uint32_t) - 1) & ~(sizeof(uint32_t) - 1);
+}
+
+/**
+ * @return entry size by its first byte, 0 if tag is unknown
+ */
+static inline uint8_t entry_size_get(uint8_t header)
+{
+  switch (header & JOURNAL_TAG_MASK)
+  {
+    case JOURNAL_TAG_DELTA:
+      return JOURNAL_HALF_SIZE;
+
+    case JOURNAL_TAG_STATE:
+      return sizeof(uint32_t);
+
+    case JOURNAL_TAG_SNAPSHOT:
+      return JOURNAL_SNAPSHOT_SIZE;
+
+    default:
+      return 0;
+  }
+}
+
+/**
+ * @brief Applies delta of the field of mode to written state, hue wraps around
+ */
+static journal_state_t delta_apply(int8_t diff, uint8_t direction)
+{
+  journal_state_t state = journal.written;
+  const journal_field_t field = mode_field_get(state.led_mode);
+  int32_t value = field_get(&state.hsv, field) + diff;
+
+  if (field == JOURNAL_FIELD_HUE)
+  {
+    value = (value + HUE_MAX_VALUE) % HUE_MAX_VALUE;
+  }
+
+  field_set(&state.hsv, field, (uint16_t)value);
+  direction_set(&state, direction);
+
+  return state;
+}
+
+/**
+ * @return true if delta entry makes state from written one
+ */
+static bool delta_encode(const journal_state_t *const state, uint8_t *bytes)
+{
+  const uint8_t field = mode_field_get(state->led_mode);
+  journal_state_t applied;
+  int16_t diff;
+  uint16_t data;
+
+  if (field == JOURNAL_NO_FIELD)
+  {
+    return false;
+  }
+
+  diff = field_get(&state->hsv, field) - field_get(&journal.written.hsv, field);
+
+  /* The shortest way around hue circle */
+  if (field == JOURNAL_FIELD_HUE)
+  {
+    diff += diff > HUE_MAX_VALUE / 2 ? -HUE_MAX_VALUE : (diff < -HUE_MAX_VALUE / 2 ? HUE_MAX_VALUE : 0);
+  }
+
+  if (diff < INT8_MIN || diff > INT8_MAX)
+  {
+    return false;
+  }
+
+  /* Other fields are the same, hue 360 isn't made by wrap */
+  applied = delta_apply((int8_t)diff, direction_get(state));
+
+  if (memcmp(&applied, state, sizeof(applied)) != 0)
+  {
+    return false;
+  }
+
+  /* Tag and direction are above diff, count is left out */
+  data = (((JOURNAL_TAG_DELTA | (direction_get(state) ? JOURNAL_DELTA_DIRECTION : 0)) >> 4) << 8) | (uint8_t)diff;
+  bytes[0] = ((data >> 8) << 4) | zeros_count(data, JOURNAL_DELTA_BITS);
+  bytes[1] = (uint8_t)data;
+
+  return true;
+}
+
+/**
+ * @brief Makes the shortest entry that makes state from written one: delta if only
+ *  the field of mode is changed by a bit, state if only hsv and direction of the mode
+ *  are changed, otherwise snapshot.
+ *
+ * @param[out] words entry, unused bytes are 0xFF
+ * @return entry size in bytes
+ */
+static uint8_t entry_encode(const journal_state_t *const state, uint32_t *words)
+{
+  uint8_t *bytes = (uint8_t*)words;
+  uint32_t packed;
+  uint8_t zeros = 0;
+
+  memset(words, 0xFF, JOURNAL_SNAPSHOT_SIZE);
+
+  if (journal.has_snapshot && state->led_mode == journal.written.led_mode &&
+      ((state->directions ^ journal.written.directions) & ~(1U << state->led_mode)) == 0)
+  {
+    if (delta_encode(state, bytes))
+    {
+      return JOURNAL_HALF_SIZE;
+    }
+
+    packed = state->hsv.hue | ((uint32_t)state->hsv.saturation << 9) | ((uint32_t)state->hsv.brightness << 16) |
+             ((uint32_t)direction_get(state) << 23);
+    bytes[0] = JOURNAL_TAG_STATE | zeros_count(packed | (JOURNAL_TAG_STATE << 19), JOURNAL_STATE_BITS);
+    bytes[1] = (uint8_t)packed;
+    bytes[2] = (uint8_t)(packed >> 8);
+    bytes[3] = (uint8_t)(packed >> 16);
+
+    return sizeof(uint32_t);
+  }
+
+  bytes[0] = JOURNAL_TAG_SNAPSHOT | (uint8_t)~JOURNAL_TAG_MASK;
+  bytes[1] = (uint8_t)state->hsv.hue;
+  bytes[2] = (uint8_t)(state->hsv.hue >> 8);
+  bytes[3] = state->hsv.saturation;
+  bytes[4] = state->hsv.brightness;
+  bytes[5] = state->led_mode;
+  bytes[6] = state->directions;
+
+  for (uint8_t i = 0; i < JOURNAL_SNAPSHOT_SIZE - 1; i++)
+  {
+    zeros += zeros_count(bytes[i], 8);
+  }
+
+  bytes[JOURNAL_SNAPSHOT_SIZE - 1] = zeros;
+
+  return JOURNAL_SNAPSHOT_SIZE;
+}
+
+/**
+ * @brief Applies entry to journal state.
+ *
+ * @return false if entry is broken or has no snapshot before it
+ */
+static bool entry_decode(const uint8_t *bytes, uint8_t size)
+{
+  journal_state_t state = journal.written;
+  uint32_t packed;
+  uint8_t zeros = 0;
+
+  switch (bytes[0] & JOURNAL_TAG_MASK)
+  {
+    case JOURNAL_TAG_SNAPSHOT:
+      for (uint8_t i = 0; i < size - 1; i++)
+      {
+        zeros += zeros_count(bytes[i], 8);
+      }
+
+      if (zeros != bytes[size - 1] || bytes[5] >= MODES_COUNT)
+      {
+        return false;
+      }
+
+      state.hsv.hue = bytes[1] | ((uint16_t)bytes[2] << 8);
+      state.hsv.saturation = bytes[3];
+      state.hsv.brightness = bytes[4];
+      state.led_mode = bytes[5];
+      state.directions = bytes[6];
+      break;
+
+    case JOURNAL_TAG_STATE:
+      packed = bytes[1] | ((uint32_t)bytes[2] << 8) | ((uint32_t)bytes[3] << 16);
+
+      if (!journal.has_snapshot ||
+          zeros_count(packed | (JOURNAL_TAG_STATE << 19), JOURNAL_STATE_BITS) != (bytes[0] & JOURNAL_STATE_COUNT_MASK))
+      {
+        return false;
+      }
+
+      state.hsv.hue = packed & 0x1FF;
+      state.hsv.saturation = (packed >> 9) & 0x7F;
+      state.hsv.brightness = (packed >> 16) & 0x7F;
+      direction_set(&state, (packed >> 23) & 1U);
+      break;
+
+    default:
+      if (!journal.has_snapshot || mode_field_get(state.led_mode) == JOURNAL_NO_FIELD ||
+          zeros_count(((bytes[0] >> 4) << 8) | bytes[1], JOURNAL_DELTA_BITS) != (bytes[0] & JOURNAL_DELTA_COUNT_MASK))
+      {
+        return false;
+      }
+
+      state = delta_apply((int8_t)bytes[1], (bytes[0] & JOURNAL_DELTA_DIRECTION) != 0);
+      break;
+  }
+
+  if (!validate_hsv_by_ptr(&state.hsv, sizeof(state.hsv)))
+  {
+    return false;
+  }
+
+  journal.written = state;
+  journal.has_snapshot = true;
+
+  return true;
+}
+
+/**
+ * @brief Reads entries up to the first erased word or free upper half of word.
+ *  Nothing is written after broken entry, e.g. interrupted by power loss,
+ *  the page is erased first.
+ */
+static void journal_scan(void)
+{
+  const uint8_t *bytes;
+  uint32_t offset = 0;
+  uint8_t size;
+
+  while (offset < CODE_PAGE_SIZE)
+  {
+    bytes = (const uint8_t*)(NVMC_JOURNAL_PAGE_ADDR + offset);
+
+    if (*(const uint16_t*)bytes == JOURNAL_ERASED_HALF)
+    {
+      /* Upper half is skipped only if word entry follows it */
+      if (offset % sizeof(uint32_t) == 0 || offset + JOURNAL_HALF_SIZE == CODE_PAGE_SIZE ||
+          *(const uint32_t*)(bytes + JOURNAL_HALF_SIZE) == JOURNAL_ERASED_WORD)
+      {
+        if (offset % sizeof(uint32_t) == 0 && *(const uint32_t*)bytes != JOURNAL_ERASED_WORD)
+        {
+          offset = CODE_PAGE_SIZE;
+        }
+
+        break;
+      }
+
+      offset += JOURNAL_HALF_SIZE;
+      continue;
+    }
+
+    size = entry_size_get(bytes[0]);
+
+    if (size == 0 || (size > JOURNAL_HALF_SIZE && offset % sizeof(uint32_t) != 0) ||
+        offset + size > CODE_PAGE_SIZE || !entry_decode(bytes, size))
+    {
+      offset = CODE_PAGE_SIZE;
+      break;
+    }
+
+    offset += size;
+  }
+
+  /* Erase interrupted by power loss may leave page that reads as erased, but it can't
+   * be written until it's erased again. Snapshot is written only after erase, so page
+   * without it or with data after the last entry is erased first. */
+  for (uint32_t rest = word_align_up(offset); rest < CODE_PAGE_SIZE; rest += sizeof(uint32_t))
+  {
+    if (*(const uint32_t*)(NVMC_JOURNAL_PAGE_ADDR + rest) != JOURNAL_ERASED_WORD)
+    {
+      offset = CODE_PAGE_SIZE;
+      break;
+    }
+  }
+
+  journal.free_offset = offset == 0 ? CODE_PAGE_SIZE : offset;
+}
+
+/**
+ * @brief Writes entry at free offset, delta in upper half keeps the lower one
+ */
+static void entry_write(uint32_t offset, const uint32_t *words, uint8_t size)
+{
+  const uint32_t word_offset = offset & ~(sizeof(uint32_t) - 1);
+  uint32_t word;
+
+  if (size == JOURNAL_HALF_SIZE)
+  {
+    word = (offset == word_offset) ? (words[0] | (JOURNAL_ERASED_WORD << 16)) :
+           ((words[0] << 16) | *(const uint16_t*)(NVMC_JOURNAL_PAGE_ADDR + word_offset));
+    nrfx_nvmc_words_write(NVMC_JOURNAL_PAGE_ADDR + word_offset, &word, 1);
+  }
+  else
+  {
+    nrfx_nvmc_words_write(NVMC_JOURNAL_PAGE_ADDR + offset, words, size / sizeof(uint32_t));
+  }
+}
+
+static journal_state_t state_get(void)
+{
+  return (journal_state_t)
+  {
+    .hsv = app_state_hsv_get(),
+    .led_mode = app_state_led_mode_get(),
+    .directions = color_anim_directions_get(),
+  };
+}
+
+/**
+ * @brief Resumes animation that was running when power was lost.
+ *  Call it after saved settings are loaded, journal is newer than them.
+ */
+void state_journal_init(void)
+{
+  memset(&journal, 0, sizeof(journal));
+  journal_scan();
+  journal.free_offset = word_align_up(journal.free_offset);
+  journal.is_free_word_unknown = true;
+
+  if (mode_is_animated(journal.written.led_mode))
+  {
+    app_state_hsv_set(journal.written.hsv);
+    app_state_led_mode_set(journal.written.led_mode);
+    journal.directions_are_pending = true;
+
+    NRF_LOG_INFO("Animation of mode %d is resumed", journal.written.led_mode);
+  }
+}
+
+/**
+ * @brief Writes animation state if it was changed, call it from main loop.
+ *  End of animation is written once, so it isn't resumed.
+ *  Full page is erased by steps, state is written as snapshot after it.
+ */
+void state_journal_process(void)
+{
+  uint32_t words[JOURNAL_SNAPSHOT_SIZE / sizeof(uint32_t)];
+  journal_state_t state;
+  uint32_t offset;
+  uint8_t size;
+
+  if (!journal.is_started)
+  {
+    /* Channels are reset by PWM init, directions are restored after it */
+    if (journal.directions_are_pending)
+    {
+      CRITICAL_REGION_ENTER();
+      color_anim_directions_set(journal.written.directions);
+      CRITICAL_REGION_EXIT();
+    }
+
+    journal.write_ticks = app_timer_cnt_get();
+    journal.is_started = true;
+  }
+
+  if (journal.is_erasing)
+  {
+    if (nvmc_page_erase_process(NVMC_JOURNAL_PAGE_ADDR))
+    {
+      journal.is_erasing = false;
+      journal.has_snapshot = false;
+      journal.free_offset = 0;
+      /* Running animation is written again to the empty page */
+      memset(&journal.written, 0xFF, sizeof(journal.written));
+    }
+
+    return;
+  }
+
+  if (app_timer_cnt_diff_compute(app_timer_cnt_get(), journal.write_ticks) < JOURNAL_PERIOD_TICKS)
+  {
+    return;
+  }
+
+  state = state_get();
+
+  if ((!mode_is_animated(state.led_mode) && !mode_is_animated(journal.written.led_mode)) ||
+      !memcmp(&state, &journal.written, sizeof(state)))
+  {
+    return;
+  }
+
+  size = entry_encode(&state, words);
+  offset = journal.free_offset;
+
+  if (size > JOURNAL_HALF_SIZE)
+  {
+    offset = word_align_up(offset);
+  }
+
+  if (offset + size > CODE_PAGE_SIZE)
+  {
+    journal.is_erasing = true;
+    return;
+  }
+
+  /* Settings store writes flash from interrupts, NVMC mode mustn't be changed in between */
+  CRITICAL_REGION_ENTER();
+  entry_write(offset, words, size);
+  CRITICAL_REGION_EXIT();
+
+  journal.written = state;
+  journal.has_snapshot = true;
+  journal.free_offset = journal.is_free_word_unknown ? word_align_up(offset + size) : offset + size;
+  journal.is_free_word_unknown = false;
+  journal.write_ticks = app_timer_cnt_get();
+}
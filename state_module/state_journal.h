@@ -0,0 +1,11 @@
+#ifndef _STATE_JOURNAL_H
+#define _STATE_JOURNAL_H
+
+#include "nrfx.h"
+
+#define STATE_JOURNAL_PERIOD_MS         5000    /* changed state is written not more often */
+
+void state_journal_init(void);
+void state_journal_process(void);
+
+#endif /* _STATE_JOURNAL_H */
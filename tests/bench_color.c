@@ -0,0 +1,219 @@
+/* Static functions are measured too */
+#include "../hsv_to_rgb_module/hsv_to_rgb.c"
+#include "color_ref.h"
+#include "color_oklab.h"
+#include "bench_util.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+/**
+ * Per pixel cost of color conversions against reference versions of color_ref.h,
+ *  CSV rows are written to stdout. Inputs are random, so branches of the reference
+ *  are mispredicted as they are on a stream of frames. The best of runs is reported.
+ *
+ * hsv_by_rgb and OKLab conversions are compared with double precision ones. Host FPU makes doubles
+ *  cheap, on Cortex-M4 they are emulated, so only ratios between fixed point
+ *  conversions are meaningful for the target.
+ */
+
+#define PIXELS_COUNT                    4096
+#define PASSES_COUNT                    1000
+#define RUNS_COUNT                      5
+#define RGB16_MAX_VALUE                 ((uint32_t)RGB_MAX_VALUE << RGB16_FRACTION_BITS)
+
+static hsv8_params_t hsv8_inputs[PIXELS_COUNT];
+static hsv_params_t hsv_inputs[PIXELS_COUNT];
+static rgb_params_t rgb_inputs[PIXELS_COUNT];
+static rgb_params_t rgb_outputs[PIXELS_COUNT];
+static hsv_params_t hsv_outputs[PIXELS_COUNT];
+static hsv_params_t hsv_ref_outputs[PIXELS_COUNT];
+static rgb16_params_t rgb16_inputs[PIXELS_COUNT];
+static rgb16_params_t rgb16_outputs[PIXELS_COUNT];
+static oklab_t lab_inputs[PIXELS_COUNT];
+static oklab_t lab_outputs[PIXELS_COUNT];
+static oklch_t lch_inputs[PIXELS_COUNT];
+static oklch_t lch_outputs[PIXELS_COUNT];
+static oklab_ref_t lab_ref_outputs[PIXELS_COUNT];
+static double rgb_ref_outputs[PIXELS_COUNT][3];
+static uint32_t rnd_state = 1;
+
+static uint32_t rnd(void)
+{
+  rnd_state = rnd_state * 1664525U + 1013904223U;
+  return rnd_state >> 8;
+}
+
+static __attribute__((noinline)) void hsv8_to_rgb_run(void)
+{
+  for (uint32_t i = 0; i < PIXELS_COUNT; i++)
+  {
+    hsv8_to_rgb(&hsv8_inputs[i], &rgb_outputs[i]);
+  }
+}
+
+static __attribute__((noinline)) void hsv8_to_rgb_ref_run(void)
+{
+  for (uint32_t i = 0; i < PIXELS_COUNT; i++)
+  {
+    rgb_outputs[i] = hsv8_to_rgb_ref(hsv8_inputs[i].hue, hsv8_inputs[i].saturation, hsv8_inputs[i].brightness);
+  }
+}
+
+static __attribute__((noinline)) void hsv_to_rgb_run(void)
+{
+  for (uint32_t i = 0; i < PIXELS_COUNT; i++)
+  {
+    hsv_to_rgb(&hsv_inputs[i], &rgb_outputs[i]);
+  }
+}
+
+static __attribute__((noinline)) void hsv_to_rgb_batch_run(void)
+{
+  hsv_to_rgb_batch(hsv_inputs, rgb_outputs, PIXELS_COUNT);
+}
+
+static __attribute__((noinline)) void hsv_by_rgb_run(void)
+{
+  for (uint32_t i = 0; i < PIXELS_COUNT; i++)
+  {
+    hsv_outputs[i] = hsv_by_rgb(rgb_inputs[i]);
+  }
+}
+
+static __attribute__((noinline)) void hsv_ref_by_rgb_run(void)
+{
+  for (uint32_t i = 0; i < PIXELS_COUNT; i++)
+  {
+    hsv_ref_outputs[i] = hsv_ref_by_rgb(rgb_inputs[i].red, rgb_inputs[i].green, rgb_inputs[i].blue);
+  }
+}
+
+static __attribute__((noinline)) void oklab_by_rgb16_run(void)
+{
+  for (uint32_t i = 0; i < PIXELS_COUNT; i++)
+  {
+    lab_outputs[i] = oklab_by_rgb16(rgb16_inputs[i]);
+  }
+}
+
+static __attribute__((noinline)) void oklab_ref_by_rgb_run(void)
+{
+  for (uint32_t i = 0; i < PIXELS_COUNT; i++)
+  {
+    lab_ref_outputs[i] = oklab_ref_by_rgb((double)rgb16_inputs[i].red / RGB16_MAX_VALUE,
+                                          (double)rgb16_inputs[i].green / RGB16_MAX_VALUE,
+                                          (double)rgb16_inputs[i].blue / RGB16_MAX_VALUE);
+  }
+}
+
+static __attribute__((noinline)) void rgb16_by_oklab_run(void)
+{
+  for (uint32_t i = 0; i < PIXELS_COUNT; i++)
+  {
+    rgb16_by_oklab(&lab_inputs[i], &rgb16_outputs[i]);
+  }
+}
+
+static __attribute__((noinline)) void rgb_ref_by_oklab_run(void)
+{
+  for (uint32_t i = 0; i < PIXELS_COUNT; i++)
+  {
+    rgb_ref_by_oklab(lab_ref_outputs[i], rgb_ref_outputs[i]);
+  }
+}
+
+static __attribute__((noinline)) void oklch_by_oklab_run(void)
+{
+  for (uint32_t i = 0; i < PIXELS_COUNT; i++)
+  {
+    lch_outputs[i] = oklch_by_oklab(&lab_inputs[i]);
+  }
+}
+
+static __attribute__((noinline)) void oklch_lerp_run(void)
+{
+  for (uint32_t i = 0; i < PIXELS_COUNT; i++)
+  {
+    lch_outputs[i] = oklch_lerp(&lch_inputs[i], &lch_inputs[PIXELS_COUNT - 1 - i], i << 4);
+  }
+}
+
+/* Hue sweep and OKLCh transitions run it for every frame */
+static __attribute__((noinline)) void rgb16_by_oklch_in_gamut_run(void)
+{
+  for (uint32_t i = 0; i < PIXELS_COUNT; i++)
+  {
+    rgb16_by_oklch_in_gamut(lch_inputs[i], &rgb16_outputs[i]);
+  }
+}
+
+static void bench_print(const char *bench_case, const char *impl, void (*run)(void))
+{
+  uint64_t best_ns = UINT64_MAX;
+  uint64_t start_ns;
+
+  for (uint8_t i = 0; i < RUNS_COUNT; i++)
+  {
+    start_ns = bench_host_ns_get();
+
+    for (uint32_t pass = 0; pass < PASSES_COUNT; pass++)
+    {
+      run();
+      __asm__ volatile("" ::: "memory");
+    }
+
+    best_ns = MIN(best_ns, bench_host_ns_get() - start_ns);
+  }
+
+  printf("%s,%s,%u,%.2f\n", bench_case, impl, PIXELS_COUNT * PASSES_COUNT,
+         (double)best_ns / (PIXELS_COUNT * PASSES_COUNT));
+}
+
+int main(void)
+{
+  for (uint32_t i = 0; i < PIXELS_COUNT; i++)
+  {
+    hsv8_inputs[i] = (hsv8_params_t){.hue = rnd(), .saturation = rnd(), .brightness = rnd()};
+    hsv_inputs[i] = (hsv_params_t)
+    {
+      .hue = rnd() % (HUE_MAX_VALUE + 1),
+      .saturation = rnd() % (SAT_MAX_VALUE + 1),
+      .brightness = rnd() % (BRIGHT_MAX_VALUE + 1)
+    };
+    rgb_inputs[i] = (rgb_params_t){.red = rnd(), .green = rnd(), .blue = rnd()};
+    rgb16_inputs[i] = (rgb16_params_t)
+    {
+      .red = rnd() % (RGB16_MAX_VALUE + 1),
+      .green = rnd() % (RGB16_MAX_VALUE + 1),
+      .blue = rnd() % (RGB16_MAX_VALUE + 1)
+    };
+    lab_inputs[i] = oklab_by_rgb16(rgb16_inputs[i]);
+    lch_inputs[i] = oklch_by_oklab(&lab_inputs[i]);
+  }
+
+  oklab_ref_by_rgb_run();
+
+  printf("case,impl,pixels,ns_per_pixel\n");
+  bench_print("hsv8_to_rgb", "branchless", hsv8_to_rgb_run);
+  bench_print("hsv8_to_rgb", "reference", hsv8_to_rgb_ref_run);
+  bench_print("hsv_to_rgb", "single", hsv_to_rgb_run);
+  bench_print("hsv_to_rgb", "batch", hsv_to_rgb_batch_run);
+  bench_print("hsv_by_rgb", "integer", hsv_by_rgb_run);
+  bench_print("hsv_by_rgb", "double", hsv_ref_by_rgb_run);
+  bench_print("oklab_by_rgb16", "fixed", oklab_by_rgb16_run);
+  bench_print("oklab_by_rgb16", "double", oklab_ref_by_rgb_run);
+  bench_print("rgb16_by_oklab", "fixed", rgb16_by_oklab_run);
+  bench_print("rgb16_by_oklab", "double", rgb_ref_by_oklab_run);
+  bench_print("oklch_by_oklab", "fixed", oklch_by_oklab_run);
+  bench_print("oklch_lerp", "fixed", oklch_lerp_run);
+  bench_print("rgb16_by_oklch_in_gamut", "fixed", rgb16_by_oklch_in_gamut_run);
+
+  /* Outputs are read, so compiler keeps conversions that are pure */
+  if (memcmp(hsv_outputs, hsv_ref_outputs, sizeof(hsv_outputs)) != 0)
+  {
+    fprintf(stderr, "hsv_by_rgb differs from reference\n");
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
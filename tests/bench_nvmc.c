@@ -0,0 +1,292 @@
+#include "nvmc_emu.h"
+#include "bench_util.h"
+#include "nvmc_module.h"
+#include "nvmc_kv.h"
+#include "settings.h"
+#include "app_state.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+/**
+ * Costs of settings store as the log page fills, CSV rows are written to stdout:
+ *  boot          - nvmc_init() and nvmc_find_last_record() at 0, 50 and 100 % fill
+ *  save          - settings_save() after color change, without rollover
+ *  rollover_*    - save that compacts the page, spare page is erased or dirty
+ *  erase         - background erase of spare page after rollover
+ *
+ * flash_us is NVMC busy time by timings of nRF52840, CPU is stalled for it
+ *  on target, so it's the latency of firmware. host_ns is CPU time of host
+ *  including emulation, it only tracks changes of algorithms. write_sessions
+ *  counts switches of NVMC to write mode and back.
+ */
+
+#define BOOT_SAMPLES                    200
+#define SAVES_COUNT                     4000    /* about 8 rollovers */
+#define MAIN_LOOP_CALLS_PER_SAVE        1       /* spare page is erased before the next rollover */
+#define DIRTY_ROLLOVERS_COUNT           8
+
+typedef enum metric_e
+{
+  METRIC_FLASH_US,
+  METRIC_HOST_NS,
+  METRIC_MAIN_LOOP_CALLS,
+  METRIC_WRITE_SESSIONS,
+  METRICS_COUNT
+} metric_t;
+
+static const char *const metric_names[METRICS_COUNT] = {"flash_us", "host_ns", "main_loop_calls", "write_sessions"};
+
+typedef struct samples_s
+{
+  bench_samples_t metrics[METRICS_COUNT];
+} samples_t;
+
+typedef enum bench_case_e
+{
+  CASE_BOOT,
+  CASE_SAVE,
+  CASE_ROLLOVER_ERASED,
+  CASE_ROLLOVER_DIRTY,
+  CASE_ERASE,
+  CASES_COUNT
+} bench_case_t;
+
+static const char *const case_names[CASES_COUNT] = {"boot", "save", "rollover_erased", "rollover_dirty", "erase"};
+
+/* Lives on heap, so it survives boots */
+typedef struct bench_state_s
+{
+  samples_t samples[CASES_COUNT];
+  uint32_t fill_pct;              /* of boot case */
+  nvmc_emu_stats_t start_stats;
+  uint64_t host_start_ns;
+} bench_state_t;
+
+static bench_state_t *bench;
+
+static void sample_begin(void)
+{
+  bench->start_stats = nvmc_emu_stats_get();
+  bench->host_start_ns = bench_host_ns_get();
+}
+
+static void sample_end(bench_case_t bench_case, uint64_t main_loop_calls)
+{
+  const uint64_t host_ns = bench_host_ns_get() - bench->host_start_ns;
+  const nvmc_emu_stats_t stats = nvmc_emu_stats_get();
+  samples_t *const samples = &bench->samples[bench_case];
+
+  bench_sample_add(&samples->metrics[METRIC_FLASH_US], stats.busy_us - bench->start_stats.busy_us);
+  bench_sample_add(&samples->metrics[METRIC_HOST_NS], host_ns);
+  bench_sample_add(&samples->metrics[METRIC_WRITE_SESSIONS], stats.write_sessions - bench->start_stats.write_sessions);
+
+  /* Only erase is run by main loop */
+  if (bench_case == CASE_ERASE)
+  {
+    bench_sample_add(&samples->metrics[METRIC_MAIN_LOOP_CALLS], main_loop_calls);
+  }
+}
+
+static void samples_print(bench_case_t bench_case, const char *fill)
+{
+  char row[64];
+
+  for (metric_t metric = 0; metric < METRICS_COUNT; metric++)
+  {
+    snprintf(row, sizeof(row), "%s,%s,%s", case_names[bench_case], fill, metric_names[metric]);
+    bench_samples_print(row, &bench->samples[bench_case].metrics[metric]);
+  }
+}
+
+/**
+ * @return bytes of page up to its last written word
+ */
+static uint32_t page_used_get(uint32_t page_addr)
+{
+  const uint32_t *const words = (const uint32_t*)page_addr;
+  uint32_t used = CODE_PAGE_SIZE / sizeof(uint32_t);
+
+  while (used > 0 && words[used - 1] == 0xFFFFFFFFU)
+  {
+    used--;
+  }
+
+  return used * sizeof(uint32_t);
+}
+
+static uint32_t log_used_get(void)
+{
+  return MAX(page_used_get(NVMC_START_APP_DATA_ADDR), page_used_get(NVMC_START_APP_DATA_ADDR + CODE_PAGE_SIZE));
+}
+
+static void color_change(void)
+{
+  hsv_params_t hsv = app_state_hsv_get();
+
+  hsv.hue = (hsv.hue + 1) % HUE_MAX_VALUE;
+  app_state_hsv_set(hsv);
+}
+
+/**
+ * @return calls of main loop that erased spare page
+ */
+static uint32_t erase_finish(void)
+{
+  uint64_t steps = nvmc_emu_stats_get().erase_steps;
+  uint32_t calls = 0;
+
+  for (;;)
+  {
+    nvmc_erase_last_written_page();
+
+    if (nvmc_emu_stats_get().erase_steps == steps)
+    {
+      return calls;
+    }
+
+    steps = nvmc_emu_stats_get().erase_steps;
+    calls++;
+  }
+}
+
+/**
+ * @brief Fills the log by saves of changed color, the first save writes the whole configuration
+ */
+static void firmware_fill(void)
+{
+  const uint32_t target = bench->fill_pct * CODE_PAGE_SIZE / 100;
+  const uint32_t record_size = NVMC_KV_RECORD_HEADER_SIZE + sizeof(hsv_params_t);
+
+  nvmc_init();
+  app_state_init(nvmc_find_last_record());
+
+  if (target > NVMC_KV_PAGE_HEADER_SIZE)
+  {
+    settings_save();
+  }
+
+  while (log_used_get() + record_size <= target)
+  {
+    color_change();
+    settings_save();
+  }
+
+  erase_finish();
+}
+
+static void firmware_boot(void)
+{
+  hsv_params_t hsv;
+
+  sample_begin();
+  nvmc_init();
+  hsv = nvmc_find_last_record();
+  sample_end(CASE_BOOT, 0);
+
+  UNUSED_VARIABLE(hsv);
+}
+
+static bool save_measure(bench_case_t bench_case)
+{
+  const uint32_t version = nvmc_kv_version();
+  const uint64_t pages_erased = nvmc_emu_stats_get().pages_erased;
+  bench_case_t measured = bench_case;
+
+  color_change();
+
+  sample_begin();
+  settings_save();
+
+  /* Compaction changes version too */
+  if (nvmc_kv_version() - version > 1)
+  {
+    measured = nvmc_emu_stats_get().pages_erased != pages_erased ? CASE_ROLLOVER_DIRTY : CASE_ROLLOVER_ERASED;
+  }
+
+  sample_end(measured, 0);
+
+  return measured != bench_case;
+}
+
+static void firmware_saves(void)
+{
+  uint32_t calls;
+
+  nvmc_init();
+  app_state_init(nvmc_find_last_record());
+  erase_finish();
+
+  for (uint32_t i = 0; i < SAVES_COUNT; i++)
+  {
+    if (save_measure(CASE_SAVE))
+    {
+      sample_begin();
+      calls = erase_finish();
+      sample_end(CASE_ERASE, calls);
+    }
+
+    for (uint32_t call = 0; call < MAIN_LOOP_CALLS_PER_SAVE; call++)
+    {
+      nvmc_erase_last_written_page();
+    }
+  }
+}
+
+/**
+ * @brief Main loop doesn't run between saves, so every rollover erases spare page at once
+ */
+static void firmware_saves_without_main_loop(void)
+{
+  uint32_t rollovers = 0;
+
+  nvmc_init();
+  app_state_init(nvmc_find_last_record());
+
+  while (rollovers < DIRTY_ROLLOVERS_COUNT)
+  {
+    rollovers += save_measure(CASE_SAVE) ? 1 : 0;
+  }
+}
+
+int main(void)
+{
+  static const uint32_t fills[] = {0, 50, 100};
+  char fill[8];
+
+  nvmc_emu_init();
+  bench = calloc(1, sizeof(*bench));
+
+  if (bench == NULL)
+  {
+    return EXIT_FAILURE;
+  }
+
+  printf("case,fill_pct,metric,samples,p50,p90,p99,max\n");
+
+  for (uint8_t i = 0; i < ARRAY_SIZE(fills); i++)
+  {
+    nvmc_emu_erase_all();
+    bench->fill_pct = fills[i];
+    nvmc_emu_boot(firmware_fill, NVMC_EMU_NO_CUT, 0);
+
+    for (uint32_t boot = 0; boot < BOOT_SAMPLES; boot++)
+    {
+      nvmc_emu_boot(firmware_boot, NVMC_EMU_NO_CUT, 0);
+    }
+
+    snprintf(fill, sizeof(fill), "%u", log_used_get() * 100 / CODE_PAGE_SIZE);
+    samples_print(CASE_BOOT, fill);
+  }
+
+  nvmc_emu_erase_all();
+  nvmc_emu_boot(firmware_saves, NVMC_EMU_NO_CUT, 0);
+  samples_print(CASE_SAVE, "all");
+  samples_print(CASE_ROLLOVER_ERASED, "100");
+  samples_print(CASE_ERASE, "all");
+
+  nvmc_emu_erase_all();
+  nvmc_emu_boot(firmware_saves_without_main_loop, NVMC_EMU_NO_CUT, 0);
+  samples_print(CASE_ROLLOVER_DIRTY, "100");
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,229 @@
+#include "nvmc_emu.h"
+#include "bench_util.h"
+#include "nvmc_kv.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+/**
+ * Costs of key-value store operations, CSV rows are written to stdout.
+ *  Every key of settings is stored with values of one size:
+ *  get           - value of random key is copied from flash
+ *  get_missing   - key that isn't stored
+ *  put           - changed value is appended
+ *  put_unchanged - value is the same as stored one, nothing is written
+ *  gc            - put that compacts live keys into spare page, spare page is erased
+ *
+ * flash_us is NVMC busy time by timings of nRF52840, CPU is stalled for it on target.
+ *  write_sessions counts switches of NVMC to write mode and back.
+ *  host_ns is CPU time of host including emulation, gets are too fast for one
+ *  clock reading, so their time is an average of GET_BATCH calls.
+ */
+
+#define GET_SAMPLES                     2000
+#define GET_BATCH                       100
+#define PUT_SAMPLES                     2000
+#define GC_SAMPLES                      20
+
+#define CHECK(expr)                                                         \
+  do                                                                        \
+  {                                                                         \
+    if (!(expr))                                                            \
+    {                                                                       \
+      fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #expr);            \
+      exit(EXIT_FAILURE);                                                   \
+    }                                                                       \
+  } while (0)
+
+typedef enum bench_case_e
+{
+  CASE_GET,
+  CASE_GET_MISSING,
+  CASE_PUT,
+  CASE_PUT_UNCHANGED,
+  CASE_GC,
+  CASES_COUNT
+} bench_case_t;
+
+static const char *const case_names[CASES_COUNT] = {"get", "get_missing", "put", "put_unchanged", "gc"};
+
+static const nvmc_kv_key_t keys[] =
+{
+  NVMC_KV_KEY_HSV,
+  NVMC_KV_KEY_LED_MODE,
+  NVMC_KV_KEY_PRESETS,
+  NVMC_KV_KEY_COLOR_HISTORY,
+  NVMC_KV_KEY_COLOR_CALIB,
+  NVMC_KV_KEY_EFFECT_0,
+  NVMC_KV_KEY_EFFECT_1,
+  NVMC_KV_KEY_EFFECT_2,
+  NVMC_KV_KEY_EFFECT_3,
+};
+
+/* Lives on heap, so it survives boots */
+typedef struct bench_state_s
+{
+  bench_samples_t flash_us[CASES_COUNT];
+  bench_samples_t host_ns[CASES_COUNT];
+  bench_samples_t write_sessions[CASES_COUNT];
+  uint8_t size;                   /* of every value */
+  uint32_t seq;
+} bench_state_t;
+
+static bench_state_t *bench;
+static uint32_t rnd_state = 1;
+
+static uint32_t rnd(void)
+{
+  rnd_state = rnd_state * 1664525U + 1013904223U;
+  return rnd_state >> 8;
+}
+
+static void value_fill(uint8_t *value, uint32_t seq)
+{
+  for (uint8_t i = 0; i < bench->size; i++)
+  {
+    value[i] = (uint8_t)(seq * 31 + i);
+  }
+}
+
+/**
+ * @brief Runs main loop until spare page is erased
+ */
+static void erase_finish(void)
+{
+  uint64_t steps;
+
+  do
+  {
+    steps = nvmc_emu_stats_get().erase_steps;
+    nvmc_kv_process();
+  } while (nvmc_emu_stats_get().erase_steps != steps);
+}
+
+static void gets_measure(bench_case_t bench_case)
+{
+  const nvmc_kv_key_t missing_key = (nvmc_kv_key_t)(NVMC_KV_KEY_EFFECT_3 + 1);
+  uint8_t value[NVMC_KV_VALUE_MAX_SIZE];
+  nvmc_kv_key_t batch_keys[GET_BATCH];
+  uint64_t start_ns;
+  bool is_found = true;
+
+  for (uint32_t sample = 0; sample < GET_SAMPLES; sample++)
+  {
+    for (uint32_t i = 0; i < GET_BATCH; i++)
+    {
+      batch_keys[i] = bench_case == CASE_GET ? keys[rnd() % ARRAY_SIZE(keys)] : missing_key;
+    }
+
+    start_ns = bench_host_ns_get();
+
+    for (uint32_t i = 0; i < GET_BATCH; i++)
+    {
+      is_found &= nvmc_kv_get(batch_keys[i], value, bench->size) == (bench_case == CASE_GET);
+    }
+
+    bench_sample_add(&bench->host_ns[bench_case], (bench_host_ns_get() - start_ns) / GET_BATCH);
+  }
+
+  CHECK(is_found);
+}
+
+/**
+ * @return true if put compacted the page
+ */
+static bool put_measure(nvmc_kv_key_t key, uint32_t seq)
+{
+  const uint32_t version = nvmc_kv_version();
+  const nvmc_emu_stats_t start_stats = nvmc_emu_stats_get();
+  uint8_t value[NVMC_KV_VALUE_MAX_SIZE];
+  uint64_t start_ns;
+  bench_case_t bench_case;
+
+  value_fill(value, seq);
+
+  start_ns = bench_host_ns_get();
+  CHECK(nvmc_kv_put(key, value, bench->size));
+  start_ns = bench_host_ns_get() - start_ns;
+
+  /* Compaction changes version too */
+  if (nvmc_kv_version() == version)
+  {
+    bench_case = CASE_PUT_UNCHANGED;
+  }
+  else
+  {
+    bench_case = nvmc_kv_version() - version > 1 ? CASE_GC : CASE_PUT;
+  }
+
+  bench_sample_add(&bench->flash_us[bench_case], nvmc_emu_stats_get().busy_us - start_stats.busy_us);
+  bench_sample_add(&bench->host_ns[bench_case], start_ns);
+  bench_sample_add(&bench->write_sessions[bench_case],
+                   nvmc_emu_stats_get().write_sessions - start_stats.write_sessions);
+
+  return bench_case == CASE_GC;
+}
+
+static void firmware_kv(void)
+{
+  uint32_t gc_count = 0;
+  nvmc_kv_key_t key;
+
+  nvmc_kv_init();
+  erase_finish();
+
+  for (uint8_t i = 0; i < ARRAY_SIZE(keys); i++)
+  {
+    put_measure(keys[i], ++bench->seq);
+  }
+
+  gets_measure(CASE_GET);
+  gets_measure(CASE_GET_MISSING);
+
+  for (uint32_t i = 0; i < PUT_SAMPLES || gc_count < GC_SAMPLES; i++)
+  {
+    key = keys[i % ARRAY_SIZE(keys)];
+
+    if (put_measure(key, ++bench->seq))
+    {
+      gc_count++;
+      erase_finish();
+    }
+
+    put_measure(key, bench->seq);
+  }
+}
+
+int main(void)
+{
+  static const uint8_t sizes[] = {4, 32, NVMC_KV_VALUE_MAX_SIZE};
+  char row[64];
+
+  nvmc_emu_init();
+  bench = calloc(1, sizeof(*bench));
+
+  if (bench == NULL)
+  {
+    return EXIT_FAILURE;
+  }
+
+  printf("case,size,metric,samples,p50,p90,p99,max\n");
+
+  for (uint8_t i = 0; i < ARRAY_SIZE(sizes); i++)
+  {
+    nvmc_emu_erase_all();
+    bench->size = sizes[i];
+    CHECK(nvmc_emu_boot(firmware_kv, NVMC_EMU_NO_CUT, 0) == NVMC_EMU_BOOT_DONE);
+
+    for (bench_case_t bench_case = 0; bench_case < CASES_COUNT; bench_case++)
+    {
+      snprintf(row, sizeof(row), "%s,%u,flash_us", case_names[bench_case], sizes[i]);
+      bench_samples_print(row, &bench->flash_us[bench_case]);
+      snprintf(row, sizeof(row), "%s,%u,host_ns", case_names[bench_case], sizes[i]);
+      bench_samples_print(row, &bench->host_ns[bench_case]);
+      snprintf(row, sizeof(row), "%s,%u,write_sessions", case_names[bench_case], sizes[i]);
+      bench_samples_print(row, &bench->write_sessions[bench_case]);
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
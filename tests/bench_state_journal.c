@@ -0,0 +1,183 @@
+/* Page space taken by journal is read from its static state */
+#include "../state_module/state_journal.c"
+#include "nvmc_emu.h"
+#include "nvmc_kv.h"
+#include "app_state.h"
+#include "app_timer.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+/**
+ * Flash wear of persisting running animation, CSV rows are written to stdout. Animation
+ *  runs for RUN_HOURS, so pages are erased many times, and wear is averaged per hour.
+ *  Animation is made by @ref color_changing_machine at default speed as PWM module
+ *  does it, main loop is called every MAIN_LOOP_PERIOD_MS and changed state is
+ *  written not more often than STATE_JOURNAL_PERIOD_MS by every method:
+ *  journal       - @ref state_journal_process, snapshots, state words and half word deltas
+ *  kv            - color is put to key-value store, it's 8 bytes with record header
+ *  fixed_4_byte  - hsv_params_t records of 4 bytes of the old store, it's modeled
+ *                  without flash: a page is erased when its records fill it.
+ *                  Unlike journal, it doesn't keep mode and directions
+ *
+ * bytes_per_hour is page space taken by records, word_writes_per_hour counts NVMC
+ *  word writes, a word of two deltas is written twice.
+ *
+ * Scenarios:
+ *  hue           - OKLCh hue sweep, saturation and brightness follow it, state words are written
+ *  brightness    - brightness bounces, direction is changed every 10 seconds, deltas are written
+ */
+
+#define MAIN_LOOP_PERIOD_MS             100
+#define HOUR_MS                         (60 * 60 * 1000)
+#define RUN_HOURS                       24
+#define ANIM_STEP_MS                    (1000 / COLOR_ANIM_DEFAULT_SPEED)
+#define FIXED_RECORD_SIZE               sizeof(hsv_params_t)
+
+typedef enum method_e
+{
+  METHOD_JOURNAL,
+  METHOD_KV,
+  METHOD_FIXED,
+  METHODS_COUNT
+} method_t;
+
+static const char *const method_names[METHODS_COUNT] = {"journal", "kv", "fixed_4_byte"};
+
+typedef enum scenario_e
+{
+  SCENARIO_HUE,
+  SCENARIO_BRIGHTNESS,
+  SCENARIOS_COUNT
+} scenario_t;
+
+static const char *const scenario_names[SCENARIOS_COUNT] = {"hue", "brightness"};
+
+/* Lives on heap, so it survives boots */
+typedef struct bench_state_s
+{
+  scenario_t scenario;
+  method_t method;
+  uint64_t bytes;                 /* taken by journal and modeled method */
+} bench_state_t;
+
+static bench_state_t *bench;
+
+/**
+ * @brief One step of animation of scenario, as PWM module does it
+ */
+static void anim_step(void)
+{
+  hsv_params_t hsv = app_state_hsv_get();
+  rgb_params_t rgb;
+
+  color_changing_machine(&hsv, 1, app_state_led_mode_get(), &rgb);
+  app_state_hsv_set(hsv);
+}
+
+static void firmware_animation(void)
+{
+  const hsv_params_t start_hsv = HSV_STRUCT_DEFAULT_VALUE;
+  hsv_params_t written_hsv = start_hsv;
+  hsv_params_t hsv;
+  uint32_t written_ticks = 0;
+  uint32_t journal_offset;
+
+  nvmc_kv_init();
+  app_state_init(start_hsv);
+  app_state_led_mode_set(bench->scenario == SCENARIO_HUE ? HUE_CHANGE : BRIGHTNESS_CHANGE);
+  color_anim_init(ANIM_STEP_MS * 1000);
+  state_journal_init();
+  /* Empty page is erased before the first snapshot */
+  journal_offset = journal.free_offset;
+
+  /* Pages of empty store are erased and formatted by init */
+  nvmc_emu_stats_reset();
+
+  for (uint32_t ms = 0; ms < RUN_HOURS * HOUR_MS; ms += MAIN_LOOP_PERIOD_MS)
+  {
+    app_timer_stub_cnt += APP_TIMER_TICKS(MAIN_LOOP_PERIOD_MS);
+
+    for (uint32_t step = 0; step < MAIN_LOOP_PERIOD_MS / ANIM_STEP_MS; step++)
+    {
+      anim_step();
+    }
+
+    if (bench->method == METHOD_JOURNAL)
+    {
+      state_journal_process();
+
+      /* Page was erased */
+      if (journal.free_offset < journal_offset)
+      {
+        journal_offset = 0;
+      }
+
+      bench->bytes += journal.free_offset - journal_offset;
+      journal_offset = journal.free_offset;
+      continue;
+    }
+
+    nvmc_kv_process();
+
+    hsv = app_state_hsv_get();
+
+    if (!memcmp(&hsv, &written_hsv, sizeof(hsv)) ||
+        app_timer_cnt_diff_compute(app_timer_cnt_get(), written_ticks) < APP_TIMER_TICKS(STATE_JOURNAL_PERIOD_MS))
+    {
+      continue;
+    }
+
+    written_hsv = hsv;
+    written_ticks = app_timer_cnt_get();
+
+    if (bench->method == METHOD_KV)
+    {
+      nvmc_kv_put(NVMC_KV_KEY_HSV, &written_hsv, sizeof(written_hsv));
+    }
+    else
+    {
+      bench->bytes += FIXED_RECORD_SIZE;
+    }
+  }
+}
+
+int main(void)
+{
+  nvmc_emu_stats_t stats;
+  uint64_t bytes;
+  uint64_t word_writes;
+  double erases;
+
+  nvmc_emu_init();
+  bench = calloc(1, sizeof(*bench));
+
+  if (bench == NULL)
+  {
+    return EXIT_FAILURE;
+  }
+
+  printf("scenario,method,bytes_per_hour,word_writes_per_hour,page_erases_per_hour\n");
+
+  for (scenario_t scenario = 0; scenario < SCENARIOS_COUNT; scenario++)
+  {
+    for (method_t method = 0; method < METHODS_COUNT; method++)
+    {
+      nvmc_emu_erase_all();
+      bench->scenario = scenario;
+      bench->method = method;
+      bench->bytes = 0;
+      nvmc_emu_boot(firmware_animation, NVMC_EMU_NO_CUT, 0);
+
+      stats = nvmc_emu_stats_get();
+      bytes = method == METHOD_KV ? stats.words_written * sizeof(uint32_t) : bench->bytes;
+      word_writes = method == METHOD_FIXED ? bytes / sizeof(uint32_t) : stats.words_written;
+      erases = method == METHOD_FIXED ? (double)bytes / CODE_PAGE_SIZE :
+               (double)(stats.busy_us - stats.words_written * NVMC_EMU_WORD_WRITE_US) / NVMC_EMU_PAGE_ERASE_US;
+
+      printf("%s,%s,%llu,%llu,%.2f\n", scenario_names[scenario], method_names[method],
+             (unsigned long long)bytes / RUN_HOURS, (unsigned long long)word_writes / RUN_HOURS, erases / RUN_HOURS);
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,57 @@
+#include "bench_util.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+uint64_t bench_host_ns_get(void)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return (uint64_t)now.tv_sec * 1000000000U + now.tv_nsec;
+}
+
+/**
+ * @brief Samples above BENCH_SAMPLES_MAX are dropped
+ */
+void bench_sample_add(bench_samples_t *const samples, uint64_t value)
+{
+  if (samples->count < BENCH_SAMPLES_MAX)
+  {
+    samples->values[samples->count++] = value;
+  }
+}
+
+static int value_cmp(const void *a, const void *b)
+{
+  const uint64_t left = *(const uint64_t*)a;
+  const uint64_t right = *(const uint64_t*)b;
+
+  return left < right ? -1 : left > right;
+}
+
+/**
+ * @brief Prints "<row>,<samples>,<p50>,<p90>,<p99>,<max>" and drops samples.
+ *  Nothing is printed if there are no samples.
+ *
+ * @param row the first columns of CSV row
+ */
+void bench_samples_print(const char *row, bench_samples_t *const samples)
+{
+  const uint32_t count = samples->count;
+  uint64_t *const values = samples->values;
+
+  if (count == 0)
+  {
+    return;
+  }
+
+  qsort(values, count, sizeof(values[0]), value_cmp);
+
+  printf("%s,%u,%llu,%llu,%llu,%llu\n", row, count,
+         (unsigned long long)values[count / 2], (unsigned long long)values[count * 9 / 10],
+         (unsigned long long)values[count * 99 / 100], (unsigned long long)values[count - 1]);
+
+  samples->count = 0;
+}
@@ -0,0 +1,19 @@
+#ifndef _BENCH_UTIL_H
+#define _BENCH_UTIL_H
+
+#include <stdint.h>
+
+#define BENCH_SAMPLES_MAX               4096
+
+/* Values of one metric, their percentiles are printed as CSV */
+typedef struct bench_samples_s
+{
+  uint64_t values[BENCH_SAMPLES_MAX];
+  uint32_t count;
+} bench_samples_t;
+
+uint64_t bench_host_ns_get(void);
+void bench_sample_add(bench_samples_t *const samples, uint64_t value);
+void bench_samples_print(const char *row, bench_samples_t *const samples);
+
+#endif /* _BENCH_UTIL_H */
@@ -0,0 +1,123 @@
+/* Static functions are measured too */
+#include "../ws2812_module/ws2812.c"
+#include "pwm_emu.h"
+#include "bench_util.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+/**
+ * Per pixel cost of encoding strip into PWM values, CSV rows are written to stdout.
+ *  nibble_table is @ref ws2812_chunk_encode as IRQ handler runs it for every chunk,
+ *  bit_loop is the straightforward encoding by a branch for every bit.
+ *  Pixels are random, so branches of bit_loop are mispredicted as they are on
+ *  a stream of frames. The best of runs is reported.
+ *
+ * On target a chunk must be encoded while the other one is played,
+ *  it's WS2812_CHUNK_PIXELS * 30 us.
+ */
+
+#define PIXELS_COUNT                    300
+#define PASSES_COUNT                    2000
+#define RUNS_COUNT                      5
+
+static rgb_params_t bench_pixels[PIXELS_COUNT];
+static nrf_pwm_values_common_t ref_values[WS2812_CHUNK_VALUES];
+static uint32_t rnd_state = 1;
+
+static uint32_t rnd(void)
+{
+  rnd_state = rnd_state * 1664525U + 1013904223U;
+  return rnd_state >> 8;
+}
+
+static __attribute__((noinline)) void nibble_table_run(void)
+{
+  ws2812_pixels = bench_pixels;
+  ws2812_pixels_cnt = PIXELS_COUNT;
+  ws2812_next_pixel = 0;
+
+  for (uint8_t seq_id = 0; ws2812_next_pixel < ws2812_pixels_cnt; seq_id ^= 1)
+  {
+    ws2812_chunk_encode(seq_id);
+  }
+}
+
+static inline nrf_pwm_values_common_t* byte_encode_ref(nrf_pwm_values_common_t *values, uint8_t byte)
+{
+  for (uint8_t mask = 0x80; mask != 0; mask >>= 1)
+  {
+    if (byte & mask)
+    {
+      *values++ = WS2812_CODE_1;
+    }
+    else
+    {
+      *values++ = WS2812_CODE_0;
+    }
+  }
+
+  return values;
+}
+
+static __attribute__((noinline)) void bit_loop_run(void)
+{
+  nrf_pwm_values_common_t *values = ref_values;
+
+  for (uint32_t i = 0; i < PIXELS_COUNT; i++)
+  {
+    if (i % WS2812_CHUNK_PIXELS == 0)
+    {
+      values = ref_values;
+    }
+
+    values = byte_encode_ref(values, bench_pixels[i].green);
+    values = byte_encode_ref(values, bench_pixels[i].red);
+    values = byte_encode_ref(values, bench_pixels[i].blue);
+  }
+}
+
+static void bench_print(const char *impl, void (*run)(void))
+{
+  uint64_t best_ns = UINT64_MAX;
+  uint64_t start_ns;
+
+  for (uint8_t i = 0; i < RUNS_COUNT; i++)
+  {
+    start_ns = bench_host_ns_get();
+
+    for (uint32_t pass = 0; pass < PASSES_COUNT; pass++)
+    {
+      run();
+      __asm__ volatile("" ::: "memory");
+    }
+
+    best_ns = MIN(best_ns, bench_host_ns_get() - start_ns);
+  }
+
+  printf("encode,%s,%u,%.2f\n", impl, PIXELS_COUNT * PASSES_COUNT, (double)best_ns / (PIXELS_COUNT * PASSES_COUNT));
+}
+
+int main(void)
+{
+  for (uint32_t i = 0; i < PIXELS_COUNT; i++)
+  {
+    bench_pixels[i] = (rgb_params_t){.red = rnd(), .green = rnd(), .blue = rnd()};
+  }
+
+  ws2812_init(0);
+
+  printf("case,impl,pixels,ns_per_pixel\n");
+  bench_print("nibble_table", nibble_table_run);
+  bench_print("bit_loop", bit_loop_run);
+
+  /* Both end with the same last chunk, it's read, so compiler keeps the reference */
+  if (memcmp(ws2812_buffers[((PIXELS_COUNT - 1) / WS2812_CHUNK_PIXELS) % 2], ref_values,
+             (PIXELS_COUNT - (PIXELS_COUNT - 1) / WS2812_CHUNK_PIXELS * WS2812_CHUNK_PIXELS) * WS2812_BITS_PER_PIXEL *
+             sizeof(ref_values[0])) != 0)
+  {
+    fprintf(stderr, "nibble table encoding differs from bit loop\n");
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
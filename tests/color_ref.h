@@ -0,0 +1,133 @@
+#ifndef _COLOR_REF_H
+#define _COLOR_REF_H
+
+#include "hsv_to_rgb.h"
+#include <math.h>
+
+/**
+ * Straightforward versions of optimized color code, tests check that results
+ *  are the same and benchmarks compare their speed.
+ */
+
+/**
+ * @brief hsv in [0; 255] to rgb by switch over hue region, the version before branchless one
+ */
+static inline rgb_params_t hsv8_to_rgb_ref(uint8_t hue, uint8_t saturation, uint8_t brightness)
+{
+  rgb_params_t rgb = {.red = brightness, .green = brightness, .blue = brightness};
+
+  if (saturation == 0)
+  {
+    return rgb;
+  }
+
+  uint8_t region = hue / 43;
+  uint8_t reminder = (hue - region * 43) * 6;
+  uint8_t p = (brightness * (255 - saturation)) >> 8;
+  uint8_t q = (brightness * (255 - ((saturation * reminder) >> 8))) >> 8;
+  uint8_t t = (brightness * (255 - ((saturation * (255 - reminder)) >> 8))) >> 8;
+
+  switch (region)
+  {
+  case 0:
+    rgb = (rgb_params_t){.red = brightness, .green = t, .blue = p};
+    break;
+
+  case 1:
+    rgb = (rgb_params_t){.red = q, .green = brightness, .blue = p};
+    break;
+
+  case 2:
+    rgb = (rgb_params_t){.red = p, .green = brightness, .blue = t};
+    break;
+
+  case 3:
+    rgb = (rgb_params_t){.red = p, .green = q, .blue = brightness};
+    break;
+
+  case 4:
+    rgb = (rgb_params_t){.red = t, .green = p, .blue = brightness};
+    break;
+
+  default:
+    rgb = (rgb_params_t){.red = brightness, .green = p, .blue = q};
+    break;
+  }
+
+  return rgb;
+}
+
+/**
+ * @brief rgb to hsv in [0; 360], [0; 100] ranges by textbook formulas in doubles,
+ *  rounded to the nearest value. Gray colors have hue 0
+ */
+static inline hsv_params_t hsv_ref_by_rgb(uint8_t red, uint8_t green, uint8_t blue)
+{
+  const double rgb_max = fmax(red, fmax(green, blue));
+  const double delta = rgb_max - fmin(red, fmin(green, blue));
+  hsv_params_t hsv = {.brightness = lround(rgb_max * BRIGHT_MAX_VALUE / RGB_MAX_VALUE)};
+  double hue;
+
+  if (delta == 0)
+  {
+    return hsv;
+  }
+
+  if (rgb_max == red)
+  {
+    hue = 60 * (green - blue) / delta;
+  }
+  else if (rgb_max == green)
+  {
+    hue = 60 * (blue - red) / delta + 120;
+  }
+  else
+  {
+    hue = 60 * (red - green) / delta + 240;
+  }
+
+  hsv.hue = lround(hue < 0 ? hue + HUE_MAX_VALUE : hue) % HUE_MAX_VALUE;
+  hsv.saturation = lround(delta * SAT_MAX_VALUE / rgb_max);
+  return hsv;
+}
+
+/* OKLab in doubles */
+typedef struct oklab_ref_s
+{
+  double l;
+  double a;
+  double b;
+} oklab_ref_t;
+
+/**
+ * @brief Linear rgb in [0; 1] to OKLab by matrices of https://bottosson.github.io/posts/oklab/
+ */
+static inline oklab_ref_t oklab_ref_by_rgb(double red, double green, double blue)
+{
+  const double l = cbrt(0.4122214708 * red + 0.5363325363 * green + 0.0514459929 * blue);
+  const double m = cbrt(0.2119034982 * red + 0.6806995451 * green + 0.1073969566 * blue);
+  const double s = cbrt(0.0883024619 * red + 0.2817188376 * green + 0.6299787005 * blue);
+
+  return (oklab_ref_t)
+  {
+    .l = 0.2104542553 * l + 0.7936177850 * m - 0.0040720468 * s,
+    .a = 1.9779984951 * l - 2.4285922050 * m + 0.4505937099 * s,
+    .b = 0.0259040371 * l + 0.7827717662 * m - 0.8086757660 * s,
+  };
+}
+
+/**
+ * @brief OKLab to linear rgb in [0; 1], out of gamut values aren't clamped
+ */
+static inline void rgb_ref_by_oklab(oklab_ref_t lab, double rgb[3])
+{
+  const double l = pow(lab.l + 0.3963377774 * lab.a + 0.2158037573 * lab.b, 3);
+  const double m = pow(lab.l - 0.1055613458 * lab.a - 0.0638541728 * lab.b, 3);
+  const double s = pow(lab.l - 0.0894841775 * lab.a - 1.2914855480 * lab.b, 3);
+
+  rgb[0] = 4.0767416621 * l - 3.3077115913 * m + 0.2309699292 * s;
+  rgb[1] = -1.2684380046 * l + 2.6097574011 * m - 0.3413193965 * s;
+  rgb[2] = -0.0041960863 * l - 0.7034186147 * m + 1.7076147010 * s;
+}
+
+#endif /* _COLOR_REF_H */
@@ -0,0 +1,408 @@
+#include "crash_dump.h"
+#include "cli_usb.h"
+#include "app_state.h"
+#include "app_timer.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Decodes lines of CLI "crashdump <part>" of all CRASH_DUMP_PARTS_COUNT parts,
+ *  they are read from stdin, other text around them is skipped:
+ *    crashdump_decode [firmware.out] < dump.txt
+ *  Fault status registers are split into bits, trace events and state get names.
+ *  PC and LR are resolved by addr2line with the firmware image if it's given,
+ *  so are stack words that look like return addresses. Tool is taken from
+ *  ADDR2LINE variable, arm-none-eabi-addr2line by default.
+ */
+
+#define LINE_SIZE                       256
+#define WORDS_PER_LINE                  8
+#define FILE_NAME_SIZE                  64
+#define MODE_NAME_SIZE                  24
+#define CODE_END_ADDR                   0x100000U   /* flash of nRF52840 */
+#define CODE_START_ADDR                 0x1000U     /* after MBR */
+#define FAULT_ID_SD_ASSERT              0x1U        /* NRF_FAULT_ID_* of nrf_error.h */
+#define FAULT_ID_APP_MEMACC             0x2U
+#define FAULT_ID_SDK_ERROR              0x4001U
+#define FAULT_ID_SDK_ASSERT             0x4002U
+#define CFSR_MMARVALID                  (1U << 7)
+#define CFSR_BFARVALID                  (1U << 15)
+
+typedef struct bit_name_s
+{
+  uint32_t mask;
+  const char *name;
+} bit_name_t;
+
+static const bit_name_t cfsr_bits[] =
+{
+  {1U << 0,  "IACCVIOL: instruction fetch from no-execute region"},
+  {1U << 1,  "DACCVIOL: data access violation, address in MMFAR"},
+  {1U << 3,  "MUNSTKERR: MemManage fault on exception return unstacking"},
+  {1U << 4,  "MSTKERR: MemManage fault on exception entry stacking"},
+  {1U << 5,  "MLSPERR: MemManage fault on lazy FP state preservation"},
+  {1U << 7,  "MMARVALID: MMFAR holds fault address"},
+  {1U << 8,  "IBUSERR: bus fault on instruction fetch"},
+  {1U << 9,  "PRECISERR: precise data bus error, address in BFAR"},
+  {1U << 10, "IMPRECISERR: imprecise data bus error, PC isn't the faulting one"},
+  {1U << 11, "UNSTKERR: bus fault on exception return unstacking"},
+  {1U << 12, "STKERR: bus fault on exception entry stacking, stack overflow?"},
+  {1U << 13, "LSPERR: bus fault on lazy FP state preservation"},
+  {1U << 15, "BFARVALID: BFAR holds fault address"},
+  {1U << 16, "UNDEFINSTR: undefined instruction"},
+  {1U << 17, "INVSTATE: invalid EPSR, e.g. branch to even address"},
+  {1U << 18, "INVPC: invalid EXC_RETURN on exception return"},
+  {1U << 19, "NOCP: coprocessor access, FPU isn't enabled?"},
+  {1U << 24, "UNALIGNED: unaligned access"},
+  {1U << 25, "DIVBYZERO: division by zero"},
+};
+
+static const bit_name_t hfsr_bits[] =
+{
+  {1U << 1,  "VECTTBL: bus fault on vector table read"},
+  {1U << 30, "FORCED: escalated configurable fault, see CFSR"},
+  {1U << 31, "DEBUGEVT: debug event"},
+};
+
+static const bit_name_t flag_bits[] =
+{
+  {APP_FLAG_APP_IS_RUNNING,     "app is running"},
+  {APP_FLAG_FST_CLICK_OCCURRED, "first click occurred"},
+  {APP_FLAG_BTN_PRESSED,        "button pressed"},
+  {APP_FLAG_BTN_IS_DISABLED,    "button disabled"},
+};
+
+static const char *const frame_names[WORDS_PER_LINE] = {"r0", "r1", "r2", "r3", "r12", "lr", "pc", "psr"};
+static const char *const mode_names[MODES_COUNT] = {"no change", "hue", "saturation", "brightness", "cct"};
+
+static const char *firmware_path;
+
+/**
+ * @brief Prints source line of code address, nothing is printed without firmware image
+ */
+static void addr_resolve(uint32_t addr)
+{
+  const char *tool = getenv("ADDR2LINE") != NULL ? getenv("ADDR2LINE") : "arm-none-eabi-addr2line";
+  char cmd[LINE_SIZE + FILE_NAME_SIZE];
+  char line[LINE_SIZE];
+  FILE *pipe;
+
+  if (firmware_path == NULL)
+  {
+    printf("\n");
+    return;
+  }
+
+  /* Thumb bit of return address isn't a part of it */
+  snprintf(cmd, sizeof(cmd), "%s -f -p -C -e '%s' 0x%08" PRIX32, tool, firmware_path, addr & ~1U);
+  pipe = popen(cmd, "r");
+
+  if (pipe == NULL || fgets(line, sizeof(line), pipe) == NULL)
+  {
+    printf("  (%s failed)\n", tool);
+  }
+  else
+  {
+    printf("  %s", line);
+  }
+
+  if (pipe != NULL)
+  {
+    pclose(pipe);
+  }
+}
+
+static void bits_print(const char *title, uint32_t value, const bit_name_t *bits, uint8_t count)
+{
+  printf("%s %08" PRIX32 "\n", title, value);
+
+  for (uint8_t i = 0; i < count; i++)
+  {
+    if ((value & bits[i].mask) != 0)
+    {
+      printf("  %s\n", bits[i].name);
+    }
+  }
+}
+
+static const char* fault_id_name(uint32_t fault_id)
+{
+  switch (fault_id)
+  {
+    case 0:
+      return "hard fault";
+
+    case FAULT_ID_SD_ASSERT:
+      return "SoftDevice assert";
+
+    case FAULT_ID_APP_MEMACC:
+      return "SoftDevice memory access violation";
+
+    case FAULT_ID_SDK_ERROR:
+      return "APP_ERROR_CHECK";
+
+    case FAULT_ID_SDK_ASSERT:
+      return "ASSERT";
+
+    default:
+      return "unknown fault";
+  }
+}
+
+static const char* mode_name(unsigned int mode, char *buf, size_t size)
+{
+  if (mode < MODES_COUNT)
+  {
+    return mode_names[mode];
+  }
+
+  snprintf(buf, size, "effect %u", mode - MODES_COUNT);
+  return buf;
+}
+
+/**
+ * @return count of hex words after title
+ */
+static uint8_t words_parse(const char *text, uint32_t *words)
+{
+  uint8_t count = 0;
+  int len;
+
+  while (count < WORDS_PER_LINE && sscanf(text, " %" SCNx32 "%n", &words[count], &len) == 1)
+  {
+    text += len;
+    count++;
+  }
+
+  return count;
+}
+
+static void summary_decode(const char *text)
+{
+  char file[FILE_NAME_SIZE] = "";
+  unsigned int crashes;
+  unsigned int line = 0;
+  uint32_t fault_id;
+  uint32_t pc;
+  uint32_t err;
+
+  if (sscanf(text, "Crashes %u, last: id %" SCNx32 " pc %" SCNx32 " err %" SCNx32 " %63[^:\n]:%u",
+             &crashes, &fault_id, &pc, &err, file, &line) < 4)
+  {
+    printf("Summary isn't decoded: %s", text);
+    return;
+  }
+
+  printf("Crashes: %u, the last one is %s", crashes, fault_id_name(fault_id));
+
+  if (fault_id != 0)
+  {
+    printf(", error 0x%" PRIX32 " at %s:%u", err, file, line);
+  }
+
+  printf("\nFault PC %08" PRIX32, pc);
+  addr_resolve(pc);
+}
+
+static void frame_decode(const char *text)
+{
+  uint32_t words[WORDS_PER_LINE];
+  const uint8_t count = words_parse(text + strlen("Frame:"), words);
+
+  printf("Stacked frame:\n");
+
+  for (uint8_t i = 0; i < count; i++)
+  {
+    printf("  %-4s %08" PRIX32, frame_names[i], words[i]);
+
+    if (!strcmp(frame_names[i], "lr") || !strcmp(frame_names[i], "pc"))
+    {
+      addr_resolve(words[i]);
+    }
+    else
+    {
+      printf("\n");
+    }
+  }
+}
+
+static void fault_status_decode(const char *text)
+{
+  uint32_t cfsr;
+  uint32_t hfsr;
+  uint32_t mmfar;
+  uint32_t bfar;
+  uint32_t sp;
+
+  if (sscanf(text, "CFSR %" SCNx32 " HFSR %" SCNx32 " MMFAR %" SCNx32 " BFAR %" SCNx32 " SP %" SCNx32,
+             &cfsr, &hfsr, &mmfar, &bfar, &sp) != 5)
+  {
+    printf("Fault status isn't decoded: %s", text);
+    return;
+  }
+
+  bits_print("CFSR", cfsr, cfsr_bits, ARRAY_SIZE(cfsr_bits));
+  bits_print("HFSR", hfsr, hfsr_bits, ARRAY_SIZE(hfsr_bits));
+  printf("MMFAR %08" PRIX32 "%s\n", mmfar, (cfsr & CFSR_MMARVALID) ? "" : " (not valid)");
+  printf("BFAR  %08" PRIX32 "%s\n", bfar, (cfsr & CFSR_BFARVALID) ? "" : " (not valid)");
+  printf("SP    %08" PRIX32 "\n", sp);
+}
+
+static void stack_decode(const char *text)
+{
+  uint32_t words[WORDS_PER_LINE];
+  unsigned int offset;
+  uint8_t count;
+  int len;
+
+  if (sscanf(text, "SP+%u:%n", &offset, &len) != 1)
+  {
+    return;
+  }
+
+  count = words_parse(text + len, words);
+
+  for (uint8_t i = 0; i < count; i++)
+  {
+    printf("  SP+%02u %08" PRIX32, offset + i * (unsigned int)sizeof(uint32_t), words[i]);
+
+    /* Return addresses are odd, they point to Thumb code */
+    if ((words[i] & 1U) != 0 && words[i] >= CODE_START_ADDR && words[i] < CODE_END_ADDR)
+    {
+      addr_resolve(words[i]);
+    }
+    else
+    {
+      printf("\n");
+    }
+  }
+}
+
+static void trace_decode(const char *text)
+{
+  char buf[MODE_NAME_SIZE];
+  unsigned int ticks;
+  unsigned int event;
+  unsigned int value;
+  int len;
+
+  text += strlen("Trace:");
+
+  while (sscanf(text, " %x:%u:%u%n", &ticks, &event, &value, &len) == 3)
+  {
+    text += len;
+
+    if (event == CRASH_TRACE_NONE)
+    {
+      continue;
+    }
+
+    printf("  %10.3f s  ", (double)ticks / APP_TIMER_CLOCK_FREQ);
+
+    switch (event)
+    {
+      case CRASH_TRACE_CLI_CMD:
+        printf("CLI command %s\n", value < NO_CMD ? cmd_list[value] : "unknown");
+        break;
+
+      case CRASH_TRACE_BTN:
+        printf("button %s\n", value ? "pressed" : "released");
+        break;
+
+      case CRASH_TRACE_LED_MODE:
+        printf("LED mode %s\n", mode_name(value, buf, sizeof(buf)));
+        break;
+
+      default:
+        printf("event %u value %u\n", event, value);
+        break;
+    }
+  }
+}
+
+static void state_decode(const char *text)
+{
+  char buf[MODE_NAME_SIZE];
+  unsigned int hue;
+  unsigned int sat;
+  unsigned int bright;
+  unsigned int mode;
+  unsigned int dirs;
+  uint32_t flags;
+
+  if (sscanf(text, "State: hsv %u,%u,%u mode %u dirs %x flags %" SCNx32, &hue, &sat, &bright, &mode, &dirs, &flags) != 6)
+  {
+    printf("State isn't decoded: %s", text);
+    return;
+  }
+
+  printf("State: hsv %u %u %u, LED mode %s\n", hue, sat, bright, mode_name(mode, buf, sizeof(buf)));
+
+  for (uint8_t i = HUE_CHANGE; i < MODES_COUNT; i++)
+  {
+    printf("  %s counts %s\n", mode_names[i], (dirs & (1U << i)) ? "down" : "up");
+  }
+
+  bits_print("Flags", flags, flag_bits, ARRAY_SIZE(flag_bits));
+}
+
+int main(int argc, char *argv[])
+{
+  static const struct
+  {
+    const char *title;
+    void (*decode)(const char *text);
+  } parts[] =
+  {
+    {"Crashes ", summary_decode},
+    {"Frame:", frame_decode},
+    {"CFSR ", fault_status_decode},
+    {"SP+", stack_decode},
+    {"Trace:", trace_decode},
+    {"State:", state_decode},
+  };
+  char line[LINE_SIZE];
+  const char *text;
+  bool has_stack = false;
+  bool has_trace = false;
+
+  if (argc > 2)
+  {
+    fprintf(stderr, "usage: %s [firmware.out] < crashdump lines\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  firmware_path = argc == 2 ? argv[1] : NULL;
+
+  while (fgets(line, sizeof(line), stdin) != NULL)
+  {
+    for (uint8_t i = 0; i < ARRAY_SIZE(parts); i++)
+    {
+      text = strstr(line, parts[i].title);
+
+      if (text == NULL)
+      {
+        continue;
+      }
+
+      /* Titles of continued parts are printed once */
+      if (parts[i].decode == stack_decode && !has_stack)
+      {
+        printf("Stack:\n");
+        has_stack = true;
+      }
+      else if (parts[i].decode == trace_decode && !has_trace)
+      {
+        printf("Trace, the oldest event first:\n");
+        has_trace = true;
+      }
+
+      parts[i].decode(text);
+      break;
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,448 @@
+#include "nvmc_emu.h"
+#include "nrf_nvmc.h"
+#include "nrfx_nvmc.h"
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+
+#define NVMC_EMU_PAGE_WORDS             (CODE_PAGE_SIZE / sizeof(uint32_t))
+#define NVMC_EMU_WORDS_CNT              (NVMC_EMU_PAGES_CNT * NVMC_EMU_PAGE_WORDS)
+#define NVMC_EMU_ERASED_WORD            0xFFFFFFFFU
+
+/* RAM of emulated MCU is the whole .data and .bss of test program, symbols of GNU linker and glibc */
+extern char __data_start[];
+extern char _end[];
+
+#define NVMC_EMU_RAM_SIZE               ((size_t)((uintptr_t)_end - (uintptr_t)__data_start))
+
+/* Lives on heap as flash itself, so it survives boots */
+typedef struct nvmc_emu_s
+{
+  uint32_t cells[NVMC_EMU_WORDS_CNT];     /* programmed state, flash mapping is synced to it */
+  uint8_t writes[NVMC_EMU_WORDS_CNT];     /* writes of every word since its page was erased */
+  nvmc_emu_stats_t stats;
+} nvmc_emu_t;
+
+NRF_NVMC_Type nvmc_emu_regs;
+
+static volatile uint32_t *const flash = (volatile uint32_t*)(uintptr_t)NVMC_EMU_START_ADDR;
+static nvmc_emu_t *emu;
+static uint8_t *ram_image;                /* RAM at the first boot, it's restored on every boot */
+static jmp_buf power_cut_jmp;
+
+/* State of MCU, it's lost on power cut */
+static int64_t boot_cut_op = NVMC_EMU_NO_CUT;
+static uint64_t boot_ops;
+static uint32_t rnd_state = 1;
+static uint32_t next_store_index;         /* firmware writes words one by one */
+static uint32_t partial_erase_addr;
+static uint32_t partial_erase_steps_done;
+static uint32_t partial_erase_steps_cnt;        /* 0 if partial erase isn't started */
+static uint32_t partial_erase_step_us;
+
+static void emu_fail(const char *fmt, ...)
+{
+  va_list args;
+
+  va_start(args, fmt);
+  fprintf(stderr, "nvmc_emu: ");
+  vfprintf(stderr, fmt, args);
+  fprintf(stderr, " at operation %llu of boot", (unsigned long long)boot_ops);
+  fprintf(stderr, boot_cut_op != NVMC_EMU_NO_CUT ? " that is cut at %lld\n" : "\n", (long long)boot_cut_op);
+  va_end(args);
+
+  abort();
+}
+
+static uint32_t rnd(void)
+{
+  rnd_state ^= rnd_state << 13;
+  rnd_state ^= rnd_state >> 17;
+  rnd_state ^= rnd_state << 5;
+
+  return rnd_state;
+}
+
+static uint32_t word_index_get(uint32_t addr)
+{
+  if (addr < NVMC_EMU_START_ADDR || addr >= NVMC_EMU_END_ADDR || (addr & (sizeof(uint32_t) - 1)) != 0)
+  {
+    emu_fail("address 0x%08X isn't a word of emulated flash", addr);
+  }
+
+  return (addr - NVMC_EMU_START_ADDR) / sizeof(uint32_t);
+}
+
+static uint32_t page_index_get(uint32_t addr)
+{
+  if ((addr & (CODE_PAGE_SIZE - 1)) != 0)
+  {
+    emu_fail("address 0x%08X isn't a page start", addr);
+  }
+
+  return word_index_get(addr) / NVMC_EMU_PAGE_WORDS;
+}
+
+/**
+ * @brief Counts operation. Power is cut before the operation that has number of cut,
+ *  its result is left partial by caller.
+ *
+ * @return true if power is cut now
+ */
+static bool op_is_cut(void)
+{
+  if (boot_cut_op != NVMC_EMU_NO_CUT && boot_ops == (uint64_t)boot_cut_op)
+  {
+    return true;
+  }
+
+  boot_ops++;
+  emu->stats.ops++;
+
+  return false;
+}
+
+static void power_cut(void)
+{
+  longjmp(power_cut_jmp, 1);
+}
+
+/**
+ * @brief Erase sets bits of page to 1 over its whole time, so erase that is stopped
+ *  leaves random mix of data and ones. Page reads as erased when erase is nearly done,
+ *  but it isn't erased enough to be written until the whole erase time has passed.
+ *
+ * @param done part of erase time that has passed, of total
+ */
+static void page_erase_progress(uint32_t page, uint32_t done, uint32_t total)
+{
+  uint32_t random = 0;
+  uint32_t ones;
+
+  for (uint32_t i = page * NVMC_EMU_PAGE_WORDS; i < (page + 1) * NVMC_EMU_PAGE_WORDS; i++)
+  {
+    ones = 0;
+
+    for (uint32_t bit = 0; bit < 32; bit++)
+    {
+      random = (bit & 3) == 0 ? rnd() : random >> 8;
+      ones |= (random & 0xFF) * total < done * 0x100 ? 1U << bit : 0;
+    }
+
+    emu->cells[i] |= ones;
+    flash[i] = emu->cells[i];
+  }
+}
+
+static void page_erase_complete(uint32_t page)
+{
+  for (uint32_t i = page * NVMC_EMU_PAGE_WORDS; i < (page + 1) * NVMC_EMU_PAGE_WORDS; i++)
+  {
+    emu->cells[i] = NVMC_EMU_ERASED_WORD;
+    emu->writes[i] = 0;
+    flash[i] = NVMC_EMU_ERASED_WORD;
+  }
+}
+
+/**
+ * @brief Partial erase that isn't continued leaves its page partially erased.
+ */
+static void partial_erase_stop(void)
+{
+  if (partial_erase_steps_cnt != 0)
+  {
+    page_erase_progress(page_index_get(partial_erase_addr), partial_erase_steps_done, partial_erase_steps_cnt);
+    partial_erase_steps_cnt = 0;
+  }
+}
+
+static void word_program(uint32_t index, uint32_t value)
+{
+  bool is_cut;
+
+  if (partial_erase_steps_cnt != 0 && index / NVMC_EMU_PAGE_WORDS == page_index_get(partial_erase_addr))
+  {
+    partial_erase_stop();
+  }
+
+  is_cut = op_is_cut();
+
+  if (emu->writes[index] >= NVMC_EMU_WRITES_MAX)
+  {
+    emu_fail("word 0x%08X is written more than %d times after erase",
+             NVMC_EMU_START_ADDR + index * sizeof(uint32_t), NVMC_EMU_WRITES_MAX);
+  }
+
+  /* Interrupted write leaves some of its bits unprogrammed */
+  emu->cells[index] &= is_cut ? value | rnd() : value;
+  emu->writes[index]++;
+  flash[index] = emu->cells[index];
+
+  if (is_cut)
+  {
+    power_cut();
+  }
+
+  emu->stats.words_written++;
+  emu->stats.busy_us += NVMC_EMU_WORD_WRITE_US;
+  next_store_index = index + 1;
+}
+
+static void word_store_sync(uint32_t index)
+{
+  if (nvmc_emu_regs.CONFIG != NRF_NVMC_MODE_WRITE)
+  {
+    emu_fail("word 0x%08X is stored while NVMC isn't in write mode", NVMC_EMU_START_ADDR + index * sizeof(uint32_t));
+  }
+
+  word_program(index, flash[index]);
+}
+
+/**
+ * @brief Words stored by pointer are found by comparison of flash mapping with cells.
+ *  It's done before every mode change and driver call, so a store is
+ *  programmed in the NVMC mode it was done in.
+ */
+static void stores_sync(void)
+{
+  for (uint32_t page = 0; page < NVMC_EMU_PAGES_CNT; page++)
+  {
+    if (!memcmp((const void*)&flash[page * NVMC_EMU_PAGE_WORDS], &emu->cells[page * NVMC_EMU_PAGE_WORDS], CODE_PAGE_SIZE))
+    {
+      continue;
+    }
+
+    for (uint32_t i = page * NVMC_EMU_PAGE_WORDS; i < (page + 1) * NVMC_EMU_PAGE_WORDS; i++)
+    {
+      if (flash[i] != emu->cells[i])
+      {
+        word_store_sync(i);
+      }
+    }
+  }
+}
+
+/**
+ * @brief Firmware waits for ready before every store, so a word that follows
+ *  the previous one is usually the only store since the last wait.
+ *  Other stores are found by the whole comparison then or on mode change.
+ */
+static void next_store_sync(void)
+{
+  if (next_store_index < NVMC_EMU_WORDS_CNT && flash[next_store_index] != emu->cells[next_store_index])
+  {
+    word_store_sync(next_store_index);
+    return;
+  }
+
+  stores_sync();
+}
+
+void nrf_nvmc_mode_set(NRF_NVMC_Type *p_reg, nrf_nvmc_mode_t mode)
+{
+  stores_sync();
+
+  if (mode == NRF_NVMC_MODE_WRITE && p_reg->CONFIG != NRF_NVMC_MODE_WRITE)
+  {
+    emu->stats.write_sessions++;
+  }
+
+  p_reg->CONFIG = mode;
+}
+
+bool nrf_nvmc_ready_check(NRF_NVMC_Type const *p_reg)
+{
+  next_store_sync();
+
+  return p_reg->READY != 0;
+}
+
+nrfx_err_t nrfx_nvmc_page_erase(uint32_t address)
+{
+  const uint32_t page = page_index_get(address);
+
+  stores_sync();
+  partial_erase_stop();
+
+  if (op_is_cut())
+  {
+    page_erase_progress(page, rnd() % NVMC_EMU_PAGE_ERASE_US, NVMC_EMU_PAGE_ERASE_US);
+    power_cut();
+  }
+
+  page_erase_complete(page);
+
+  emu->stats.pages_erased++;
+  emu->stats.busy_us += NVMC_EMU_PAGE_ERASE_US;
+
+  return NRFX_SUCCESS;
+}
+
+/**
+ * @brief Steps don't change page until the last one, power cut or start of other erase
+ *  leaves it partially erased.
+ */
+nrfx_err_t nrfx_nvmc_page_partial_erase_init(uint32_t address, uint32_t duration_ms)
+{
+  stores_sync();
+
+  if (duration_ms == 0)
+  {
+    emu_fail("partial erase of 0 ms");
+  }
+
+  partial_erase_stop();
+  page_index_get(address);
+
+  partial_erase_addr = address;
+  partial_erase_step_us = duration_ms * 1000;
+  partial_erase_steps_done = 0;
+  partial_erase_steps_cnt = (NVMC_EMU_PAGE_ERASE_US + partial_erase_step_us - 1) / partial_erase_step_us;
+
+  return NRFX_SUCCESS;
+}
+
+bool nrfx_nvmc_page_partial_erase_continue(void)
+{
+  uint32_t page;
+
+  stores_sync();
+
+  if (partial_erase_steps_cnt == 0)
+  {
+    emu_fail("partial erase isn't started");
+  }
+
+  page = page_index_get(partial_erase_addr);
+
+  if (op_is_cut())
+  {
+    page_erase_progress(page, partial_erase_steps_done + 1, partial_erase_steps_cnt);
+    power_cut();
+  }
+
+  emu->stats.erase_steps++;
+  emu->stats.busy_us += partial_erase_step_us;
+
+  if (++partial_erase_steps_done < partial_erase_steps_cnt)
+  {
+    return false;
+  }
+
+  page_erase_complete(page);
+  partial_erase_steps_cnt = 0;
+
+  return true;
+}
+
+void nrfx_nvmc_word_write(uint32_t address, uint32_t value)
+{
+  nrfx_nvmc_words_write(address, &value, 1);
+}
+
+/**
+ * @brief Driver switches NVMC to write mode and back around every call
+ */
+void nrfx_nvmc_words_write(uint32_t address, void const *src, uint32_t num_words)
+{
+  uint32_t value;
+
+  stores_sync();
+
+  nvmc_emu_regs.CONFIG = NRF_NVMC_MODE_WRITE;
+  emu->stats.write_sessions++;
+
+  for (uint32_t i = 0; i < num_words; i++)
+  {
+    memcpy(&value, (const uint8_t*)src + i * sizeof(uint32_t), sizeof(value));
+    word_program(word_index_get(address + i * sizeof(uint32_t)), value);
+  }
+
+  nvmc_emu_regs.CONFIG = NRF_NVMC_MODE_READONLY;
+}
+
+/**
+ * @brief Maps erased flash at its address, call it once before any other function.
+ */
+void nvmc_emu_init(void)
+{
+  void *mem = mmap((void*)flash, NVMC_EMU_WORDS_CNT * sizeof(uint32_t), PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+
+  if (mem != (void*)flash)
+  {
+    fprintf(stderr, "nvmc_emu: flash can't be mapped at 0x%08X\n", NVMC_EMU_START_ADDR);
+    exit(EXIT_FAILURE);
+  }
+
+  emu = calloc(1, sizeof(*emu));
+  ram_image = malloc(NVMC_EMU_RAM_SIZE);
+
+  if (emu == NULL || ram_image == NULL)
+  {
+    fprintf(stderr, "nvmc_emu: no memory\n");
+    exit(EXIT_FAILURE);
+  }
+
+  nvmc_emu_regs.READY = 1;
+  nvmc_emu_erase_all();
+}
+
+void nvmc_emu_erase_all(void)
+{
+  for (uint32_t page = 0; page < NVMC_EMU_PAGES_CNT; page++)
+  {
+    page_erase_complete(page);
+  }
+
+  nvmc_emu_stats_reset();
+}
+
+/**
+ * @brief Boots firmware with RAM that the program had at the first boot: all
+ *  variables of .data and .bss are restored, of test too. State that must survive
+ *  boots is kept on heap. Flash is kept, stats are counted for all boots.
+ *
+ * @param firmware runs until its return or power cut
+ * @param cut_op number of operation of this boot that is cut, NVMC_EMU_NO_CUT to run until return
+ * @param seed of interrupted operations result
+ */
+nvmc_emu_boot_result_t nvmc_emu_boot(void (*firmware)(void), int64_t cut_op, uint32_t seed)
+{
+  static bool is_ram_saved = false;
+
+  if (!is_ram_saved)
+  {
+    is_ram_saved = true;
+    memcpy(ram_image, __data_start, NVMC_EMU_RAM_SIZE);
+  }
+
+  memcpy(__data_start, ram_image, NVMC_EMU_RAM_SIZE);
+
+  boot_cut_op = cut_op;
+  rnd_state = seed != 0 ? seed : 1;
+
+  if (setjmp(power_cut_jmp) != 0)
+  {
+    return NVMC_EMU_BOOT_CUT;
+  }
+
+  firmware();
+  stores_sync();
+
+  return NVMC_EMU_BOOT_DONE;
+}
+
+nvmc_emu_stats_t nvmc_emu_stats_get(void)
+{
+  stores_sync();
+
+  return emu->stats;
+}
+
+void nvmc_emu_stats_reset(void)
+{
+  memset(&emu->stats, 0, sizeof(emu->stats));
+}
@@ -0,0 +1,54 @@
+#ifndef _NVMC_EMU_H
+#define _NVMC_EMU_H
+
+#include "nrfx.h"
+#include "nvmc_module.h"
+
+/**
+ * NOR flash of nRF52840 behind NVMC for host tests. The crash page and the whole
+ *  app data area are mapped at their real addresses, so modules read and write
+ *  them by pointers as on target. Programming only clears bits, a word can be
+ *  written NVMC_EMU_WRITES_MAX times between erases, and words are written only
+ *  in write mode, otherwise the test is aborted.
+ *
+ * Every word write, page erase and step of partial erase is one operation.
+ *  Power is cut by number of operation: the word is programmed partially
+ *  or the page is erased partially, and the emulated MCU is stopped.
+ *  Flash survives the cut, RAM doesn't: @ref nvmc_emu_boot restores
+ *  variables of the program before it runs firmware again.
+ */
+
+#define NVMC_EMU_START_ADDR             NVMC_CRASH_PAGE_ADDR
+#define NVMC_EMU_END_ADDR               NVMC_END_APP_DATA_ADDR
+#define NVMC_EMU_PAGES_CNT              ((NVMC_EMU_END_ADDR - NVMC_EMU_START_ADDR) / CODE_PAGE_SIZE)
+
+/* Timings and limits of nRF52840 product specification */
+#define NVMC_EMU_WORD_WRITE_US          41      /* t_WRITE */
+#define NVMC_EMU_PAGE_ERASE_US          85000   /* t_ERASEPAGE */
+#define NVMC_EMU_WRITES_MAX             2       /* n_WRITE */
+
+#define NVMC_EMU_NO_CUT                 (-1)
+
+typedef enum nvmc_emu_boot_result_e
+{
+  NVMC_EMU_BOOT_DONE,             /* firmware returned */
+  NVMC_EMU_BOOT_CUT,              /* power was cut */
+} nvmc_emu_boot_result_t;
+
+typedef struct nvmc_emu_stats_s
+{
+  uint64_t ops;                   /* word writes, page erases and steps of partial erase */
+  uint64_t words_written;
+  uint64_t pages_erased;          /* blocking erases */
+  uint64_t erase_steps;
+  uint64_t busy_us;               /* NVMC busy time of the operations */
+  uint64_t write_sessions;        /* switches of NVMC to write mode */
+} nvmc_emu_stats_t;
+
+void nvmc_emu_init(void);
+void nvmc_emu_erase_all(void);
+nvmc_emu_boot_result_t nvmc_emu_boot(void (*firmware)(void), int64_t cut_op, uint32_t seed);
+nvmc_emu_stats_t nvmc_emu_stats_get(void);
+void nvmc_emu_stats_reset(void);
+
+#endif /* _NVMC_EMU_H */
@@ -0,0 +1,207 @@
+#include "pwm_emu.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define PWM_EMU_POLARITY_FALLING        0x8000U   /* output is high from start of period to compare */
+#define PWM_EMU_COMPARE_MASK            0x7FFFU
+#define PWM_EMU_BASE_TICK_NS            62.5      /* of 16 MHz clock */
+
+static nrfx_pwm_config_t emu_config;
+static nrfx_pwm_handler_t emu_handler;
+static bool emu_is_inited = false;
+
+/* Registers of sequences, EasyDMA reads them when sequence is started */
+static nrf_pwm_sequence_t emu_sequences[2];
+
+static uint16_t emu_loops_left;
+static uint32_t emu_flags;
+static bool emu_is_playing = false;
+
+static pwm_emu_output_t emu_output;
+
+static void emu_fail(const char *fmt, ...)
+{
+  va_list args;
+
+  va_start(args, fmt);
+  fprintf(stderr, "pwm_emu: ");
+  vfprintf(stderr, fmt, args);
+  fprintf(stderr, "\n");
+  va_end(args);
+
+  abort();
+}
+
+/**
+ * @brief Starts sequence: its values are recorded as EasyDMA loads them
+ */
+static void sequence_play(uint8_t seq_id)
+{
+  const nrf_pwm_sequence_t *seq = &emu_sequences[seq_id];
+  pwm_emu_part_t *part;
+
+  if (seq->length == 0 || seq->values.p_common == NULL)
+  {
+    emu_fail("sequence %u is empty", seq_id);
+  }
+
+  if (emu_output.parts_cnt == PWM_EMU_PARTS_MAX || emu_output.values_cnt + seq->length > PWM_EMU_VALUES_MAX)
+  {
+    emu_fail("output is full, %u parts, %u values", emu_output.parts_cnt, emu_output.values_cnt);
+  }
+
+  part = &emu_output.parts[emu_output.parts_cnt++];
+  *part = (pwm_emu_part_t)
+  {
+    .seq_id = seq_id,
+    .offset = emu_output.values_cnt,
+    .length = seq->length,
+    .repeats = seq->repeats,
+    .end_delay = seq->end_delay
+  };
+
+  memcpy(&emu_output.values[emu_output.values_cnt], seq->values.p_common, seq->length * sizeof(uint16_t));
+  emu_output.values_cnt += seq->length;
+  emu_output.periods += (uint64_t)seq->length * (seq->repeats + 1) + seq->end_delay;
+}
+
+static void event_signal(nrfx_pwm_evt_type_t event_type, uint32_t flag)
+{
+  if ((emu_flags & flag) != 0)
+  {
+    emu_handler(event_type);
+  }
+}
+
+nrfx_err_t nrfx_pwm_init(nrfx_pwm_t const *p_instance, nrfx_pwm_config_t const *p_config,
+                         nrfx_pwm_handler_t handler)
+{
+  UNUSED_PARAMETER(p_instance);
+
+  if (p_config->count_mode != NRF_PWM_MODE_UP || p_config->load_mode != NRF_PWM_LOAD_COMMON ||
+      p_config->step_mode != NRF_PWM_STEP_AUTO || p_config->top_value == 0 ||
+      p_config->top_value > PWM_EMU_COMPARE_MASK)
+  {
+    emu_fail("config isn't supported");
+  }
+
+  emu_config = *p_config;
+  emu_handler = handler;
+  emu_is_inited = true;
+
+  return NRFX_SUCCESS;
+}
+
+void nrfx_pwm_sequence_update(nrfx_pwm_t const *p_instance, uint8_t seq_id, nrf_pwm_sequence_t const *p_sequence)
+{
+  UNUSED_PARAMETER(p_instance);
+
+  if (seq_id >= ARRAY_SIZE(emu_sequences))
+  {
+    emu_fail("sequence %u doesn't exist", seq_id);
+  }
+
+  emu_sequences[seq_id] = *p_sequence;
+}
+
+uint32_t nrfx_pwm_complex_playback(nrfx_pwm_t const *p_instance, nrf_pwm_sequence_t const *p_sequence_0,
+                                   nrf_pwm_sequence_t const *p_sequence_1, uint16_t playback_count, uint32_t flags)
+{
+  if (!emu_is_inited || emu_is_playing)
+  {
+    emu_fail(emu_is_playing ? "playback is started while playing" : "driver isn't inited");
+  }
+
+  if (playback_count == 0 || (flags & (NRFX_PWM_FLAG_LOOP | NRFX_PWM_FLAG_START_VIA_TASK)) != 0)
+  {
+    emu_fail("only finite playback started at once is emulated");
+  }
+
+  nrfx_pwm_sequence_update(p_instance, 0, p_sequence_0);
+  nrfx_pwm_sequence_update(p_instance, 1, p_sequence_1);
+
+  emu_loops_left = playback_count;
+  emu_flags = flags;
+  emu_is_playing = true;
+  emu_output.playbacks++;
+
+  return 0;
+}
+
+/**
+ * @brief Clears output, driver config is kept
+ */
+void pwm_emu_reset(void)
+{
+  if (emu_is_playing)
+  {
+    emu_fail("output is reset while playing");
+  }
+
+  memset(&emu_output, 0, sizeof(emu_output));
+}
+
+bool pwm_emu_is_playing(void)
+{
+  return emu_is_playing;
+}
+
+/**
+ * @brief Plays started playback to the end, handler is called for every event as on target
+ */
+void pwm_emu_run(void)
+{
+  if (!emu_is_playing)
+  {
+    return;
+  }
+
+  sequence_play(0);
+
+  while (emu_loops_left > 0)
+  {
+    /* The other sequence is already playing when END_SEQ event is handled */
+    sequence_play(1);
+    event_signal(NRFX_PWM_EVT_END_SEQ0, NRFX_PWM_FLAG_SIGNAL_END_SEQ0);
+
+    if (--emu_loops_left > 0)
+    {
+      sequence_play(0);
+    }
+
+    event_signal(NRFX_PWM_EVT_END_SEQ1, NRFX_PWM_FLAG_SIGNAL_END_SEQ1);
+  }
+
+  emu_is_playing = false;
+
+  if ((emu_flags & NRFX_PWM_FLAG_NO_EVT_FINISHED) == 0)
+  {
+    emu_handler(NRFX_PWM_EVT_FINISHED);
+  }
+}
+
+const pwm_emu_output_t* pwm_emu_output_get(void)
+{
+  return &emu_output;
+}
+
+/**
+ * @return ticks of period the output is high for, in up counting mode
+ */
+uint32_t pwm_emu_high_ticks(uint16_t value)
+{
+  const uint32_t compare = MIN(value & PWM_EMU_COMPARE_MASK, emu_config.top_value);
+
+  return (value & PWM_EMU_POLARITY_FALLING) ? compare : emu_config.top_value - compare;
+}
+
+double pwm_emu_tick_ns(void)
+{
+  return PWM_EMU_BASE_TICK_NS * (1U << emu_config.base_clock);
+}
+
+uint16_t pwm_emu_top_value(void)
+{
+  return emu_config.top_value;
+}
@@ -0,0 +1,48 @@
+#ifndef _PWM_EMU_H
+#define _PWM_EMU_H
+
+#include "nrfx_pwm.h"
+
+/**
+ * PWM peripheral of nRF52840 behind nrfx_pwm driver for host tests.
+ *  Playback doesn't run by itself: @ref pwm_emu_run plays sequences one by one
+ *  and calls the driver handler after every one of them as IRQ does on target.
+ *  The next sequence is started by EasyDMA before handler of the previous one
+ *  is called, so its registers and values are taken at that moment.
+ *
+ * Played values and parts are recorded, common load mode and auto step are
+ *  supported only, and a value is one PWM period of top value ticks.
+ */
+
+#define PWM_EMU_VALUES_MAX              16384
+#define PWM_EMU_PARTS_MAX               256
+
+/* Sequence as it was played */
+typedef struct pwm_emu_part_s
+{
+  uint8_t seq_id;
+  uint32_t offset;                /* of the first value in @ref pwm_emu_output_t */
+  uint16_t length;
+  uint32_t repeats;
+  uint32_t end_delay;             /* periods the last value is kept after sequence */
+} pwm_emu_part_t;
+
+typedef struct pwm_emu_output_s
+{
+  uint16_t values[PWM_EMU_VALUES_MAX];
+  uint32_t values_cnt;
+  pwm_emu_part_t parts[PWM_EMU_PARTS_MAX];
+  uint32_t parts_cnt;
+  uint64_t periods;               /* of all parts including repeats and end delays */
+  uint32_t playbacks;
+} pwm_emu_output_t;
+
+void pwm_emu_reset(void);
+bool pwm_emu_is_playing(void);
+void pwm_emu_run(void);
+const pwm_emu_output_t* pwm_emu_output_get(void);
+uint32_t pwm_emu_high_ticks(uint16_t value);
+double pwm_emu_tick_ns(void);
+uint16_t pwm_emu_top_value(void);
+
+#endif /* _PWM_EMU_H */
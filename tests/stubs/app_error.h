@@ -0,0 +1,10 @@
+#ifndef _STUB_APP_ERROR_H
+#define _STUB_APP_ERROR_H
+
+#include <assert.h>
+#include "nrfx.h"
+
+#define APP_ERROR_CHECK(err_code)       assert((err_code) == NRF_SUCCESS)
+#define APP_ERROR_CHECK_BOOL(value)     assert(value)
+
+#endif /* _STUB_APP_ERROR_H */
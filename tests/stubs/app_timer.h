@@ -0,0 +1,16 @@
+#ifndef _STUB_APP_TIMER_H
+#define _STUB_APP_TIMER_H
+
+#include "nrfx.h"
+
+#define APP_TIMER_CLOCK_FREQ            16384           /* APP_TIMER_CONFIG_RTC_FREQUENCY 1 of sdk_config.h */
+#define APP_TIMER_TICKS(ms)             ((uint32_t)(((uint64_t)(ms) * APP_TIMER_CLOCK_FREQ) / 1000))
+#define APP_TIMER_CNT_MASK              0x00FFFFFFU     /* RTC counter is 24 bit */
+
+/* Counter of RTC, tests move time forward by it */
+extern uint32_t app_timer_stub_cnt;
+
+uint32_t app_timer_cnt_get(void);
+uint32_t app_timer_cnt_diff_compute(uint32_t ticks_to, uint32_t ticks_from);
+
+#endif /* _STUB_APP_TIMER_H */
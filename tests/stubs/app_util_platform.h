@@ -0,0 +1,9 @@
+#ifndef _STUB_APP_UTIL_PLATFORM_H
+#define _STUB_APP_UTIL_PLATFORM_H
+
+#include "nrfx.h"
+
+#define CRITICAL_REGION_ENTER()         {
+#define CRITICAL_REGION_EXIT()          }
+
+#endif /* _STUB_APP_UTIL_PLATFORM_H */
@@ -0,0 +1,8 @@
+#ifndef _STUB_CRC16_H
+#define _STUB_CRC16_H
+
+#include "nrfx.h"
+
+uint16_t crc16_compute(uint8_t const *p_data, uint32_t size, uint16_t const *p_crc);
+
+#endif /* _STUB_CRC16_H */
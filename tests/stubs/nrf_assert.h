@@ -0,0 +1,10 @@
+#ifndef _STUB_NRF_ASSERT_H
+#define _STUB_NRF_ASSERT_H
+
+#include <assert.h>
+#include "nrfx.h"
+
+/* Asserts are checked in every host build, they are tests too */
+#define ASSERT(expr)                    assert(expr)
+
+#endif /* _STUB_NRF_ASSERT_H */
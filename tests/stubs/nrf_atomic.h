@@ -0,0 +1,95 @@
+#ifndef _STUB_NRF_ATOMIC_H
+#define _STUB_NRF_ATOMIC_H
+
+#include "nrfx.h"
+
+typedef volatile uint32_t nrf_atomic_u32_t;
+typedef volatile uint32_t nrf_atomic_flag_t;
+
+static inline uint32_t nrf_atomic_u32_fetch_store(nrf_atomic_u32_t *p_data, uint32_t value)
+{
+  return __atomic_exchange_n(p_data, value, __ATOMIC_SEQ_CST);
+}
+
+static inline uint32_t nrf_atomic_u32_store(nrf_atomic_u32_t *p_data, uint32_t value)
+{
+  __atomic_store_n(p_data, value, __ATOMIC_SEQ_CST);
+  return value;
+}
+
+static inline uint32_t nrf_atomic_u32_or(nrf_atomic_u32_t *p_data, uint32_t value)
+{
+  return __atomic_or_fetch(p_data, value, __ATOMIC_SEQ_CST);
+}
+
+static inline uint32_t nrf_atomic_u32_fetch_or(nrf_atomic_u32_t *p_data, uint32_t value)
+{
+  return __atomic_fetch_or(p_data, value, __ATOMIC_SEQ_CST);
+}
+
+static inline uint32_t nrf_atomic_u32_and(nrf_atomic_u32_t *p_data, uint32_t value)
+{
+  return __atomic_and_fetch(p_data, value, __ATOMIC_SEQ_CST);
+}
+
+static inline uint32_t nrf_atomic_u32_fetch_and(nrf_atomic_u32_t *p_data, uint32_t value)
+{
+  return __atomic_fetch_and(p_data, value, __ATOMIC_SEQ_CST);
+}
+
+static inline uint32_t nrf_atomic_u32_xor(nrf_atomic_u32_t *p_data, uint32_t value)
+{
+  return __atomic_xor_fetch(p_data, value, __ATOMIC_SEQ_CST);
+}
+
+static inline uint32_t nrf_atomic_u32_fetch_xor(nrf_atomic_u32_t *p_data, uint32_t value)
+{
+  return __atomic_fetch_xor(p_data, value, __ATOMIC_SEQ_CST);
+}
+
+static inline uint32_t nrf_atomic_u32_add(nrf_atomic_u32_t *p_data, uint32_t value)
+{
+  return __atomic_add_fetch(p_data, value, __ATOMIC_SEQ_CST);
+}
+
+static inline uint32_t nrf_atomic_u32_fetch_add(nrf_atomic_u32_t *p_data, uint32_t value)
+{
+  return __atomic_fetch_add(p_data, value, __ATOMIC_SEQ_CST);
+}
+
+static inline uint32_t nrf_atomic_u32_sub(nrf_atomic_u32_t *p_data, uint32_t value)
+{
+  return __atomic_sub_fetch(p_data, value, __ATOMIC_SEQ_CST);
+}
+
+static inline uint32_t nrf_atomic_u32_fetch_sub(nrf_atomic_u32_t *p_data, uint32_t value)
+{
+  return __atomic_fetch_sub(p_data, value, __ATOMIC_SEQ_CST);
+}
+
+static inline bool nrf_atomic_u32_cmp_exch(nrf_atomic_u32_t *p_data, uint32_t *p_expected, uint32_t desired)
+{
+  return __atomic_compare_exchange_n(p_data, p_expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+static inline uint32_t nrf_atomic_flag_set(nrf_atomic_flag_t *p_data)
+{
+  return nrf_atomic_u32_or(p_data, 1);
+}
+
+static inline uint32_t nrf_atomic_flag_set_fetch(nrf_atomic_flag_t *p_data)
+{
+  return nrf_atomic_u32_fetch_or(p_data, 1);
+}
+
+static inline uint32_t nrf_atomic_flag_clear(nrf_atomic_flag_t *p_data)
+{
+  return nrf_atomic_u32_and(p_data, 0);
+}
+
+static inline uint32_t nrf_atomic_flag_clear_fetch(nrf_atomic_flag_t *p_data)
+{
+  return nrf_atomic_u32_fetch_and(p_data, 0);
+}
+
+#endif /* _STUB_NRF_ATOMIC_H */
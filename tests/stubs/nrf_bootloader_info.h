@@ -0,0 +1,6 @@
+#ifndef _STUB_NRF_BOOTLOADER_INFO_H
+#define _STUB_NRF_BOOTLOADER_INFO_H
+
+#include "nrfx.h"
+
+#endif /* _STUB_NRF_BOOTLOADER_INFO_H */
@@ -0,0 +1,9 @@
+#ifndef _STUB_NRF_DFU_TYPES_H
+#define _STUB_NRF_DFU_TYPES_H
+
+#include "nrfx.h"
+
+/* Default of SDK: 3 pages below bootloader are kept by DFU */
+#define NRF_DFU_APP_DATA_AREA_SIZE      (3 * CODE_PAGE_SIZE)
+
+#endif /* _STUB_NRF_DFU_TYPES_H */
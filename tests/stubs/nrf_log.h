@@ -0,0 +1,17 @@
+#ifndef _STUB_NRF_LOG_H
+#define _STUB_NRF_LOG_H
+
+#include "nrfx.h"
+
+/* Arguments are still evaluated, so variables used only by logs aren't reported as unused */
+static inline void nrf_log_stub(const char *fmt, ...)
+{
+  (void)fmt;
+}
+
+#define NRF_LOG_INFO(...)               nrf_log_stub(__VA_ARGS__)
+#define NRF_LOG_WARNING(...)            nrf_log_stub(__VA_ARGS__)
+#define NRF_LOG_ERROR(...)              nrf_log_stub(__VA_ARGS__)
+#define NRF_LOG_DEBUG(...)              nrf_log_stub(__VA_ARGS__)
+
+#endif /* _STUB_NRF_LOG_H */
@@ -0,0 +1,26 @@
+#ifndef _STUB_NRF_NVMC_H
+#define _STUB_NRF_NVMC_H
+
+#include "nrfx.h"
+
+typedef enum
+{
+  NRF_NVMC_MODE_READONLY = 0,
+  NRF_NVMC_MODE_WRITE    = 1,
+  NRF_NVMC_MODE_ERASE    = 2,
+} nrf_nvmc_mode_t;
+
+typedef struct
+{
+  volatile uint32_t READY;
+  volatile uint32_t CONFIG;
+} NRF_NVMC_Type;
+
+/* Registers are emulated by tests/nvmc_emu.c */
+extern NRF_NVMC_Type nvmc_emu_regs;
+#define NRF_NVMC                        (&nvmc_emu_regs)
+
+void nrf_nvmc_mode_set(NRF_NVMC_Type *p_reg, nrf_nvmc_mode_t mode);
+bool nrf_nvmc_ready_check(NRF_NVMC_Type const *p_reg);
+
+#endif /* _STUB_NRF_NVMC_H */
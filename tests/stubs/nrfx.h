@@ -0,0 +1,35 @@
+#ifndef _STUB_NRFX_H
+#define _STUB_NRFX_H
+
+/* Host stand-ins of nRF SDK headers: only what project modules use, MCU is single threaded here */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#define MAX(a, b)                       ((a) > (b) ? (a) : (b))
+#define MIN(a, b)                       ((a) < (b) ? (a) : (b))
+#define STATIC_ASSERT(expr)             _Static_assert(expr, #expr)
+#define UNUSED_VARIABLE(x)              (void)(x)
+#define UNUSED_PARAMETER(x)             (void)(x)
+#define ARRAY_SIZE(a)                   (sizeof(a) / sizeof((a)[0]))
+#define NRFX_ARRAY_SIZE(a)              ARRAY_SIZE(a)
+#define __STATIC_INLINE                 static inline
+#define __ALIGN(n)                      __attribute__((aligned(n)))
+
+#define CODE_PAGE_SIZE                  4096
+
+#define __DMB()                         __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#define __DSB()                         __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#define __ISB()
+#define __WFE()
+#define __NOP()
+
+#define NRF_SUCCESS                     0
+#define NRFX_SUCCESS                    0
+
+typedef uint32_t ret_code_t;
+typedef uint32_t nrfx_err_t;
+
+#endif /* _STUB_NRFX_H */
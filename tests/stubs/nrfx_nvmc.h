@@ -0,0 +1,12 @@
+#ifndef _STUB_NRFX_NVMC_H
+#define _STUB_NRFX_NVMC_H
+
+#include "nrfx.h"
+
+nrfx_err_t nrfx_nvmc_page_erase(uint32_t address);
+nrfx_err_t nrfx_nvmc_page_partial_erase_init(uint32_t address, uint32_t duration_ms);
+bool nrfx_nvmc_page_partial_erase_continue(void);
+void nrfx_nvmc_word_write(uint32_t address, uint32_t value);
+void nrfx_nvmc_words_write(uint32_t address, void const *src, uint32_t num_words);
+
+#endif /* _STUB_NRFX_NVMC_H */
@@ -0,0 +1,97 @@
+#ifndef _STUB_NRFX_PWM_H
+#define _STUB_NRFX_PWM_H
+
+#include "nrfx.h"
+
+/* Driver is emulated by tests/pwm_emu.c, every instance is the same peripheral */
+
+#define NRFX_PWM_PIN_NOT_USED           0xFF
+
+#define NRFX_PWM_FLAG_STOP              0x01
+#define NRFX_PWM_FLAG_LOOP              0x02
+#define NRFX_PWM_FLAG_SIGNAL_END_SEQ0   0x04
+#define NRFX_PWM_FLAG_SIGNAL_END_SEQ1   0x08
+#define NRFX_PWM_FLAG_NO_EVT_FINISHED   0x10
+#define NRFX_PWM_FLAG_START_VIA_TASK    0x80
+
+#define NRFX_PWM_INSTANCE(id)           { .drv_inst_idx = (id) }
+
+typedef enum
+{
+  NRF_PWM_CLK_16MHz  = 0,
+  NRF_PWM_CLK_8MHz   = 1,
+  NRF_PWM_CLK_4MHz   = 2,
+  NRF_PWM_CLK_2MHz   = 3,
+  NRF_PWM_CLK_1MHz   = 4,
+  NRF_PWM_CLK_500kHz = 5,
+  NRF_PWM_CLK_250kHz = 6,
+  NRF_PWM_CLK_125kHz = 7,
+} nrf_pwm_clk_t;
+
+typedef enum
+{
+  NRF_PWM_MODE_UP          = 0,
+  NRF_PWM_MODE_UP_AND_DOWN = 1,
+} nrf_pwm_mode_t;
+
+typedef enum
+{
+  NRF_PWM_LOAD_COMMON     = 0,
+  NRF_PWM_LOAD_GROUPED    = 1,
+  NRF_PWM_LOAD_INDIVIDUAL = 2,
+  NRF_PWM_LOAD_WAVE_FORM  = 3,
+} nrf_pwm_dec_load_t;
+
+typedef enum
+{
+  NRF_PWM_STEP_AUTO      = 0,
+  NRF_PWM_STEP_TRIGGERED = 1,
+} nrf_pwm_dec_step_t;
+
+typedef enum
+{
+  NRFX_PWM_EVT_FINISHED,
+  NRFX_PWM_EVT_END_SEQ0,
+  NRFX_PWM_EVT_END_SEQ1,
+  NRFX_PWM_EVT_STOPPED,
+} nrfx_pwm_evt_type_t;
+
+typedef uint16_t nrf_pwm_values_common_t;
+
+typedef struct
+{
+  union
+  {
+    nrf_pwm_values_common_t const *p_common;
+    uint16_t const *p_raw;
+  } values;
+  uint16_t length;
+  uint32_t repeats;
+  uint32_t end_delay;
+} nrf_pwm_sequence_t;
+
+typedef struct
+{
+  uint8_t drv_inst_idx;
+} nrfx_pwm_t;
+
+typedef struct
+{
+  uint8_t output_pins[4];
+  uint8_t irq_priority;
+  nrf_pwm_clk_t base_clock;
+  nrf_pwm_mode_t count_mode;
+  uint16_t top_value;
+  nrf_pwm_dec_load_t load_mode;
+  nrf_pwm_dec_step_t step_mode;
+} nrfx_pwm_config_t;
+
+typedef void (*nrfx_pwm_handler_t)(nrfx_pwm_evt_type_t event_type);
+
+nrfx_err_t nrfx_pwm_init(nrfx_pwm_t const *p_instance, nrfx_pwm_config_t const *p_config,
+                         nrfx_pwm_handler_t handler);
+void nrfx_pwm_sequence_update(nrfx_pwm_t const *p_instance, uint8_t seq_id, nrf_pwm_sequence_t const *p_sequence);
+uint32_t nrfx_pwm_complex_playback(nrfx_pwm_t const *p_instance, nrf_pwm_sequence_t const *p_sequence_0,
+                                   nrf_pwm_sequence_t const *p_sequence_1, uint16_t playback_count, uint32_t flags);
+
+#endif /* _STUB_NRFX_PWM_H */
@@ -0,0 +1,31 @@
+#include "app_timer.h"
+#include "crc16.h"
+
+uint32_t app_timer_stub_cnt;
+
+uint32_t app_timer_cnt_get(void)
+{
+  return app_timer_stub_cnt & APP_TIMER_CNT_MASK;
+}
+
+uint32_t app_timer_cnt_diff_compute(uint32_t ticks_to, uint32_t ticks_from)
+{
+  return (ticks_to - ticks_from) & APP_TIMER_CNT_MASK;
+}
+
+/* Same CRC-16-CCITT as components/libraries/crc16 of SDK, records of real flash dumps are accepted */
+uint16_t crc16_compute(uint8_t const *p_data, uint32_t size, uint16_t const *p_crc)
+{
+  uint16_t crc = (p_crc == NULL) ? 0xFFFF : *p_crc;
+
+  for (uint32_t i = 0; i < size; i++)
+  {
+    crc = (uint8_t)(crc >> 8) | (crc << 8);
+    crc ^= p_data[i];
+    crc ^= (uint8_t)(crc & 0xFF) >> 4;
+    crc ^= (crc << 8) << 4;
+    crc ^= ((crc & 0xFF) << 4) << 1;
+  }
+
+  return crc;
+}
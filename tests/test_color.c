@@ -0,0 +1,326 @@
+/* Static functions are checked too */
+#include "../hsv_to_rgb_module/hsv_to_rgb.c"
+#include "color_ref.h"
+#include "color_oklab.h"
+#include "color_transition.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+/**
+ * Exhaustive checks of color conversions against reference versions of color_ref.h.
+ */
+
+#define CHECK(expr, ...)                                                    \
+  do                                                                        \
+  {                                                                         \
+    if (!(expr))                                                            \
+    {                                                                       \
+      fprintf(stderr, "%s:%d: %s: ", __FILE__, __LINE__, #expr);            \
+      fprintf(stderr, __VA_ARGS__);                                         \
+      fprintf(stderr, "\n");                                                \
+      exit(EXIT_FAILURE);                                                   \
+    }                                                                       \
+  } while (0)
+
+/* Limits are a bit above errors that were measured when fixed point OKLab was written */
+#define OKLAB_MAX_ERROR                 5e-4    /* of l, a and b */
+#define OKLAB_ROUND_TRIP_MAX_ERROR      48      /* of rgb16 channel */
+#define OKLCH_HUE_MAX_ERROR             0.5     /* degrees */
+#define OKLCH_HUE_MIN_CHROMA            0.02    /* hue of grayish colors is noise */
+#define OKLCH_LERP_MAX_ERROR            3e-5    /* of l and c */
+#define OKLCH_LERP_HUE_MAX_ERROR        0.02    /* degrees */
+#define OKLCH_LERP_PAIRS                100000
+
+/* Measured when hsv_by_rgb was rewritten, error comes from precision of hsv_params_t */
+#define HSV_ROUND_TRIP_MAX_ERROR        24      /* of rgb channel */
+#define HSV_ROUND_TRIP_MAX_MEAN_ERROR   5.5
+
+#define TRANSITION_FRAME_US             10000
+#define TRANSITION_DURATION_MS          1000
+
+#define RGB_GRID_STEP                   3       /* of rgb, 255 is included */
+#define RGB16_MAX_VALUE                 ((uint32_t)RGB_MAX_VALUE << RGB16_FRACTION_BITS)
+#define Q16_TO_DOUBLE(value)            ((double)(value) / OKLAB_ONE)
+#define BINARY_ANGLE_TO_DEGREES(h)      ((double)(h) * 360 / 65536)
+
+static uint32_t rnd_state = 1;
+
+static uint32_t rnd(void)
+{
+  rnd_state = rnd_state * 1664525U + 1013904223U;
+  return rnd_state >> 8;
+}
+
+/**
+ * @return difference of angles by the shortest arc, [-180; 180)
+ */
+static double degrees_diff(double to, double from)
+{
+  return remainder(to - from, 360);
+}
+
+static bool rgb_is_equal(rgb_params_t left, rgb_params_t right)
+{
+  return left.red == right.red && left.green == right.green && left.blue == right.blue;
+}
+
+/**
+ * @brief Branchless hsv8_to_rgb is the same as the switch for every hsv8
+ */
+static void hsv8_to_rgb_test(void)
+{
+  hsv8_params_t hsv8;
+  rgb_params_t rgb;
+
+  for (uint32_t i = 0; i < (1U << 24); i++)
+  {
+    hsv8 = (hsv8_params_t){.hue = i >> 16, .saturation = i >> 8, .brightness = i};
+    hsv8_to_rgb(&hsv8, &rgb);
+
+    CHECK(rgb_is_equal(rgb, hsv8_to_rgb_ref(hsv8.hue, hsv8.saturation, hsv8.brightness)),
+          "hsv8 %u %u %u", hsv8.hue, hsv8.saturation, hsv8.brightness);
+  }
+
+  printf("test_color: hsv8_to_rgb is equal to reference for %u inputs\n", 1U << 24);
+}
+
+/**
+ * @brief Every valid hsv is converted through hsv8 of the reference,
+ *  batch of all saturations and brightnesses of a hue gives the same colors
+ */
+static void hsv_to_rgb_test(void)
+{
+  static hsv_params_t batch_hsv[(SAT_MAX_VALUE + 1) * (BRIGHT_MAX_VALUE + 1)];
+  static rgb_params_t batch_rgb[ARRAY_SIZE(batch_hsv)];
+  hsv_params_t hsv;
+  hsv8_params_t hsv8;
+  rgb_params_t rgb;
+  uint32_t i;
+
+  for (hsv.hue = 0; hsv.hue <= HUE_MAX_VALUE; hsv.hue++)
+  {
+    i = 0;
+
+    for (hsv.saturation = 0; hsv.saturation <= SAT_MAX_VALUE; hsv.saturation++)
+    {
+      for (hsv.brightness = 0; hsv.brightness <= BRIGHT_MAX_VALUE; hsv.brightness++)
+      {
+        hsv_to_rgb(&hsv, &rgb);
+        hsv8 = hsv8_by_hsv(&hsv);
+
+        CHECK(rgb_is_equal(rgb, hsv8_to_rgb_ref(hsv8.hue, hsv8.saturation, hsv8.brightness)),
+              "hsv %u %u %u", hsv.hue, hsv.saturation, hsv.brightness);
+
+        batch_hsv[i++] = hsv;
+      }
+    }
+
+    hsv_to_rgb_batch(batch_hsv, batch_rgb, ARRAY_SIZE(batch_hsv));
+
+    for (i = 0; i < ARRAY_SIZE(batch_hsv); i++)
+    {
+      hsv_to_rgb(&batch_hsv[i], &rgb);
+
+      CHECK(rgb_is_equal(batch_rgb[i], rgb), "batch hsv %u %u %u", batch_hsv[i].hue,
+            batch_hsv[i].saturation, batch_hsv[i].brightness);
+    }
+  }
+
+  printf("test_color: hsv_to_rgb_batch is equal to hsv_to_rgb for every valid hsv\n");
+}
+
+/**
+ * @brief hsv_by_rgb is the nearest hsv for every rgb, and rgb -> hsv -> rgb
+ *  round trip error is bounded
+ */
+static void hsv_by_rgb_test(void)
+{
+  rgb_params_t rgb;
+  rgb_params_t round_trip;
+  hsv_params_t hsv;
+  hsv_params_t ref;
+  uint64_t error_sum = 0;
+  int32_t max_error = 0;
+  int32_t error;
+
+  for (uint32_t i = 0; i < (1U << 24); i++)
+  {
+    rgb = (rgb_params_t){.red = i >> 16, .green = i >> 8, .blue = i};
+    hsv = hsv_by_rgb(rgb);
+    ref = hsv_ref_by_rgb(rgb.red, rgb.green, rgb.blue);
+
+    CHECK(hsv.hue == ref.hue && hsv.saturation == ref.saturation && hsv.brightness == ref.brightness,
+          "rgb %u %u %u: hsv %u %u %u, reference %u %u %u", rgb.red, rgb.green, rgb.blue,
+          hsv.hue, hsv.saturation, hsv.brightness, ref.hue, ref.saturation, ref.brightness);
+
+    hsv_to_rgb(&hsv, &round_trip);
+    error = MAX(abs(round_trip.red - rgb.red), MAX(abs(round_trip.green - rgb.green), abs(round_trip.blue - rgb.blue)));
+    max_error = MAX(max_error, error);
+    error_sum += error;
+  }
+
+  CHECK(max_error <= HSV_ROUND_TRIP_MAX_ERROR, "rgb round trip error %d", max_error);
+  CHECK((double)error_sum / (1U << 24) <= HSV_ROUND_TRIP_MAX_MEAN_ERROR,
+        "rgb round trip mean error %.2f", (double)error_sum / (1U << 24));
+
+  printf("test_color: hsv_by_rgb is equal to reference for %u inputs, round trip error max %d, mean %.2f\n",
+         1U << 24, max_error, (double)error_sum / (1U << 24));
+}
+
+/**
+ * @brief Fixed point OKLab and OKLCh of rgb grid against doubles, and round trip back to rgb16
+ */
+static void oklab_test(void)
+{
+  rgb16_params_t rgb16;
+  rgb16_params_t round_trip;
+  oklab_t lab;
+  oklch_t lch;
+  oklab_ref_t ref;
+  double lab_error = 0;
+  double hue_error = 0;
+  double ref_hue;
+  int32_t round_trip_error = 0;
+
+  for (uint32_t red = 0; red <= RGB_MAX_VALUE; red += RGB_GRID_STEP)
+  {
+    for (uint32_t green = 0; green <= RGB_MAX_VALUE; green += RGB_GRID_STEP)
+    {
+      for (uint32_t blue = 0; blue <= RGB_MAX_VALUE; blue += RGB_GRID_STEP)
+      {
+        rgb16 = (rgb16_params_t)
+        {
+          .red = red << RGB16_FRACTION_BITS,
+          .green = green << RGB16_FRACTION_BITS,
+          .blue = blue << RGB16_FRACTION_BITS
+        };
+        lab = oklab_by_rgb16(rgb16);
+        ref = oklab_ref_by_rgb(red / 255.0, green / 255.0, blue / 255.0);
+
+        lab_error = fmax(lab_error, fabs(Q16_TO_DOUBLE(lab.l) - ref.l));
+        lab_error = fmax(lab_error, fabs(Q16_TO_DOUBLE(lab.a) - ref.a));
+        lab_error = fmax(lab_error, fabs(Q16_TO_DOUBLE(lab.b) - ref.b));
+
+        CHECK(rgb16_by_oklab(&lab, &round_trip), "rgb %u %u %u is out of gamut", red, green, blue);
+        round_trip_error = MAX(round_trip_error, abs((int32_t)round_trip.red - rgb16.red));
+        round_trip_error = MAX(round_trip_error, abs((int32_t)round_trip.green - rgb16.green));
+        round_trip_error = MAX(round_trip_error, abs((int32_t)round_trip.blue - rgb16.blue));
+
+        if (hypot(ref.a, ref.b) >= OKLCH_HUE_MIN_CHROMA)
+        {
+          lch = oklch_by_oklab(&lab);
+          ref_hue = atan2(ref.b, ref.a) * 180 / M_PI;
+          hue_error = fmax(hue_error, fabs(degrees_diff(BINARY_ANGLE_TO_DEGREES(lch.h), ref_hue)));
+        }
+      }
+    }
+  }
+
+  CHECK(lab_error <= OKLAB_MAX_ERROR, "lab error %g", lab_error);
+  CHECK(round_trip_error <= OKLAB_ROUND_TRIP_MAX_ERROR, "rgb16 round trip error %d", round_trip_error);
+  CHECK(hue_error <= OKLCH_HUE_MAX_ERROR, "hue error %g degrees", hue_error);
+
+  printf("test_color: oklab error %.2g, rgb16 round trip error %d/%u, oklch hue error %.2g degrees\n",
+         lab_error, round_trip_error, RGB16_MAX_VALUE, hue_error);
+}
+
+/**
+ * @brief oklch_lerp goes straight in l and c and by the shortest arc in hue
+ */
+static void oklch_lerp_test(void)
+{
+  static const uint32_t fractions[] = {0, OKLAB_ONE / 4, OKLAB_ONE / 2, OKLAB_ONE * 3 / 4, OKLAB_ONE - 1};
+  oklch_t from;
+  oklch_t to;
+  oklch_t lch;
+  double t;
+  double error = 0;
+  double hue_error = 0;
+  double ref_hue;
+
+  for (uint32_t pair = 0; pair < OKLCH_LERP_PAIRS; pair++)
+  {
+    from = (oklch_t){.l = rnd() % OKLAB_ONE, .c = rnd() % (OKLAB_ONE / 2), .h = rnd()};
+    to = (oklch_t){.l = rnd() % OKLAB_ONE, .c = rnd() % (OKLAB_ONE / 2), .h = rnd()};
+
+    /* Both arcs of opposite hues are the shortest */
+    if ((uint16_t)(to.h - from.h) == 0x8000)
+    {
+      continue;
+    }
+
+    for (uint8_t i = 0; i < ARRAY_SIZE(fractions); i++)
+    {
+      lch = oklch_lerp(&from, &to, fractions[i]);
+      t = Q16_TO_DOUBLE(fractions[i]);
+
+      error = fmax(error, fabs(Q16_TO_DOUBLE(lch.l) - (Q16_TO_DOUBLE(from.l) + t * Q16_TO_DOUBLE(to.l - from.l))));
+      error = fmax(error, fabs(Q16_TO_DOUBLE(lch.c) - (Q16_TO_DOUBLE(from.c) + t * Q16_TO_DOUBLE(to.c - from.c))));
+
+      ref_hue = BINARY_ANGLE_TO_DEGREES(from.h) +
+                t * degrees_diff(BINARY_ANGLE_TO_DEGREES(to.h), BINARY_ANGLE_TO_DEGREES(from.h));
+      hue_error = fmax(hue_error, fabs(degrees_diff(BINARY_ANGLE_TO_DEGREES(lch.h), ref_hue)));
+    }
+  }
+
+  CHECK(error <= OKLCH_LERP_MAX_ERROR, "oklch lerp error %g", error);
+  CHECK(hue_error <= OKLCH_LERP_HUE_MAX_ERROR, "oklch lerp hue error %g degrees", hue_error);
+
+  printf("test_color: oklch lerp error %.2g, hue error %.2g degrees\n", error, hue_error);
+}
+
+/**
+ * @return the least chroma of frames of transition between colors, Q16
+ */
+static int32_t transition_min_chroma_get(color_transition_space_t space, rgb16_params_t from, rgb16_params_t to)
+{
+  const hsv_params_t hsv = HSV_STRUCT_DEFAULT_VALUE;   /* isn't used by OKLab spaces */
+  const uint32_t frames = TRANSITION_DURATION_MS * 1000 / TRANSITION_FRAME_US;
+  int32_t min_chroma = INT32_MAX;
+  oklab_t lab;
+
+  CHECK(color_transition_config(TRANSITION_DURATION_MS, space), "space %d isn't accepted", space);
+  color_transition_process(&hsv, from);
+  color_transition_start();
+
+  for (uint32_t i = 0; i < frames; i++)
+  {
+    lab = oklab_by_rgb16(color_transition_process(&hsv, to));
+    min_chroma = MIN(min_chroma, oklch_by_oklab(&lab).c);
+  }
+
+  return min_chroma;
+}
+
+/**
+ * @brief OKLCh transition between saturated colors goes around hue circle,
+ *  OKLab one cuts through less chromatic colors
+ */
+static void oklch_transition_test(void)
+{
+  static const rgb16_params_t red = {.red = RGB16_MAX_VALUE};
+  static const rgb16_params_t cyan = {.green = RGB16_MAX_VALUE, .blue = RGB16_MAX_VALUE};
+  int32_t oklab_chroma;
+  int32_t oklch_chroma;
+
+  color_transition_init(TRANSITION_FRAME_US);
+  oklab_chroma = transition_min_chroma_get(COLOR_TRANSITION_OKLAB, red, cyan);
+  oklch_chroma = transition_min_chroma_get(COLOR_TRANSITION_OKLCH, red, cyan);
+
+  CHECK(oklch_chroma > oklab_chroma * 4, "oklch min chroma %d, oklab min chroma %d", oklch_chroma, oklab_chroma);
+
+  printf("test_color: min chroma of red to cyan transition %.3f in oklch, %.3f in oklab\n",
+         Q16_TO_DOUBLE(oklch_chroma), Q16_TO_DOUBLE(oklab_chroma));
+}
+
+int main(void)
+{
+  hsv8_to_rgb_test();
+  hsv_to_rgb_test();
+  hsv_by_rgb_test();
+  oklab_test();
+  oklch_lerp_test();
+  oklch_transition_test();
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,325 @@
+#include "nvmc_emu.h"
+#include "nvmc_module.h"
+#include "nvmc_kv.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/**
+ * Power is cut at every flash operation of a run of settings saves. Boot after the cut
+ *  checks recovered settings and saves more of them, and its power is cut too at one
+ *  of its first operations, while the store recovers. Two more boots check that
+ *  the store is still usable: a save is finished and read back.
+ *
+ * Every save stamps its values with sequence number. Recovered value must be the last
+ *  saved one or the one that was being saved, and all values of batch must be of one save.
+ */
+
+#define RUN_STEPS                       64      /* the log page is compacted twice */
+#define RUN_SLOW_ERASE_STEPS            32      /* spare page isn't erased in background until compaction */
+#define RECOVERY_STEPS                  2
+#define RECOVERY_CUT_OPS                17      /* boot after cut is cut at one of its first operations */
+#define ERASE_CALLS_SLOW                2       /* calls of main loop per save */
+#define ERASE_CALLS_FAST                5
+#define ERASE_CALLS_FINISH              100     /* enough to erase page by NVMC_ERASE_DURATION_MS steps */
+
+#define SEQ_HSV_SATURATION              50      /* default color has other saturation */
+#define PRESETS_SIZE                    24
+#define EFFECT_SIZE                     100
+#define CALIB_SIZE                      12
+#define TOGGLED_SIZE                    40
+
+#define CHECK(expr, ...)                                                    \
+  do                                                                        \
+  {                                                                         \
+    if (!(expr))                                                            \
+    {                                                                       \
+      fprintf(stderr, "%s:%d: %s: ", __FILE__, __LINE__, #expr);            \
+      fprintf(stderr, __VA_ARGS__);                                         \
+      fprintf(stderr, ", cut at operation %lld\n", (long long)bench->cut_op); \
+      exit(EXIT_FAILURE);                                                   \
+    }                                                                       \
+  } while (0)
+
+typedef enum track_e
+{
+  TRACK_BATCH,                    /* hsv, led mode, presets and effect are saved together */
+  TRACK_SINGLE,                   /* calibration is saved alone */
+  TRACK_TOGGLED,                  /* effect of the second slot is saved and deleted by turns */
+  TRACKS_COUNT
+} track_t;
+
+/* Sequence numbers of track, 0 if there is no value */
+typedef struct expected_s
+{
+  uint32_t committed;             /* put has returned */
+  uint32_t inflight;              /* put was called */
+} expected_t;
+
+/* Lives on heap, so it survives boots as state of test bench that watches the device */
+typedef struct bench_state_s
+{
+  expected_t tracks[TRACKS_COUNT];
+  uint32_t seq;
+  int64_t cut_op;                 /* of the first boot of scenario */
+} bench_state_t;
+
+static bench_state_t *bench;
+
+static void payload_fill(uint8_t *payload, uint8_t size, uint32_t seq)
+{
+  memcpy(payload, &seq, sizeof(seq));
+
+  for (uint8_t i = sizeof(seq); i < size; i++)
+  {
+    payload[i] = (uint8_t)(seq * 31 + i);
+  }
+}
+
+/**
+ * @return sequence number of value or 0 if key isn't stored
+ */
+static uint32_t payload_seq_get(nvmc_kv_key_t key, uint8_t size)
+{
+  uint8_t payload[NVMC_KV_VALUE_MAX_SIZE];
+  uint8_t expected[NVMC_KV_VALUE_MAX_SIZE];
+  uint32_t seq;
+
+  if (!nvmc_kv_get(key, payload, size))
+  {
+    return 0;
+  }
+
+  memcpy(&seq, payload, sizeof(seq));
+  payload_fill(expected, size, seq);
+  CHECK(!memcmp(payload, expected, size), "value of key %d is broken", key);
+
+  return seq;
+}
+
+static hsv_params_t seq_hsv_get(uint32_t seq)
+{
+  return (hsv_params_t){.hue = seq % 360, .saturation = SEQ_HSV_SATURATION, .brightness = seq / 360};
+}
+
+static void track_begin(track_t track, uint32_t seq)
+{
+  bench->tracks[track].inflight = seq;
+}
+
+static void track_commit(track_t track)
+{
+  bench->tracks[track].committed = bench->tracks[track].inflight;
+}
+
+static void track_check(track_t track, uint32_t seq)
+{
+  const expected_t *const expected = &bench->tracks[track];
+
+  CHECK(seq == expected->committed || seq == expected->inflight,
+        "track %d has value of save %u, saved %u, being saved %u", track, seq, expected->committed, expected->inflight);
+
+  bench->tracks[track].committed = seq;
+  bench->tracks[track].inflight = seq;
+}
+
+static void batch_save(uint32_t seq)
+{
+  const hsv_params_t hsv = seq_hsv_get(seq);
+  const uint8_t led_mode = (uint8_t)seq;
+  uint8_t presets[PRESETS_SIZE];
+  uint8_t effect[EFFECT_SIZE];
+  const nvmc_kv_item_t items[] =
+  {
+    {.key = NVMC_KV_KEY_HSV, .value = &hsv, .size = sizeof(hsv)},
+    {.key = NVMC_KV_KEY_LED_MODE, .value = &led_mode, .size = sizeof(led_mode)},
+    {.key = NVMC_KV_KEY_PRESETS, .value = presets, .size = sizeof(presets)},
+    {.key = NVMC_KV_KEY_EFFECT_0, .value = effect, .size = sizeof(effect)},
+  };
+
+  payload_fill(presets, sizeof(presets), seq);
+  payload_fill(effect, sizeof(effect), seq);
+
+  track_begin(TRACK_BATCH, seq);
+  CHECK(nvmc_kv_put_batch(items, ARRAY_SIZE(items)), "batch %u isn't saved", seq);
+  track_commit(TRACK_BATCH);
+}
+
+static void single_save(uint32_t seq)
+{
+  uint8_t calib[CALIB_SIZE];
+
+  payload_fill(calib, sizeof(calib), seq);
+
+  track_begin(TRACK_SINGLE, seq);
+  CHECK(nvmc_kv_put(NVMC_KV_KEY_COLOR_CALIB, calib, sizeof(calib)), "value %u isn't saved", seq);
+  track_commit(TRACK_SINGLE);
+}
+
+static void toggled_save(uint32_t seq)
+{
+  uint8_t effect[TOGGLED_SIZE];
+
+  if (bench->tracks[TRACK_TOGGLED].committed != 0)
+  {
+    track_begin(TRACK_TOGGLED, 0);
+    CHECK(nvmc_kv_delete(NVMC_KV_KEY_EFFECT_1), "key isn't deleted");
+  }
+  else
+  {
+    payload_fill(effect, sizeof(effect), seq);
+    track_begin(TRACK_TOGGLED, seq);
+    CHECK(nvmc_kv_put(NVMC_KV_KEY_EFFECT_1, effect, sizeof(effect)), "value %u isn't saved", seq);
+  }
+
+  track_commit(TRACK_TOGGLED);
+}
+
+static void main_loop_run(uint8_t calls)
+{
+  for (uint8_t i = 0; i < calls; i++)
+  {
+    nvmc_erase_last_written_page();
+  }
+}
+
+static void saves_run(uint32_t steps)
+{
+  uint32_t seq;
+
+  for (uint32_t step = 0; step < steps; step++)
+  {
+    seq = ++bench->seq;
+
+    batch_save(seq);
+
+    if (seq % 3 == 0)
+    {
+      single_save(seq);
+    }
+
+    if (seq % 5 == 0)
+    {
+      toggled_save(seq);
+    }
+
+    main_loop_run(seq <= RUN_SLOW_ERASE_STEPS ? ERASE_CALLS_SLOW : ERASE_CALLS_FAST);
+  }
+}
+
+/**
+ * @brief Boots store as firmware does and checks recovered values against saves.
+ */
+static void settings_check(void)
+{
+  hsv_params_t hsv;
+  hsv_params_t seq_hsv;
+  const hsv_params_t default_hsv = HSV_STRUCT_DEFAULT_VALUE;
+  uint32_t seq = 0;
+
+  nvmc_init();
+  hsv = nvmc_find_last_record();
+
+  if (hsv.saturation == SEQ_HSV_SATURATION)
+  {
+    seq = hsv.hue + hsv.brightness * 360;
+    seq_hsv = seq_hsv_get(seq);
+    CHECK(!memcmp(&hsv, &seq_hsv, sizeof(hsv)), "color of save %u is broken", seq);
+  }
+  else
+  {
+    CHECK(!memcmp(&hsv, &default_hsv, sizeof(hsv)), "color isn't default");
+  }
+
+  track_check(TRACK_BATCH, seq);
+
+  if (seq == 0)
+  {
+    CHECK(!nvmc_kv_get(NVMC_KV_KEY_LED_MODE, &(uint8_t){0}, sizeof(uint8_t)), "led mode without color");
+  }
+  else
+  {
+    uint8_t led_mode = 0;
+
+    CHECK(nvmc_kv_get(NVMC_KV_KEY_LED_MODE, &led_mode, sizeof(led_mode)) && led_mode == (uint8_t)seq,
+          "led mode isn't of save %u", seq);
+  }
+
+  CHECK(payload_seq_get(NVMC_KV_KEY_PRESETS, PRESETS_SIZE) == seq, "presets aren't of save %u", seq);
+  CHECK(payload_seq_get(NVMC_KV_KEY_EFFECT_0, EFFECT_SIZE) == seq, "effect isn't of save %u", seq);
+
+  track_check(TRACK_SINGLE, payload_seq_get(NVMC_KV_KEY_COLOR_CALIB, CALIB_SIZE));
+  track_check(TRACK_TOGGLED, payload_seq_get(NVMC_KV_KEY_EFFECT_1, TOGGLED_SIZE));
+}
+
+static void firmware_run(void)
+{
+  settings_check();
+  saves_run(RUN_STEPS);
+}
+
+static void firmware_recover(void)
+{
+  settings_check();
+  saves_run(RECOVERY_STEPS);
+  main_loop_run(ERASE_CALLS_FINISH);
+}
+
+static void firmware_check(void)
+{
+  settings_check();
+}
+
+static void scenario_reset(int64_t cut_op)
+{
+  nvmc_emu_erase_all();
+  memset(bench, 0, sizeof(*bench));
+  bench->cut_op = cut_op;
+}
+
+/**
+ * @brief Checks fail the test at once, so only boots are run here
+ */
+static void scenario_run(int64_t cut_op)
+{
+  scenario_reset(cut_op);
+
+  CHECK(nvmc_emu_boot(firmware_run, cut_op, (uint32_t)cut_op + 1) == NVMC_EMU_BOOT_CUT, "run isn't cut");
+  nvmc_emu_boot(firmware_recover, cut_op % RECOVERY_CUT_OPS, (uint32_t)cut_op * 7 + 3);
+  CHECK(nvmc_emu_boot(firmware_recover, NVMC_EMU_NO_CUT, 0) == NVMC_EMU_BOOT_DONE, "recovery is cut");
+  CHECK(nvmc_emu_boot(firmware_check, NVMC_EMU_NO_CUT, 0) == NVMC_EMU_BOOT_DONE, "check is cut");
+}
+
+int main(void)
+{
+  struct timespec start;
+  struct timespec end;
+  uint64_t ops;
+  double seconds;
+
+  nvmc_emu_init();
+  bench = calloc(1, sizeof(*bench));
+
+  if (bench == NULL)
+  {
+    return EXIT_FAILURE;
+  }
+
+  scenario_reset(NVMC_EMU_NO_CUT);
+  CHECK(nvmc_emu_boot(firmware_run, NVMC_EMU_NO_CUT, 0) == NVMC_EMU_BOOT_DONE, "run is cut");
+  ops = nvmc_emu_stats_get().ops;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  for (int64_t cut_op = 0; cut_op < (int64_t)ops; cut_op++)
+  {
+    scenario_run(cut_op);
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+  printf("test_nvmc_cut: %llu power cuts passed, %.0f cuts/s\n", (unsigned long long)ops, ops / seconds);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,195 @@
+#include "nvmc_emu.h"
+#include "nvmc_module.h"
+#include "nvmc_kv.h"
+#include "color_calib.h"
+#include "effect.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+/**
+ * Pointers of @ref nvmc_kv_get_ptr are held across compaction: the record is moved
+ *  to the other page and the old one is erased in background. Version of store must
+ *  be changed before that, and calibration and effects that are read in place must
+ *  follow their records. Their edited copies are read until they are saved.
+ */
+
+#define FILLER_SIZE                     100
+#define COMPACTIONS_COUNT               3
+#define ERASE_CALLS_FINISH              100     /* enough to erase page by NVMC_ERASE_DURATION_MS steps */
+
+#define CHECK(expr, ...)                                                    \
+  do                                                                        \
+  {                                                                         \
+    if (!(expr))                                                            \
+    {                                                                       \
+      fprintf(stderr, "%s:%d: %s: ", __FILE__, __LINE__, #expr);            \
+      fprintf(stderr, __VA_ARGS__);                                         \
+      fprintf(stderr, "\n");                                                \
+      exit(EXIT_FAILURE);                                                   \
+    }                                                                       \
+  } while (0)
+
+static const uint8_t effect_code[] = {EFFECT_OP_FADE, 10, 20, 30, 5, EFFECT_OP_LOOP};
+
+static void main_loop_run(uint8_t calls)
+{
+  for (uint8_t i = 0; i < calls; i++)
+  {
+    nvmc_erase_last_written_page();
+  }
+}
+
+static bool is_in_flash(const void *ptr)
+{
+  return (uint32_t)ptr >= NVMC_START_APP_DATA_ADDR && (uint32_t)ptr < NVMC_END_APP_DATA_ADDR;
+}
+
+/**
+ * @brief Writes other key until the record of key is moved by compaction
+ *
+ * @return version of store before the move
+ */
+static uint32_t compaction_run(nvmc_kv_key_t key, uint8_t size)
+{
+  const void *ptr = nvmc_kv_get_ptr(key, size);
+  uint8_t filler[FILLER_SIZE];
+  uint32_t version = nvmc_kv_version();
+
+  for (uint32_t seq = 0; nvmc_kv_get_ptr(key, size) == ptr; seq++)
+  {
+    memset(filler, (uint8_t)seq, sizeof(filler));
+    version = nvmc_kv_version();
+    CHECK(nvmc_kv_put(NVMC_KV_KEY_PRESETS, filler, sizeof(filler)), "filler %u isn't written", seq);
+    CHECK(seq < CODE_PAGE_SIZE / FILLER_SIZE, "key %d isn't moved", key);
+  }
+
+  return version;
+}
+
+/**
+ * @brief Value keeps its content at the new place, old pointer is valid until erase
+ */
+static void kv_ptr_test(void)
+{
+  const color_calib_t calib = {.matrix = {{1, 2, 3}, {4, 5, 6}, {7, 8, 9}}, .offset = {10, 11, 12}};
+  const color_calib_t *ptr;
+  const color_calib_t *moved;
+  uint32_t version;
+
+  CHECK(nvmc_kv_put(NVMC_KV_KEY_COLOR_CALIB, &calib, sizeof(calib)), "value isn't written");
+  ptr = nvmc_kv_get_ptr(NVMC_KV_KEY_COLOR_CALIB, sizeof(calib));
+  CHECK(ptr != NULL && is_in_flash(ptr) && !memcmp(ptr, &calib, sizeof(calib)), "value isn't read in place");
+
+  version = compaction_run(NVMC_KV_KEY_COLOR_CALIB, sizeof(calib));
+  moved = nvmc_kv_get_ptr(NVMC_KV_KEY_COLOR_CALIB, sizeof(calib));
+
+  CHECK(nvmc_kv_version() != version, "version isn't changed by compaction");
+  CHECK(!memcmp(moved, &calib, sizeof(calib)), "moved value is changed");
+  CHECK(!memcmp(ptr, &calib, sizeof(calib)), "old page is erased before version is seen");
+
+  main_loop_run(ERASE_CALLS_FINISH);
+  CHECK(memcmp(ptr, &calib, sizeof(calib)) != 0, "old page isn't erased in background");
+  CHECK(!memcmp(moved, &calib, sizeof(calib)), "moved value is changed by erase");
+
+  CHECK(nvmc_kv_delete(NVMC_KV_KEY_COLOR_CALIB), "value isn't deleted");
+}
+
+static rgb16_params_t calib_render(void)
+{
+  rgb16_params_t rgb = {.red = 100 << RGB16_FRACTION_BITS, .green = 200 << RGB16_FRACTION_BITS, .blue = 0};
+
+  color_calib_apply(&rgb, 1);
+
+  return rgb;
+}
+
+/**
+ * @brief Red takes green input: edited copy is rendered until save,
+ *  saved record is rendered after every compaction and erase
+ */
+static void calib_test(void)
+{
+  const int16_t coefs[3] = {0, COLOR_CALIB_ONE, 0};
+  nvmc_kv_item_t item;
+
+  color_calib_init();
+  CHECK(calib_render().red == 100 << RGB16_FRACTION_BITS, "identity changes color");
+
+  CHECK(color_calib_row_set(0, coefs, 0), "row isn't set");
+  CHECK(calib_render().red == 200 << RGB16_FRACTION_BITS, "edited calibration isn't rendered");
+  item = color_calib_kv_item_get();
+  CHECK(!is_in_flash(item.value), "edited calibration isn't read from RAM");
+
+  /* Other key is written, edit is pending */
+  compaction_run(NVMC_KV_KEY_PRESETS, FILLER_SIZE);
+  CHECK(calib_render().red == 200 << RGB16_FRACTION_BITS, "edited calibration is dropped before save");
+  CHECK(!is_in_flash(color_calib_kv_item_get().value), "edited calibration is dropped before save");
+
+  CHECK(nvmc_kv_put_batch(&item, 1), "calibration isn't saved");
+
+  for (uint8_t i = 0; i < COMPACTIONS_COUNT; i++)
+  {
+    CHECK(calib_render().red == 200 << RGB16_FRACTION_BITS, "saved calibration isn't rendered after %u compactions", i);
+    item = color_calib_kv_item_get();
+    CHECK(item.value == nvmc_kv_get_ptr(NVMC_KV_KEY_COLOR_CALIB, sizeof(color_calib_t)),
+          "saved calibration isn't read in place after %u compactions", i);
+
+    compaction_run(NVMC_KV_KEY_COLOR_CALIB, sizeof(color_calib_t));
+    main_loop_run(ERASE_CALLS_FINISH);
+  }
+
+  CHECK(calib_render().red == 200 << RGB16_FRACTION_BITS, "saved calibration isn't rendered after compaction");
+}
+
+static void effects_test(void)
+{
+  const effect_t *effect;
+  nvmc_kv_item_t item;
+  uint32_t version;
+
+  effects_init();
+  CHECK(effects_count() == 0, "%u effects in empty store", effects_count());
+
+  CHECK(effects_upload(1, effect_code, sizeof(effect_code)), "effect isn't uploaded");
+  effect = effects_get(0);
+  CHECK(effects_count() == 1 && effect != NULL && !is_in_flash(effect), "uploaded effect isn't read from RAM");
+
+  item = effect_kv_item_get(1);
+  CHECK(nvmc_kv_put_batch(&item, 1), "effect isn't saved");
+
+  for (uint8_t i = 0; i < COMPACTIONS_COUNT; i++)
+  {
+    version = effects_version();
+    effect = effects_get(0);
+    CHECK(effect == nvmc_kv_get_ptr(NVMC_KV_KEY_EFFECT_1, sizeof(effect_t)),
+          "saved effect isn't read in place after %u compactions", i);
+    CHECK(effect->size == sizeof(effect_code) && !memcmp(effect->code, effect_code, sizeof(effect_code)),
+          "saved effect is changed after %u compactions", i);
+
+    compaction_run(NVMC_KV_KEY_EFFECT_1, sizeof(effect_t));
+    main_loop_run(ERASE_CALLS_FINISH);
+    CHECK(effects_get(0) != effect && effects_version() != version, "players don't restart from moved effect");
+  }
+
+  CHECK(effects_upload(1, effect_code, 0) && effects_count() == 0, "effect isn't cleared");
+}
+
+static void firmware_run(void)
+{
+  nvmc_kv_init();
+  kv_ptr_test();
+  calib_test();
+  effects_test();
+}
+
+int main(void)
+{
+  nvmc_emu_init();
+  nvmc_emu_erase_all();
+
+  CHECK(nvmc_emu_boot(firmware_run, NVMC_EMU_NO_CUT, 0) == NVMC_EMU_BOOT_DONE, "run is cut");
+
+  printf("test_nvmc_kv: calibration and effects follow their records over %u compactions\n", COMPACTIONS_COUNT);
+
+  return EXIT_SUCCESS;
+}
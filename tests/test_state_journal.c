@@ -0,0 +1,242 @@
+/* Written state is read from static state of journal */
+#include "../state_module/state_journal.c"
+#include "nvmc_emu.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/**
+ * Power is cut at every flash operation of a run of animation states written by journal,
+ *  snapshots, state words and deltas of both halves of words are written and the page
+ *  is erased once. Boot after the cut checks resumed state and writes more of them,
+ *  and the last boot checks that the last written state is resumed.
+ *
+ * State is a function of its sequence number. Resumed state must be the last written
+ *  one or the one that was being written. While the page is erased and until the
+ *  snapshot after it, older states or nothing may be resumed, but never a broken one.
+ */
+
+#define RUN_STEPS                       5000    /* the page is filled once */
+#define RECOVERY_STEPS                  40
+#define RECOVERY_CUT_OPS                17      /* boot after cut is cut at one of its first operations */
+#define MODE_STEPS                      150     /* snapshot */
+#define HUE_STEPS                       9       /* state word of non hue modes */
+#define DIRECTION_STEPS                 100     /* direction of other mode, snapshot */
+#define VALUE_STEP                      7       /* delta of the field of mode */
+
+#define CHECK(expr, ...)                                                    \
+  do                                                                        \
+  {                                                                         \
+    if (!(expr))                                                            \
+    {                                                                       \
+      fprintf(stderr, "%s:%d: %s: ", __FILE__, __LINE__, #expr);            \
+      fprintf(stderr, __VA_ARGS__);                                         \
+      fprintf(stderr, ", cut at operation %lld\n", (long long)bench->cut_op); \
+      exit(EXIT_FAILURE);                                                   \
+    }                                                                       \
+  } while (0)
+
+/* Lives on heap, so it survives boots as state of test bench that watches the device */
+typedef struct bench_state_s
+{
+  uint32_t seq;                   /* state that was being written */
+  uint32_t committed;             /* the last state that journal has written, 0 if none */
+  bool is_page_lost;              /* page is erased and has no snapshot yet */
+  int64_t cut_op;                 /* of the first boot of scenario */
+} bench_state_t;
+
+static bench_state_t *bench;
+
+static journal_state_t seq_state_get(uint32_t seq)
+{
+  static const uint8_t modes[] = {BRIGHTNESS_CHANGE, SATURATION_CHANGE, HUE_CHANGE, CCT_CHANGE};
+  const uint8_t led_mode = modes[(seq / MODE_STEPS) % ARRAY_SIZE(modes)];
+  const uint32_t phase = (seq * VALUE_STEP) % 200;
+  const uint8_t value = phase <= 100 ? phase : 200 - phase;
+  const uint8_t other_mode = led_mode == HUE_CHANGE ? SATURATION_CHANGE : HUE_CHANGE;
+  journal_state_t state =
+  {
+    .hsv = {.hue = (seq / HUE_STEPS) * 37 % HUE_MAX_VALUE, .saturation = 60, .brightness = 70},
+    .led_mode = led_mode,
+    .directions = ((phase < 100) << led_mode) | (((seq / DIRECTION_STEPS) & 1) << other_mode),
+  };
+
+  switch (led_mode)
+  {
+    case BRIGHTNESS_CHANGE:
+      state.hsv.brightness = value;
+      break;
+
+    case SATURATION_CHANGE:
+      state.hsv.saturation = value;
+      break;
+
+    case HUE_CHANGE:
+      state.hsv.hue = seq * 23 % HUE_MAX_VALUE;
+      break;
+
+    default:
+      state.hsv.saturation = value;
+      state.hsv.brightness = BRIGHT_MAX_VALUE - value;
+      break;
+  }
+
+  return state;
+}
+
+static bool state_is_equal(const journal_state_t *const left, const journal_state_t *const right)
+{
+  return !memcmp(left, right, sizeof(*left));
+}
+
+/**
+ * @brief Runs main loop of firmware once per journal period with animation of the next states
+ */
+static void states_run(uint32_t steps)
+{
+  journal_state_t state;
+
+  for (uint32_t step = 0; step < steps; step++)
+  {
+    state = seq_state_get(++bench->seq);
+    app_state_hsv_set(state.hsv);
+    app_state_led_mode_set(state.led_mode);
+    color_anim_directions_set(state.directions);
+
+    app_timer_stub_cnt += APP_TIMER_TICKS(STATE_JOURNAL_PERIOD_MS);
+    state_journal_process();
+
+    /* Main loop runs many times per period, page is erased in between */
+    while (journal.is_erasing)
+    {
+      bench->is_page_lost = true;
+      state_journal_process();
+    }
+
+    if (journal.has_snapshot && state_is_equal(&journal.written, &state))
+    {
+      bench->committed = bench->seq;
+      bench->is_page_lost = false;
+    }
+  }
+}
+
+/**
+ * @brief Boots journal as firmware does and checks resumed state against written ones
+ */
+static void resumed_check(void)
+{
+  const hsv_params_t default_hsv = HSV_STRUCT_DEFAULT_VALUE;
+  journal_state_t resumed;
+  journal_state_t expected;
+  bool is_known = false;
+
+  app_state_init(default_hsv);
+  state_journal_init();
+  /* As PWM init does it */
+  color_anim_init(1000000 / COLOR_ANIM_DEFAULT_SPEED);
+
+  if (app_state_led_mode_get() == NO_CHANGE)
+  {
+    CHECK(bench->committed == 0 || bench->is_page_lost, "state %u isn't resumed", bench->committed);
+    return;
+  }
+
+  resumed = (journal_state_t)
+  {
+    .hsv = app_state_hsv_get(),
+    .led_mode = app_state_led_mode_get(),
+    .directions = journal.written.directions,
+  };
+
+  for (uint32_t seq = bench->seq; seq >= 1 && !is_known; seq--)
+  {
+    expected = seq_state_get(seq);
+    is_known = state_is_equal(&resumed, &expected);
+
+    /* Only the last two are expected if page isn't lost */
+    if (!bench->is_page_lost && seq <= MAX(bench->committed, 1))
+    {
+      break;
+    }
+  }
+
+  CHECK(is_known, "resumed hsv %u %u %u mode %u isn't written state, written %u, writing %u",
+        resumed.hsv.hue, resumed.hsv.saturation, resumed.hsv.brightness, resumed.led_mode,
+        bench->committed, bench->seq);
+}
+
+static void firmware_run(void)
+{
+  resumed_check();
+  states_run(RUN_STEPS);
+}
+
+static void firmware_recover(void)
+{
+  resumed_check();
+  states_run(RECOVERY_STEPS);
+}
+
+static void firmware_check(void)
+{
+  const journal_state_t expected = seq_state_get(bench->committed);
+
+  resumed_check();
+  CHECK(bench->committed == bench->seq - 1 || bench->committed == bench->seq, "state %u isn't written, %u is", bench->seq, bench->committed);
+  CHECK(state_is_equal(&journal.written, &expected), "the last written state %u isn't resumed", bench->committed);
+}
+
+static void scenario_reset(int64_t cut_op)
+{
+  nvmc_emu_erase_all();
+  memset(bench, 0, sizeof(*bench));
+  bench->cut_op = cut_op;
+}
+
+/**
+ * @brief Checks fail the test at once, so only boots are run here
+ */
+static void scenario_run(int64_t cut_op)
+{
+  scenario_reset(cut_op);
+
+  CHECK(nvmc_emu_boot(firmware_run, cut_op, (uint32_t)cut_op + 1) == NVMC_EMU_BOOT_CUT, "run isn't cut");
+  nvmc_emu_boot(firmware_recover, cut_op % RECOVERY_CUT_OPS, (uint32_t)cut_op * 7 + 3);
+  CHECK(nvmc_emu_boot(firmware_recover, NVMC_EMU_NO_CUT, 0) == NVMC_EMU_BOOT_DONE, "recovery is cut");
+  CHECK(nvmc_emu_boot(firmware_check, NVMC_EMU_NO_CUT, 0) == NVMC_EMU_BOOT_DONE, "check is cut");
+}
+
+int main(void)
+{
+  struct timespec start;
+  struct timespec end;
+  uint64_t ops;
+  double seconds;
+
+  nvmc_emu_init();
+  bench = calloc(1, sizeof(*bench));
+
+  if (bench == NULL)
+  {
+    return EXIT_FAILURE;
+  }
+
+  scenario_reset(NVMC_EMU_NO_CUT);
+  CHECK(nvmc_emu_boot(firmware_run, NVMC_EMU_NO_CUT, 0) == NVMC_EMU_BOOT_DONE, "run is cut");
+  ops = nvmc_emu_stats_get().ops;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  for (int64_t cut_op = 0; cut_op < (int64_t)ops; cut_op++)
+  {
+    scenario_run(cut_op);
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+  printf("test_state_journal: %llu power cuts passed, %.0f cuts/s\n", (unsigned long long)ops, ops / seconds);
+
+  return EXIT_SUCCESS;
+}
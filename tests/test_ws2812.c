@@ -0,0 +1,162 @@
+#include "ws2812.h"
+#include "pwm_emu.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+/**
+ * Strip frames are played by the emulated PWM and decoded back to GRB bytes
+ *  by high time of every bit, as the first LED of strip does it.
+ */
+
+#define CHECK(expr, ...)                                                    \
+  do                                                                        \
+  {                                                                         \
+    if (!(expr))                                                            \
+    {                                                                       \
+      fprintf(stderr, "%s:%d: %s: ", __FILE__, __LINE__, #expr);            \
+      fprintf(stderr, __VA_ARGS__);                                         \
+      fprintf(stderr, "\n");                                                \
+      exit(EXIT_FAILURE);                                                   \
+    }                                                                       \
+  } while (0)
+
+#define STRIP_PIXELS_MAX                300
+#define STRIP_PIN                       3
+
+/* Timings of WS2812B datasheet, ns */
+#define T0H_MIN_NS                      250
+#define T0H_MAX_NS                      550
+#define T1H_MIN_NS                      650
+#define T1H_MAX_NS                      950
+#define T0L_MIN_NS                      700
+#define T0L_MAX_NS                      1000
+#define T1L_MIN_NS                      300
+#define T1L_MAX_NS                      600
+#define BIT_THRESHOLD_NS                600     /* longer high is 1 */
+#define RESET_MIN_NS                    280000  /* of newer WS2812B, older ones and SK6812 need less */
+
+static rgb_params_t pixels[STRIP_PIXELS_MAX];
+static uint32_t rnd_state = 1;
+
+static uint32_t rnd(void)
+{
+  rnd_state = rnd_state * 1664525U + 1013904223U;
+  return rnd_state >> 8;
+}
+
+/**
+ * @return bit that LED reads from PWM value, timings of value are checked
+ */
+static uint8_t bit_decode(uint16_t value)
+{
+  const double high_ns = pwm_emu_high_ticks(value) * pwm_emu_tick_ns();
+  const double low_ns = pwm_emu_top_value() * pwm_emu_tick_ns() - high_ns;
+  const uint8_t bit = high_ns > BIT_THRESHOLD_NS;
+
+  CHECK(bit ? (high_ns >= T1H_MIN_NS && high_ns <= T1H_MAX_NS && low_ns >= T1L_MIN_NS && low_ns <= T1L_MAX_NS) :
+              (high_ns >= T0H_MIN_NS && high_ns <= T0H_MAX_NS && low_ns >= T0L_MIN_NS && low_ns <= T0L_MAX_NS),
+        "value 0x%04X is high for %.1f ns and low for %.1f ns", value, high_ns, low_ns);
+
+  return bit;
+}
+
+static uint8_t byte_decode(const uint16_t *values)
+{
+  uint8_t byte = 0;
+
+  for (uint8_t i = 0; i < 8; i++)
+  {
+    byte = (byte << 1) | bit_decode(values[i]);
+  }
+
+  return byte;
+}
+
+/**
+ * @brief Plays frame of count pixels and checks GRB bytes, chunks and reset pulse
+ */
+static void frame_test(uint16_t count)
+{
+  const pwm_emu_output_t *output = pwm_emu_output_get();
+  const uint32_t chunks = (count + WS2812_CHUNK_PIXELS - 1) / WS2812_CHUNK_PIXELS;
+  const pwm_emu_part_t *reset;
+  uint64_t reset_periods = 0;
+  uint32_t data_values = 0;
+  uint32_t part;
+
+  for (uint16_t i = 0; i < count; i++)
+  {
+    pixels[i] = (rgb_params_t){.red = rnd(), .green = rnd(), .blue = rnd()};
+  }
+
+  pwm_emu_reset();
+  CHECK(ws2812_show(pixels, count), "%u pixels aren't shown", count);
+  CHECK(ws2812_is_busy() && !ws2812_show(pixels, count), "frame of %u pixels is restarted while playing", count);
+  pwm_emu_run();
+  CHECK(!ws2812_is_busy(), "frame of %u pixels isn't finished", count);
+  CHECK(output->playbacks == 1, "%u playbacks", output->playbacks);
+
+  /* Chunks go by turns from both buffers */
+  for (part = 0; part < chunks; part++)
+  {
+    CHECK(output->parts[part].seq_id == part % 2, "chunk %u is played from sequence %u", part, output->parts[part].seq_id);
+    CHECK(output->parts[part].length == MIN(count - part * WS2812_CHUNK_PIXELS, WS2812_CHUNK_PIXELS) * WS2812_BITS_PER_PIXEL &&
+          output->parts[part].repeats == 0 && output->parts[part].end_delay == 0,
+          "chunk %u of %u pixels has %u values", part, count, output->parts[part].length);
+    data_values += output->parts[part].length;
+  }
+
+  for (uint16_t i = 0; i < count; i++)
+  {
+    const uint16_t *values = &output->values[i * WS2812_BITS_PER_PIXEL];
+    const rgb_params_t decoded = {.green = byte_decode(values), .red = byte_decode(values + 8), .blue = byte_decode(values + 16)};
+
+    CHECK(decoded.red == pixels[i].red && decoded.green == pixels[i].green && decoded.blue == pixels[i].blue,
+          "pixel %u of %u: rgb %u %u %u is decoded as %u %u %u", i, count, pixels[i].red, pixels[i].green,
+          pixels[i].blue, decoded.red, decoded.green, decoded.blue);
+  }
+
+  /* One reset slot kept low for end delay, it may be played twice to finish the last loop */
+  reset = &output->parts[chunks];
+  CHECK(output->parts_cnt == chunks + 1 || output->parts_cnt == chunks + 2, "%u parts of %u chunks", output->parts_cnt, chunks);
+  CHECK(reset->length == 1 && reset->end_delay == WS2812_RESET_PERIODS &&
+        output->values[reset->offset] == WS2812_CODE_RESET,
+        "reset of %u pixels is %u values 0x%04X and %u periods", count, reset->length,
+        output->values[reset->offset], reset->end_delay);
+
+  for (part = chunks; part < output->parts_cnt; part++)
+  {
+    for (uint32_t i = 0; i < output->parts[part].length; i++)
+    {
+      CHECK(pwm_emu_high_ticks(output->values[output->parts[part].offset + i]) == 0, "reset of %u pixels isn't low", count);
+    }
+
+    reset_periods += (uint64_t)output->parts[part].length * (output->parts[part].repeats + 1) + output->parts[part].end_delay;
+  }
+
+  CHECK(output->values_cnt - (output->parts_cnt - chunks) == data_values, "%u values of %u pixels", output->values_cnt, count);
+  CHECK(reset_periods * pwm_emu_top_value() * pwm_emu_tick_ns() >= RESET_MIN_NS,
+        "reset of %u pixels is %llu periods", count, (unsigned long long)reset_periods);
+}
+
+int main(void)
+{
+  static const uint16_t counts[] =
+  {
+    0, 1, WS2812_CHUNK_PIXELS - 1, WS2812_CHUNK_PIXELS, WS2812_CHUNK_PIXELS + 1,
+    2 * WS2812_CHUNK_PIXELS, 2 * WS2812_CHUNK_PIXELS + 1, 3 * WS2812_CHUNK_PIXELS, STRIP_PIXELS_MAX
+  };
+  const pwm_emu_output_t *output = pwm_emu_output_get();
+
+  ws2812_init(STRIP_PIN);
+
+  for (uint8_t i = 0; i < ARRAY_SIZE(counts); i++)
+  {
+    frame_test(counts[i]);
+  }
+
+  printf("test_ws2812: %u strip lengths decoded, frame of %u pixels takes %.1f us\n",
+         (unsigned)ARRAY_SIZE(counts), STRIP_PIXELS_MAX, output->periods * pwm_emu_top_value() * pwm_emu_tick_ns() / 1000);
+
+  return EXIT_SUCCESS;
+}
@@ -1,11 +1,31 @@
 #include "nrf_log.h"
 #include "cli_usb.h"
+#include "usbd_module.h"
 #include "g_context.h"
+#include "effect.h"
+#include "color_calib.h"
+#include "color_transition.h"
+#include "color_cct.h"
+#include "color_compositor.h"
+#include "preset.h"
+#include "color_history.h"
+#include "settings.h"
+#include "crash_dump.h"
 #include <ctype.h>
+#include <stdlib.h>
 
 static console_output_t result_buf;
-static update_pwm_handler_t pwm_force_update_handler;
-static nvmc_handler_t nvmc_write_handler;
+
+/* Two white pulses above current color to confirm saving */
+static const color_layer_t saving_layer =
+{
+  .color = {RGB_MAX_VALUE << RGB16_FRACTION_BITS, RGB_MAX_VALUE << RGB16_FRACTION_BITS, RGB_MAX_VALUE << RGB16_FRACTION_BITS},
+  .period_ms = 500,
+  .duration_ms = 1000,
+  .alpha = COLOR_LAYER_ALPHA_MAX / 2,
+  .blend = COLOR_BLEND_ADD,
+  .pattern = COLOR_PATTERN_PULSE,
+};
 
 static cmd_t get_cmd_from_args(const char *args, uint8_t args_size)
 {
@@ -53,9 +73,10 @@ static const char* find_next_arg(const char* args, uint8_t input_str_len)
 }
 
 /**
- * @brief Given args and result arrays returns args_count numbers from args str.
+ * @brief Given args and result arrays returns args_count numbers of format from args str.
  */
-static bool read_numeric_args(const char *args, uint8_t input_str_len, uint16_t *result, uint8_t args_count)
+static bool read_formatted_args(const char *args, uint8_t input_str_len, const char *format,
+                                uint16_t *result, uint8_t args_count)
 {
   uint16_t value;
   const char *current_args = args;
@@ -68,7 +89,8 @@ static bool read_numeric_args(const char *args, uint8_t input_str_len, uint16_t
       return false;
     }
 
-    if(sscanf(current_args, "%hu", &value) == EOF)
+    /* Argument that isn't a number leaves value unset */
+    if(sscanf(current_args, format, &value) != 1)
     {
       return false;
     }
@@ -80,12 +102,94 @@ static bool read_numeric_args(const char *args, uint8_t input_str_len, uint16_t
   return true;
 }
 
+static bool read_numeric_args(const char *args, uint8_t input_str_len, uint16_t *result, uint8_t args_count)
+{
+  return read_formatted_args(args, input_str_len, "%hu", result, args_count);
+}
+
+static bool read_signed_args(const char *args, uint8_t input_str_len, int16_t *result, uint8_t args_count)
+{
+  return read_formatted_args(args, input_str_len, "%hd", (uint16_t*)result, args_count);
+}
+
+/**
+ * @brief Reads hex string like "0a1B02" from args.
+ *
+ * @return count of bytes read or -1 if string is incorrect or too long
+ */
+static int16_t read_hex_arg(const char *args, uint8_t *result, uint8_t max_size)
+{
+  uint8_t size = 0;
+  uint8_t nibble;
+  char symbol;
+
+  if (args == NULL)
+  {
+    return 0;
+  }
+
+  for (uint8_t idx = 0; args[idx] != 0 && !isspace((uint8_t)args[idx]); idx++)
+  {
+    symbol = tolower((uint8_t)args[idx]);
+
+    if (!isxdigit((uint8_t)symbol) || size >= max_size)
+    {
+      return -1;
+    }
+
+    nibble = isdigit((uint8_t)symbol) ? symbol - '0' : symbol - 'a' + 10;
+
+    if (idx % 2 == 0)
+    {
+      result[size] = nibble << 4;
+    }
+    else
+    {
+      result[size++] |= nibble;
+    }
+
+    /* Odd count of digits */
+    if (args[idx + 1] == 0 || isspace((uint8_t)args[idx + 1]))
+    {
+      return idx % 2 == 0 ? -1 : size;
+    }
+  }
+
+  return size;
+}
+
+/**
+ * @brief Prints all preset slots in one line like "Presets: 0:120,100,50 1:- ..."
+ */
+static void preset_list_print(msg_hadler_t msg_handler)
+{
+  char line[MAX_OUTPUT_STR_SIZE + 1] = "Presets:";
+  size_t len = strlen(line);
+  hsv_params_t hsv;
+
+  for (uint8_t slot = 0; slot < PRESET_SLOTS_COUNT; slot++)
+  {
+    if (preset_get(slot, &hsv))
+    {
+      len += snprintf(&line[len], sizeof(line) - len, " %u:%u,%u,%u", slot, hsv.hue, hsv.saturation, hsv.brightness);
+    }
+    else
+    {
+      len += snprintf(&line[len], sizeof(line) - len, " %u:-", slot);
+    }
+  }
+
+  msg_handler("%s", line);
+}
+
 void process_input_string(const char *input_str, uint8_t input_str_len, msg_hadler_t msg_handler)
 {
   cmd_t cmd = get_cmd_from_args(input_str, input_str_len);
   const char *args_pointer = find_next_arg(input_str, input_str_len - cmd_arg_size[cmd]);
   uint8_t args_len = 0;
 
+  crash_dump_trace(CRASH_TRACE_CLI_CMD, cmd);
+
   if (args_pointer != NULL)
   {
     args_len = input_str_len - (args_pointer - args_pointer);
@@ -110,8 +214,7 @@ void process_input_string(const char *input_str, uint8_t input_str_len, msg_hadl
         msg_handler("Color changed to rgb: red %hu, green %hu, blue %hu",
                    result_buf.rgb.red, result_buf.rgb.green, result_buf.rgb.blue);
 
-        g_app_data.current_hsv = hsv_by_rgb(result_buf.rgb);
-        pwm_force_update_handler();
+        color_history_apply(hsv_by_rgb(result_buf.rgb));
       }
       else
       {
@@ -143,8 +246,7 @@ void process_input_string(const char *input_str, uint8_t input_str_len, msg_hadl
         NRF_LOG_INFO("HSV Cmd: %d, %d, %d", numeric_args[0], numeric_args[1], numeric_args[2]);
 
 
-        g_app_data.current_hsv = result_buf.hsv;
-        pwm_force_update_handler();
+        color_history_apply(result_buf.hsv);
       }
       else
       {
@@ -158,21 +260,200 @@ void process_input_string(const char *input_str, uint8_t input_str_len, msg_hadl
   }
   else if (cmd == SAVE_CMD)
   {
-    nvmc_write_handler(g_app_data.current_hsv);
-    msg_handler("Current state saved");
+    if (settings_save())
+    {
+      color_compositor_layer_set(COLOR_LAYER_STATUS, &saving_layer);
+      msg_handler("Current state saved");
+    }
+    else
+    {
+      msg_handler("Error: state isn't saved");
+    }
   }
   else if (cmd == HELP_CMD)
   {
-    msg_handler("Usage: rgb <r> <g> <b> or hsv <h> <s <v> or save");
+    msg_handler("rgb hsv cct fade save effect calib preset undo redo crashdump. No args: usage");
+  }
+  else if (cmd == EFFECT_CMD)
+  {
+    uint16_t slot;
+    uint8_t code[EFFECT_CODE_MAX_SIZE];
+    int16_t code_size;
+
+    if (read_numeric_args(args_pointer, args_len, &slot, cmd_arg_size[cmd]))
+    {
+      code_size = read_hex_arg(find_next_arg(args_pointer, strlen(args_pointer)), code, sizeof(code));
+
+      if (slot < EFFECT_SLOTS_COUNT && code_size >= 0 &&
+          effects_upload((uint8_t)slot, code, (uint8_t)code_size))
+      {
+        msg_handler(code_size ? "Effect %hu uploaded, %d bytes" : "Effect %hu cleared", slot, code_size);
+      }
+      else
+      {
+        msg_handler("Error: incorrect slot or effect code");
+      }
+    }
+    else
+    {
+      msg_handler("Error: args: <slot> [hex code]");
+    }
+  }
+  else if (cmd == CALIB_CMD)
+  {
+    /* row, coefficients in 1/1000, offset in PWM steps */
+    int16_t numeric_args[cmd_arg_size[cmd]];
+    int16_t coefs[3];
+    bool is_in_range;
+
+    if (read_signed_args(args_pointer, args_len, numeric_args, cmd_arg_size[cmd]))
+    {
+      is_in_range = numeric_args[0] >= 0 && abs(numeric_args[4]) <= INT8_MAX;
+
+      for (uint8_t i = 0; i < 3; i++)
+      {
+        is_in_range &= abs(numeric_args[i + 1]) <= 1000 * COLOR_CALIB_COEF_MAX / COLOR_CALIB_ONE;
+        coefs[i] = (int32_t)numeric_args[i + 1] * COLOR_CALIB_ONE / 1000;
+      }
+
+      if (is_in_range &&
+          color_calib_row_set((uint8_t)numeric_args[0], coefs, numeric_args[4] * (1 << RGB16_FRACTION_BITS)))
+      {
+        msg_handler("Calibration of row %hd changed to %hd %hd %hd, offset %hd", numeric_args[0],
+                    numeric_args[1], numeric_args[2], numeric_args[3], numeric_args[4]);
+      }
+      else
+      {
+        msg_handler("Error: incorrect argument value");
+      }
+    }
+    else
+    {
+      msg_handler("Error: args: <row> <r> <g> <b> <offset>");
+    }
+  }
+  else if (cmd == FADE_CMD)
+  {
+    /* duration in ms, space: 0 - rgb, 1 - hsv, 2 - perceptual, 3 - oklab, 4 - oklch */
+    uint16_t numeric_args[cmd_arg_size[cmd]];
+
+    if (read_numeric_args(args_pointer, args_len, numeric_args, cmd_arg_size[cmd]))
+    {
+      if (color_transition_config(numeric_args[0], (color_transition_space_t)numeric_args[1]))
+      {
+        msg_handler("Fade changed to %hu ms in space %hu", numeric_args[0], numeric_args[1]);
+      }
+      else
+      {
+        msg_handler("Error: incorrect argument value");
+      }
+    }
+    else
+    {
+      msg_handler("Error: args: <ms> <space>");
+    }
+  }
+  else if (cmd == CCT_CMD)
+  {
+    uint16_t numeric_args[cmd_arg_size[cmd]];
+
+    if (read_numeric_args(args_pointer, args_len, numeric_args, cmd_arg_size[cmd]))
+    {
+      if (numeric_args[0] >= CCT_MIN_KELVIN &&
+          numeric_args[0] <= CCT_MAX_KELVIN &&
+          numeric_args[1] <= BRIGHT_MAX_VALUE)
+      {
+        cct_to_rgb(numeric_args[0], (uint8_t)numeric_args[1], &result_buf.rgb);
+
+        msg_handler("Color changed to %hu K, bright %hu: red %hu, green %hu, blue %hu",
+                    numeric_args[0], numeric_args[1],
+                    result_buf.rgb.red, result_buf.rgb.green, result_buf.rgb.blue);
+        NRF_LOG_INFO("CCT Cmd: %d, %d", numeric_args[0], numeric_args[1]);
+
+        color_history_apply(hsv_by_rgb(result_buf.rgb));
+      }
+      else
+      {
+        msg_handler("Error: incorrect argument value");
+      }
+    }
+    else
+    {
+      msg_handler("Error: args: <kelvin> <brightness>");
+    }
+  }
+  else if (cmd == PRESET_CMD)
+  {
+    /* save <slot>, load <slot> or list */
+    const char *slot_arg = args_pointer != NULL ? find_next_arg(args_pointer, strlen(args_pointer)) : NULL;
+    uint16_t slot = PRESET_SLOTS_COUNT;
+
+    if (slot_arg != NULL)
+    {
+      read_numeric_args(slot_arg, strlen(slot_arg), &slot, 1);
+    }
+
+    if (args_pointer != NULL && !strncmp(args_pointer, "list", strlen("list")))
+    {
+      preset_list_print(msg_handler);
+    }
+    else if (args_pointer != NULL && !strncmp(args_pointer, "save ", strlen("save ")) &&
+             slot < PRESET_SLOTS_COUNT && preset_set((uint8_t)slot, app_state_hsv_get()))
+    {
+      msg_handler("Preset %hu set, use save to keep it", slot);
+    }
+    else if (args_pointer != NULL && !strncmp(args_pointer, "load ", strlen("load ")) &&
+             slot < PRESET_SLOTS_COUNT)
+    {
+      msg_handler(preset_load((uint8_t)slot) ? "Preset %hu loaded" : "Error: preset %hu is empty", slot);
+    }
+    else
+    {
+      msg_handler("Error: args: save <slot>, load <slot> or list");
+    }
+  }
+  else if (cmd == UNDO_CMD || cmd == REDO_CMD)
+  {
+    hsv_params_t hsv;
+
+    if (cmd == UNDO_CMD ? color_history_undo(&hsv) : color_history_redo(&hsv))
+    {
+      msg_handler("Color restored to hsv: hue %hu, sat %hu, bright %hu", hsv.hue, hsv.saturation, hsv.brightness);
+    }
+    else
+    {
+      msg_handler(cmd == UNDO_CMD ? "Error: nothing to undo" : "Error: nothing to redo");
+    }
+  }
+  else if (cmd == CRASHDUMP_CMD)
+  {
+    /* part of the newest dump or clear */
+    char line[MAX_OUTPUT_STR_SIZE + 1];
+    uint16_t part = CRASH_DUMP_PARTS_COUNT;
+
+    if (args_pointer != NULL && !strncmp(args_pointer, "clear", strlen("clear")))
+    {
+      crash_dump_clear();
+      msg_handler("Crash dumps cleared");
+    }
+    else if (read_numeric_args(args_pointer, args_len, &part, cmd_arg_size[cmd]))
+    {
+      if (part < CRASH_DUMP_PARTS_COUNT && crash_dump_part_print((uint8_t)part, line, sizeof(line)))
+      {
+        msg_handler("%s", line);
+      }
+      else
+      {
+        msg_handler(part < CRASH_DUMP_PARTS_COUNT ? "Error: no crash dump" : "Error: incorrect argument value");
+      }
+    }
+    else
+    {
+      msg_handler("Error: args: <part 0-%u> or clear", CRASH_DUMP_PARTS_COUNT - 1);
+    }
   }
   else if (cmd == NO_CMD)
   {
     msg_handler("Error: incorrect cmd name");
   }
-}
-
-void init_cli(update_pwm_handler_t pwm_force_update, nvmc_handler_t nvmc_handler)
-{
-  pwm_force_update_handler = pwm_force_update;
-  nvmc_write_handler = nvmc_handler;
 }
\ No newline at end of file
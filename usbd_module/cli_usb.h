@@ -4,7 +4,7 @@
 #include "hsv_to_rgb.h"
 
 #define MAX_NUM_LENGTH        3
-#define MAX_CMD_NAME_LEN      6
+#define MAX_CMD_NAME_LEN      10
 
 typedef enum cmd_s
 {
@@ -12,6 +12,14 @@ typedef enum cmd_s
   HSV_CMD,
   SAVE_CMD,
   HELP_CMD,
+  EFFECT_CMD,
+  CALIB_CMD,
+  FADE_CMD,
+  CCT_CMD,
+  PRESET_CMD,
+  UNDO_CMD,
+  REDO_CMD,
+  CRASHDUMP_CMD,
   NO_CMD
 } cmd_t;
 
@@ -21,8 +29,16 @@ static const char cmd_list[][MAX_CMD_NAME_LEN] =
   {"hsv"},
   {"save"},
   {"help"},
+  {"effect"},
+  {"calib"},
+  {"fade"},
+  {"cct"},
+  {"preset"},
+  {"undo"},
+  {"redo"},
+  {"crashdump"},
 };
-static const uint8_t cmd_arg_size[] = {3, 3, 0};
+static const uint8_t cmd_arg_size[] = {3, 3, 0, 0, 1, 5, 2, 2, 2, 0, 0, 1, 0};
 
 typedef union console_output_s
 {
@@ -30,11 +46,8 @@ typedef union console_output_s
   rgb_params_t rgb;
 } console_output_t;
 
-typedef void (*update_pwm_handler_t)(void);
 typedef void (*msg_hadler_t)(char* msg,...);
-typedef void (*nvmc_handler_t)(hsv_params_t hsv_params);
 
 void process_input_string(const char *input_str, uint8_t input_str_size, msg_hadler_t msg_handler);
-void init_cli(update_pwm_handler_t pwm_force_update, nvmc_handler_t nvmc_handler);
 
 #endif /* _CLI_USB_H */
\ No newline at end of file
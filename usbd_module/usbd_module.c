@@ -3,6 +3,7 @@
 #include "nrf_log.h"
 #include "g_context.h"
 #include "cli_usb.h"
+#include "color_compositor.h"
 #include <string.h>
 #include <stdarg.h>
 #include <ctype.h>
@@ -19,6 +20,17 @@ APP_USBD_CDC_ACM_GLOBAL_DEF(usb_cdc_acm,
                             CDC_ACM_DATA_EPOUT,
                             APP_USBD_CDC_COMM_PROTOCOL_AT_V250);
 
+/* Red blinks above current color when terminal was closed */
+static const color_layer_t host_lost_layer =
+{
+  .color = {RGB_MAX_VALUE << RGB16_FRACTION_BITS, 0, 0},
+  .period_ms = 600,
+  .duration_ms = 1800,
+  .alpha = COLOR_LAYER_ALPHA_MAX,
+  .blend = COLOR_BLEND_NORMAL,
+  .pattern = COLOR_PATTERN_BLINK,
+};
+
 static uint8_t m_rx_buffer[READ_SIZE];
 
 static char input_str[MAX_INPUT_STR_SIZE + 1];
@@ -133,10 +145,12 @@ static void usb_ev_handler(app_usbd_class_inst_t const * p_inst,
       ret_code_t ret;
       ret = app_usbd_cdc_acm_read(&usb_cdc_acm, m_rx_buffer, READ_SIZE);
       UNUSED_VARIABLE(ret);
+      color_compositor_layer_clear(COLOR_LAYER_ALERT);
       break;
   }
   case APP_USBD_CDC_ACM_USER_EVT_PORT_CLOSE:
   {
+      color_compositor_layer_set(COLOR_LAYER_ALERT, &host_lost_layer);
       break;
   }
   case APP_USBD_CDC_ACM_USER_EVT_TX_DONE:
@@ -0,0 +1,163 @@
+#include "ws2812.h"
+#include "nrf_assert.h"
+#include "nrf_log.h"
+#include "app_error.h"
+#include <string.h>
+
+/**
+ * Strip is streamed by PWM EasyDMA in chunks of WS2812_CHUNK_PIXELS.
+ *  Two chunk buffers are played one by one, and a buffer is encoded again
+ *  while the other one is played. The last part is the reset pulse,
+ *  so only 2 * WS2812_CHUNK_VALUES compare values are kept in RAM
+ *  for any strip length.
+ */
+
+#define WS2812_CODE(nibble, bit)        (((nibble) >> (bit)) & 1 ? WS2812_CODE_1 : WS2812_CODE_0)
+#define WS2812_NIBBLE(nibble)           { WS2812_CODE(nibble, 3), WS2812_CODE(nibble, 2), \
+                                          WS2812_CODE(nibble, 1), WS2812_CODE(nibble, 0) }
+
+/* Compare values of every nibble, MSB first */
+static const uint16_t nibble_codes[16][4] =
+{
+  WS2812_NIBBLE(0x0), WS2812_NIBBLE(0x1), WS2812_NIBBLE(0x2), WS2812_NIBBLE(0x3),
+  WS2812_NIBBLE(0x4), WS2812_NIBBLE(0x5), WS2812_NIBBLE(0x6), WS2812_NIBBLE(0x7),
+  WS2812_NIBBLE(0x8), WS2812_NIBBLE(0x9), WS2812_NIBBLE(0xA), WS2812_NIBBLE(0xB),
+  WS2812_NIBBLE(0xC), WS2812_NIBBLE(0xD), WS2812_NIBBLE(0xE), WS2812_NIBBLE(0xF),
+};
+
+static const nrfx_pwm_t ws2812_pwm = NRFX_PWM_INSTANCE(WS2812_PWM_INSTANCE_ID);
+static nrf_pwm_values_common_t ws2812_buffers[2][WS2812_CHUNK_VALUES];
+static nrf_pwm_sequence_t ws2812_sequences[2];
+
+static const rgb_params_t *ws2812_pixels;
+static uint16_t ws2812_pixels_cnt;
+static uint16_t ws2812_next_pixel;
+static volatile bool ws2812_is_playing = false;
+
+static inline nrf_pwm_values_common_t* ws2812_byte_encode(nrf_pwm_values_common_t *values, uint8_t byte)
+{
+  memcpy(values, nibble_codes[byte >> 4], sizeof(nibble_codes[0]));
+  memcpy(values + 4, nibble_codes[byte & 0x0F], sizeof(nibble_codes[0]));
+
+  return values + 8;
+}
+
+/**
+ * @brief Encodes the next chunk of pixels into buffer and updates its sequence.
+ *  Reset pulse is encoded when all pixels are sent.
+ */
+static void ws2812_chunk_encode(uint8_t seq_id)
+{
+  nrf_pwm_sequence_t *seq = &ws2812_sequences[seq_id];
+  nrf_pwm_values_common_t *values = ws2812_buffers[seq_id];
+  uint16_t count = MIN(ws2812_pixels_cnt - ws2812_next_pixel, WS2812_CHUNK_PIXELS);
+
+  if (count == 0)
+  {
+    values[0] = WS2812_CODE_RESET;
+    seq->length = 1;
+    seq->end_delay = WS2812_RESET_PERIODS;
+  }
+  else
+  {
+    for (const rgb_params_t *pixel = &ws2812_pixels[ws2812_next_pixel];
+         pixel < &ws2812_pixels[ws2812_next_pixel + count]; pixel++)
+    {
+      /* GRB order */
+      values = ws2812_byte_encode(values, pixel->green);
+      values = ws2812_byte_encode(values, pixel->red);
+      values = ws2812_byte_encode(values, pixel->blue);
+    }
+
+    ws2812_next_pixel += count;
+    seq->length = count * WS2812_BITS_PER_PIXEL;
+    seq->end_delay = 0;
+  }
+
+  nrfx_pwm_sequence_update(&ws2812_pwm, seq_id, seq);
+}
+
+static void ws2812_pwm_handler(nrfx_pwm_evt_type_t event_type)
+{
+  /* Sequence has finished and the other one is playing, so it's safe to encode it */
+  if (event_type == NRFX_PWM_EVT_END_SEQ0)
+  {
+    ws2812_chunk_encode(0);
+  }
+  else if (event_type == NRFX_PWM_EVT_END_SEQ1)
+  {
+    ws2812_chunk_encode(1);
+  }
+  else if (event_type == NRFX_PWM_EVT_FINISHED)
+  {
+    ws2812_is_playing = false;
+  }
+}
+
+/**
+ * @brief Inits PWM instance that drives strip data pin
+ *
+ * @param pin data pin of strip
+ */
+void ws2812_init(uint32_t pin)
+{
+  nrfx_pwm_config_t config =
+  {
+    .output_pins  = { pin, NRFX_PWM_PIN_NOT_USED, NRFX_PWM_PIN_NOT_USED, NRFX_PWM_PIN_NOT_USED },
+    .irq_priority = WS2812_PWM_IRQ_PRIORITY,
+    .base_clock   = NRF_PWM_CLK_16MHz,
+    .count_mode   = NRF_PWM_MODE_UP,
+    .top_value    = WS2812_PWM_TOP_VALUE,
+    .load_mode    = NRF_PWM_LOAD_COMMON,
+    .step_mode    = NRF_PWM_STEP_AUTO
+  };
+
+  for (uint8_t i = 0; i < NRFX_ARRAY_SIZE(ws2812_sequences); i++)
+  {
+    ws2812_sequences[i].values.p_common = ws2812_buffers[i];
+    ws2812_sequences[i].repeats = 0;
+  }
+
+  APP_ERROR_CHECK(nrfx_pwm_init(&ws2812_pwm, &config, ws2812_pwm_handler));
+  NRF_LOG_INFO("WS2812 PWM Initiated");
+}
+
+/**
+ * @brief Starts sending pixels to strip.
+ *  Pixels are encoded while they are sent, so they MUST NOT be changed
+ *  until @ref ws2812_is_busy returns false.
+ *
+ * @param pixels colors of strip, the first one is the nearest to MCU
+ * @param count pixels count
+ * @return false if the previous frame is still sent
+ */
+bool ws2812_show(const rgb_params_t *pixels, uint16_t count)
+{
+  /* Every chunk and reset pulse are parts, every loop plays two of them */
+  const uint16_t loops = ((count + WS2812_CHUNK_PIXELS - 1) / WS2812_CHUNK_PIXELS + 2) / 2;
+
+  ASSERT(pixels != NULL || count == 0);
+
+  if (ws2812_is_playing)
+  {
+    return false;
+  }
+
+  ws2812_pixels = pixels;
+  ws2812_pixels_cnt = count;
+  ws2812_next_pixel = 0;
+  ws2812_is_playing = true;
+
+  ws2812_chunk_encode(0);
+  ws2812_chunk_encode(1);
+
+  nrfx_pwm_complex_playback(&ws2812_pwm, &ws2812_sequences[0], &ws2812_sequences[1], loops,
+                            NRFX_PWM_FLAG_STOP | NRFX_PWM_FLAG_SIGNAL_END_SEQ0 | NRFX_PWM_FLAG_SIGNAL_END_SEQ1);
+
+  return true;
+}
+
+bool ws2812_is_busy(void)
+{
+  return ws2812_is_playing;
+}
@@ -0,0 +1,25 @@
+#ifndef _WS2812_H
+#define _WS2812_H
+
+#include "nrfx_pwm.h"
+#include "hsv_to_rgb.h"
+
+#define WS2812_PWM_INSTANCE_ID          2
+#define WS2812_PWM_IRQ_PRIORITY         4
+
+/* 16 MHz base clock, one bit is 20 ticks = 1.25 us */
+#define WS2812_PWM_TOP_VALUE            20
+#define WS2812_CODE_0                   (0x8000U | 6)     /* 0.375 us high */
+#define WS2812_CODE_1                   (0x8000U | 13)    /* 0.8125 us high */
+#define WS2812_CODE_RESET               0x8000U           /* low for whole bit */
+#define WS2812_RESET_PERIODS            240               /* 300 us low latches data, enough for WS2812B and SK6812 */
+
+#define WS2812_BITS_PER_PIXEL           24
+#define WS2812_CHUNK_PIXELS             16                /* pixels encoded at once into one of two buffers */
+#define WS2812_CHUNK_VALUES             (WS2812_CHUNK_PIXELS * WS2812_BITS_PER_PIXEL)
+
+void ws2812_init(uint32_t pin);
+bool ws2812_show(const rgb_params_t *pixels, uint16_t count);
+bool ws2812_is_busy(void);
+
+#endif /* _WS2812_H */